@@ -0,0 +1,607 @@
+/**
+ * @file DlpcSimulatorBench.cpp
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief 模拟控制器上的图案烧录基准测试
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * 不需要连接投影仪，ProjectorDlpc34xxDual经由SimulatedDlpcTransport完整运行：
+ * 1. 连接、协商时钟、流式编码并烧录N步相移图案，打印烧录统计
+ * 2. 把模拟flash的内容与独立编码的数据块逐字节比较，其余部分应保持擦除状态
+ * 3. 再次烧录相同的图案，应跳过擦除；首个图案的数据被改写后应重新烧录；
+ *    双控制器烧录时每张图案只读取一次，跳过烧录时不读取图案
+ * 4. 投影并单步切换，检查控制器报告的图案位置
+ * 5. 重复设置相同的LED电流时不访问控制器，连续单步时每步只发送一条命令；
+ *    触发输出依次使能、禁用、再使能时每次都发送
+ * 6. 快速控制下后台检查发现模拟的系统错误，故障期间单步失败，错误消除后恢复
+ * 7. 后台重新烧录不同的图案时连续单步、预估图案表并读取烧录统计，模拟传输耗时时单步插在写入命令之间执行，
+ *    烧录结果不受影响
+ * 8. 同一进程中两台投影仪并行烧录不同的图案并单步，各自的flash与图案位置互不影响
+ * 9. 两台投影仪共用缓存目录，重新创建的投影仪按自身flash中的图案判断是否需要烧录
+ * 10. 以JSON输出各操作码的命令统计与耗时直方图
+ * 任一检查失败时返回非零退出码。
+ *
+ * 用法：
+ *   dlpcSimulatorBench [clockHz] [eraseSeconds]
+ *   clockHz为0时不模拟传输耗时，默认400000；eraseSeconds默认0.5
+ */
+
+#include "commandStats.h"
+#include "waiter.h"
+#include "patternEncoder.h"
+#include "patternSource.h"
+#include "projectorDlpc34xxDual.h"
+#include "registerShadow.h"
+#include "simulatedDlpc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace slmaster::device;
+
+namespace {
+
+constexpr int kFrequency = 16;
+constexpr int kSteps = 4;
+// 单步自身耗时与线程调度的余量(s)
+constexpr double kStepLatencySlackSeconds = 0.01;
+
+void collectPatternDataBlock(uint32_t length, uint8_t *data, void *userData) {
+    auto output = static_cast<std::vector<uint8_t> *>(userData);
+    output->insert(output->end(), data, data + length);
+}
+
+bool check(const bool isPassed, const char *what) {
+    std::cout << "  " << (isPassed ? "ok    " : "FAILED") << " " << what
+              << std::endl;
+    return isPassed;
+}
+
+/**
+ * @brief 模拟flash的起始处是否为图案源独立编码的数据块
+ */
+bool isFlashProgrammed(SimulatedDlpcTransport &simulator,
+                       PatternSource &source) {
+    PatternEncoder encoder(DLPC34XX_INT_PAT_DMD_DLP4710);
+    std::vector<uint8_t> expected;
+    const std::vector<uint8_t> flash = simulator.getFlash();
+
+    return encoder.build(source) &&
+           encoder.encodeStream(source, collectPatternDataBlock, &expected) &&
+           expected.size() <= flash.size() &&
+           std::equal(expected.begin(), expected.end(), flash.begin());
+}
+
+/** @brief 统计像素线读取次数的图案源 */
+class CountingPatternSource : public PatternSource {
+  public:
+    explicit CountingPatternSource(PatternSource &source)
+        : numOfReads_(0), source_(source) {}
+
+    size_t getNumOfPatternSets() override {
+        return source_.getNumOfPatternSets();
+    }
+
+    bool getPatternSet(const size_t index, PatternProfileSet &set) override {
+        return source_.getPatternSet(index, set);
+    }
+
+    bool getProfile(const size_t setIndex, const size_t patternIndex,
+                    PatternProfile &profile) override {
+        ++numOfReads_;
+        return source_.getProfile(setIndex, patternIndex, profile);
+    }
+
+    uint64_t getFingerprint() override { return source_.getFingerprint(); }
+
+    //像素线读取次数
+    int numOfReads_;
+
+  private:
+    PatternSource &source_;
+};
+
+/**
+ * @brief 双控制器流式烧录时的图案读取次数
+ *
+ * @return true 烧录时每张图案只读取一次，跳过烧录时不读取图案
+ */
+bool checkPatternReads() {
+    auto simulator = std::make_shared<SimulatedDlpcTransport>();
+    ProjectorDlpc34xxDual projector;
+    projector.setTransport(simulator);
+
+    PhaseShiftPatternSource phaseShift(DLP4710_WIDTH, DLP4710_HEIGHT,
+                                       kFrequency, 100, 128, kSteps);
+    CountingPatternSource source(phaseShift);
+    bool isSucess = projector.connect() &&
+                    projector.populatePatternTableData(source) &&
+                    source.numOfReads_ == 2 * kSteps;
+
+    source.numOfReads_ = 0;
+    isSucess &= projector.populatePatternTableData(source) &&
+                source.numOfReads_ == 0;
+    projector.disConnect();
+
+    return isSucess;
+}
+
+/**
+ * @brief 触发输出配置的使能与反相和触发类型在同一参数字节中
+ *
+ * @return true 使能、禁用、再使能都不被影子视为重复写入，重复的禁用被视为重复写入
+ */
+bool checkTriggerOutShadow() {
+    // 操作码、触发类型|使能<<1|反相<<2、延时
+    const uint8_t enable[] = {0x92, 0x00 | 0x02, 0x00, 0x00};
+    const uint8_t disable[] = {0x92, 0x00, 0x00, 0x00};
+
+    RegisterShadow shadow;
+    bool isSucess = !shadow.isRedundantWrite(enable, sizeof(enable));
+    shadow.onWrite(enable, sizeof(enable), true);
+    isSucess &= !shadow.isRedundantWrite(disable, sizeof(disable));
+    shadow.onWrite(disable, sizeof(disable), true);
+    isSucess &= shadow.isRedundantWrite(disable, sizeof(disable));
+    isSucess &= !shadow.isRedundantWrite(enable, sizeof(enable));
+
+    return isSucess;
+}
+
+/**
+ * @brief 在两台模拟投影仪上并行烧录不同的图案并单步
+ *
+ * @return true 两台投影仪的flash都与各自的参考数据块一致，单步都成功
+ */
+bool checkParallelProjectors(const SimulatedDlpcTiming &timing) {
+    struct Rig {
+        std::shared_ptr<SimulatedDlpcTransport> simulator_;
+        ProjectorDlpc34xxDual projector_;
+        PhaseShiftPatternSource source_;
+    };
+
+    Rig rigs[2] = {
+        {std::make_shared<SimulatedDlpcTransport>(timing), {},
+         PhaseShiftPatternSource(DLP4710_WIDTH, DLP4710_HEIGHT, kFrequency,
+                                 100, 128, kSteps)},
+        {std::make_shared<SimulatedDlpcTransport>(timing), {},
+         PhaseShiftPatternSource(DLP4710_WIDTH, DLP4710_HEIGHT,
+                                 kFrequency * 2, 100, 128, kSteps + 2)}};
+
+    auto run = [&](Rig &rig) {
+        rig.projector_.setTransport(rig.simulator_);
+        bool isSucess = rig.projector_.connect() &&
+                        rig.projector_.populatePatternTableData(rig.source_) &&
+                        rig.projector_.project(false);
+        for (int i = 0; i < kSteps - 1 && isSucess; ++i) {
+            isSucess = rig.projector_.step();
+        }
+
+        isSucess &= rig.projector_.getFlashImgsNum() == kSteps - 1 &&
+                    rig.projector_.stop();
+        rig.projector_.disConnect();
+
+        return isSucess;
+    };
+
+    auto first = std::async(std::launch::async, run, std::ref(rigs[0]));
+    auto second = std::async(std::launch::async, run, std::ref(rigs[1]));
+    bool isSucess = first.get();
+    isSucess &= second.get();
+
+    for (auto &rig : rigs) {
+        isSucess &= isFlashProgrammed(*rig.simulator_, rig.source_);
+    }
+
+    return isSucess;
+}
+
+/**
+ * @brief 两台投影仪共用缓存目录：A烧录X，B烧录Y，重新创建A后请求Y
+ *
+ * @return true 重新创建的A擦除并烧录了Y，之后再请求Y时跳过擦除
+ */
+bool checkSharedCacheDirectory() {
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / "dlpcSimulatorBenchCache";
+    std::filesystem::remove_all(directory);
+
+    auto first = std::make_shared<SimulatedDlpcTransport>();
+    auto second = std::make_shared<SimulatedDlpcTransport>();
+    first->setIdentity("bridgeA");
+    second->setIdentity("bridgeB/1");
+    PhaseShiftPatternSource x(DLP4710_WIDTH, DLP4710_HEIGHT, kFrequency, 100,
+                              128, kSteps);
+    PhaseShiftPatternSource y(DLP4710_WIDTH, DLP4710_HEIGHT, kFrequency * 2,
+                              100, 128, kSteps + 2);
+
+    // 每次加载都使用新创建的投影仪，只有目录中的记录跨越实例
+    auto load = [&](const std::shared_ptr<SimulatedDlpcTransport> &simulator,
+                    PatternSource &source) {
+        ProjectorDlpc34xxDual projector;
+        projector.setTransport(simulator);
+        const bool isSucess =
+            projector.setPatternCacheDirectory(directory.string()) &&
+            projector.connect() && projector.populatePatternTableData(source);
+        projector.disConnect();
+
+        return isSucess;
+    };
+
+    bool isSucess = load(first, x) && load(second, y);
+
+    const uint64_t numOfErases = first->getNumOfErases();
+    isSucess &= load(first, y) && first->getNumOfErases() > numOfErases &&
+                isFlashProgrammed(*first, y);
+    isSucess &= load(first, y) && first->getNumOfErases() == numOfErases + 1;
+
+    std::filesystem::remove_all(directory);
+
+    return isSucess;
+}
+
+/**
+ * @brief 偶发的NAK只触发重发，连续被拒绝时才在本次烧录内缩短写入命令数据长度
+ *
+ * @return true 偶发NAK后仍用最大长度烧录，被迫缩短后下一次烧录恢复最大长度
+ */
+bool checkFlashWriteRetries() {
+    auto simulator = std::make_shared<SimulatedDlpcTransport>();
+    ProjectorDlpc34xxDual projector;
+    projector.setTransport(simulator);
+    PhaseShiftPatternSource x(DLP4710_WIDTH, DLP4710_HEIGHT, kFrequency, 100,
+                              128, kSteps);
+    PhaseShiftPatternSource y(DLP4710_WIDTH, DLP4710_HEIGHT, kFrequency * 2,
+                              100, 128, kSteps);
+    const uint16_t maxChunkSize = FlashProgrammer(true).getMaxChunkSize();
+
+    projector.getCommandStats().enable(true);
+    bool isSucess = projector.connect();
+
+    simulator->setFlashWriteNaks(FLASH_CHUNK_RETRIES - 1);
+    isSucess &= projector.populatePatternTableData(x) &&
+                projector.getFlashProgramStats().chunkSize_ == maxChunkSize &&
+                isFlashProgrammed(*simulator, x);
+
+    simulator->setFlashWriteNaks(FLASH_CHUNK_RETRIES);
+    isSucess &= projector.populatePatternTableData(y) &&
+                projector.getFlashProgramStats().chunkSize_ == maxChunkSize / 2 &&
+                isFlashProgrammed(*simulator, y);
+
+    isSucess &= projector.populatePatternTableData(x) &&
+                projector.getFlashProgramStats().chunkSize_ == maxChunkSize &&
+                isFlashProgrammed(*simulator, x);
+
+    // 每次被丢弃的数据命令都重发一次
+    uint64_t retries = 0;
+    for (const uint8_t opcode : {0xE1, 0xE2}) {
+        CommandOpcodeStats stats;
+        if (projector.getCommandStats().getStats(opcode, stats)) {
+            retries += stats.retries_;
+        }
+    }
+    isSucess &= retries == 2 * FLASH_CHUNK_RETRIES - 1;
+
+    projector.disConnect();
+
+    return isSucess;
+}
+
+/**
+ * @brief 在故障回调中析构投影仪
+ *
+ * @return true 回调执行且后台线程在投影仪析构后安全退出
+ */
+bool checkDestroyInFaultCallback() {
+    auto simulator = std::make_shared<SimulatedDlpcTransport>();
+    auto projector = std::make_unique<ProjectorDlpc34xxDual>();
+    projector->setTransport(simulator);
+    std::atomic<bool> isDestroyed(false);
+
+    bool isSucess = projector->connect() &&
+                    projector->enableFastControl(
+                        std::chrono::milliseconds(1),
+                        [&](const ProjectorFault &) {
+                            projector.reset();
+                            isDestroyed = true;
+                        });
+    simulator->setSystemError(true);
+
+    const PollSchedule schedule =
+        PollSchedule::fixed(std::chrono::milliseconds(5));
+    isSucess &= waitUntil([&] { return isDestroyed.load(); },
+                          std::chrono::seconds(2), schedule)
+                    .isSatisfied_;
+    // 留出时间让已分离的后台线程走完下一次循环
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    return isSucess;
+}
+
+/**
+ * @brief 同尺寸替换图片文件并保留修改时间，如cp -p
+ *
+ * @return true 图片文件图案源的指纹随之改变
+ */
+bool checkImageFileFingerprint() {
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "dlpcSimulatorBench.png";
+    auto writeFile = [&](const char content) {
+        std::ofstream file(path, std::ios::binary);
+        file << std::string(4096, content);
+    };
+
+    ImageFilePatternSource source;
+    PatternOrderSet set = PatternOrderSet();
+    set.isVertical_ = true;
+    set.patternArrayCounts_ = DLP4710_WIDTH;
+    source.addPatternSet(set, {path.string()});
+
+    writeFile('a');
+    const auto time = std::filesystem::last_write_time(path);
+    const uint64_t fingerprint = source.getFingerprint();
+
+    writeFile('b');
+    std::filesystem::last_write_time(path, time);
+    const bool isSucess =
+        fingerprint != 0 && source.getFingerprint() != fingerprint;
+
+    std::filesystem::remove(path);
+
+    return isSucess;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    SimulatedDlpcTiming timing = SimulatedDlpcTiming::cypress(
+        argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 400000,
+        argc > 2 ? std::strtod(argv[2], nullptr) : 0.5);
+    if (timing.clockFrequency_ == 0) {
+        timing = SimulatedDlpcTiming::instant();
+    }
+
+    auto simulator = std::make_shared<SimulatedDlpcTransport>(timing);
+    ProjectorDlpc34xxDual projector;
+    projector.setTransport(simulator);
+
+    projector.getCommandStats().enable(true);
+
+    bool isPassed = true;
+    std::cout << "simulated DLPC34xx dual, I2C " << timing.clockFrequency_
+              << " Hz, erase " << timing.eraseSeconds_ << " s" << std::endl;
+
+    isPassed &= check(projector.connect(), "connect");
+
+    PhaseShiftPatternSource source(DLP4710_WIDTH, DLP4710_HEIGHT, kFrequency,
+                                   100, 128, kSteps);
+
+    auto start = std::chrono::steady_clock::now();
+    isPassed &= check(projector.populatePatternTableData(source),
+                      "populate pattern table");
+    const double populateSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    const FlashProgramStats stats = projector.getFlashProgramStats();
+    std::cout << "  populate " << populateSeconds << " s, flash "
+              << stats.bytes_ << " bytes in " << stats.chunks_ << " chunks of "
+              << stats.chunkSize_ << ", " << stats.bytesPerSecond_ / 1024
+              << " KB/s, encoder stall " << stats.encoderStallSeconds_
+              << " s, link idle " << stats.linkIdleSeconds_ << " s, link busy "
+              << simulator->getLinkSeconds() << " s" << std::endl;
+
+    PatternEncoder encoder(DLPC34XX_INT_PAT_DMD_DLP4710);
+    std::vector<uint8_t> expected;
+    isPassed &= check(encoder.build(source) &&
+                          encoder.encodeStream(source, collectPatternDataBlock,
+                                               &expected),
+                      "encode reference block");
+
+    const std::vector<uint8_t> flash = simulator->getFlash();
+    bool isSame = !expected.empty() && expected.size() <= flash.size() &&
+                  std::equal(expected.begin(), expected.end(), flash.begin());
+    for (size_t i = expected.size(); isSame && i < flash.size(); ++i) {
+        isSame = flash[i] == 0xFF;
+    }
+    isPassed &= check(isSame, "flash matches the encoded block");
+
+    const uint64_t numOfErases = simulator->getNumOfErases();
+    isPassed &= check(projector.populatePatternTableData(source) &&
+                          simulator->getNumOfErases() == numOfErases,
+                      "reprogramming the same block skips erase");
+
+    // 头部之后、首个图案中的一个字节被改写，头部仍然一致
+    const uint32_t corruptOffset = encoder.getHeaderSize() + 16;
+    simulator->setFlashByte(corruptOffset,
+                            ~simulator->getFlash()[corruptOffset]);
+    isPassed &= check(projector.populatePatternTableData(source) &&
+                          simulator->getNumOfErases() == numOfErases + 1 &&
+                          isFlashProgrammed(*simulator, source),
+                      "a corrupted first pattern is reprogrammed");
+    isPassed &= check(checkPatternReads(),
+                      "each pattern is read once, none when skipped");
+
+    isPassed &= check(projector.project(false) &&
+                          simulator->isPatternRunning(),
+                      "project");
+    isPassed &= check(projector.step() && projector.getFlashImgsNum() == 1,
+                      "step");
+
+    double r, g, b;
+    isPassed &= check(projector.setLEDCurrent(0.5, 0.5, 0.5) &&
+                          projector.getLEDCurrent(r, g, b) && r == 0.5,
+                      "set and read back LED current");
+    // 自动LED控制方式下控制器会改变电流，重复的设置与读取都访问控制器
+    uint64_t numOfTransactions = simulator->getNumOfTransactions();
+    isPassed &= check(projector.setLEDCurrent(0.5, 0.5, 0.5) &&
+                          projector.getLEDCurrent(r, g, b) &&
+                          simulator->getNumOfTransactions() ==
+                              numOfTransactions + 4,
+                      "LED current bypasses the register shadow");
+    isPassed &= check(checkTriggerOutShadow(),
+                      "trigger output enable toggles are always sent");
+
+    numOfTransactions = simulator->getNumOfTransactions();
+    bool isStepped = true;
+    for (int i = 0; i < kSteps - 1; ++i) {
+        isStepped &= projector.step();
+    }
+    isPassed &= check(isStepped && simulator->getNumOfTransactions() -
+                                           numOfTransactions ==
+                                       2 * ((uint64_t)kSteps - 1),
+                      "steps read the status outside fast control");
+
+    simulator->setSystemError(true);
+    isPassed &= check(!projector.step(),
+                      "a system error blocks the next step at once");
+    simulator->setSystemError(false);
+
+    std::atomic<int> numOfFaults(0);
+    isPassed &= check(projector.enableFastControl(
+                          std::chrono::milliseconds(10),
+                          [&](const ProjectorFault &fault) {
+                              numOfFaults += fault.isSystemError_ ? 1 : 0;
+                          }),
+                      "enable fast control");
+
+    start = std::chrono::steady_clock::now();
+    isStepped = true;
+    for (int i = 0; i < kSteps; ++i) {
+        isStepped &= projector.step();
+    }
+    std::cout << "  fast step "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                         .count() *
+                     1e6 / kSteps
+              << " us" << std::endl;
+
+    simulator->setSystemError(true);
+    const PollSchedule schedule =
+        PollSchedule::fixed(std::chrono::milliseconds(5));
+    isPassed &= check(isStepped &&
+                          waitUntil([&] { return numOfFaults > 0; },
+                                    std::chrono::seconds(2), schedule)
+                              .isSatisfied_ &&
+                          !projector.step(),
+                      "monitor reports a system error and blocks steps");
+
+    simulator->setSystemError(false);
+    isPassed &= check(waitUntil([&] { return projector.step(); },
+                                std::chrono::seconds(2), schedule)
+                              .isSatisfied_ &&
+                          numOfFaults == 1,
+                      "steps resume after the error clears");
+    projector.disableFastControl();
+
+    // 旧的图案表在重新烧录期间继续单步，每步都应在烧录完成前返回
+    PhaseShiftPatternSource reload(DLP4710_WIDTH, DLP4710_HEIGHT,
+                                   kFrequency * 2, 100, 128, kSteps + 2);
+    // 预估与烧录统计不经过命令执行线程，与烧录同时读取烧录器的记录
+    std::vector<PatternProfileSet> table(source.getNumOfPatternSets());
+    for (size_t i = 0; i < table.size(); ++i) {
+        source.getPatternSet(i, table[i]);
+        for (size_t j = 0; j < table[i].profiles_.size(); ++j) {
+            source.getProfile(i, j, table[i].profiles_[j]);
+        }
+    }
+    const uint64_t numOfUrgentCommands = projector.getNumOfUrgentCommands();
+    const uint64_t numOfReloadErases = simulator->getNumOfErases();
+    start = std::chrono::steady_clock::now();
+    auto reloading = projector.populatePatternTableDataAsync(reload);
+    double maxStepSeconds = 0;
+    // 擦除开始后的单步，之前是编码准备
+    double maxFlashStepSeconds = 0;
+    int numOfSteps = 0;
+    bool isPlanned = true;
+    isStepped = true;
+    while (reloading.wait_for(std::chrono::seconds(0)) !=
+           std::future_status::ready) {
+        const bool isFlashing =
+            simulator->getNumOfErases() > numOfReloadErases;
+        const auto stepStart = std::chrono::steady_clock::now();
+        isStepped &= projector.step();
+        const double stepSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          stepStart)
+                .count();
+        maxStepSeconds = std::max(maxStepSeconds, stepSeconds);
+        if (isFlashing) {
+            maxFlashStepSeconds = std::max(maxFlashStepSeconds, stepSeconds);
+        }
+        ++numOfSteps;
+
+        PatternTablePlan plan;
+        isPlanned &= projector.planPatternTableData(table, plan);
+
+        projector.getFlashProgramStats();
+    }
+    const bool isReloaded = reloading.get();
+    std::cout << "  reload "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << " s, " << numOfSteps << " steps, max step latency "
+              << maxStepSeconds * 1e3 << " ms (" << maxFlashStepSeconds * 1e3
+              << " ms while flashing), "
+              << projector.getNumOfUrgentCommands() - numOfUrgentCommands
+              << " between flash commands" << std::endl;
+    // 不模拟传输耗时时烧录约1ms，可能在第一次单步之前就已完成
+    const bool isInterleaved = timing.clockFrequency_ == 0 ||
+                               (numOfSteps > 1 &&
+                                projector.getNumOfUrgentCommands() >
+                                    numOfUrgentCommands);
+    isPassed &= check(isReloaded && isStepped && isPlanned && isInterleaved &&
+                          projector.getFlashProgramStats().bytes_ > 0 &&
+                          isFlashProgrammed(*simulator, reload),
+                      "steps run between flash commands during a reload");
+    // 擦除与烧录期间单步最多等待正在传输的一条写入命令，擦除等待期间随到随执行
+    isPassed &= check(
+        maxFlashStepSeconds <=
+            2 * projector.getFlashProgramStats().maxChunkSeconds_ +
+                kStepLatencySlackSeconds,
+        "step latency during a reload is bounded by one flash command");
+
+    isPassed &= check(projector.stop() && !simulator->isPatternRunning(),
+                      "stop");
+
+    projector.disConnect();
+
+    isPassed &= check(checkParallelProjectors(timing),
+                      "two projectors program and step in parallel");
+
+    isPassed &= check(checkSharedCacheDirectory(),
+                      "projectors sharing a cache directory keep own records");
+
+    isPassed &= check(checkDestroyInFaultCallback(),
+                      "projector destroyed inside its fault callback");
+
+    isPassed &= check(checkImageFileFingerprint(),
+                      "image files replaced with their time kept are reloaded");
+
+    isPassed &= check(checkFlashWriteRetries(),
+                      "transient flash write NAKs keep the full chunk size");
+
+    CommandOpcodeStats flashStats;
+    isPassed &= check(
+        projector.getCommandStats().getStats(0xE2, flashStats) &&
+            flashStats.failures_ == 0 && flashStats.retries_ == 0,
+        "command statistics are kept per projector");
+
+    std::cout << projector.getCommandStats().toJson() << std::endl;
+
+    std::cout << (isPassed ? "PASSED" : "FAILED") << std::endl;
+
+    return isPassed ? 0 : 1;
+}
@@ -0,0 +1,399 @@
+/**
+ * @file PatternCompiler.cpp
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief 离线图案编译器
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * 不需要连接投影仪，把图案编译为.patn数据块文件，运行时用
+ * Projector::loadPatternBlockFile直接烧录，启动时不再解码图片、不再编码：
+ * 1. compile  把目录中的图片（如images_Projector/I1.png..I10.png）按文件名中的序号编译
+ * 2. generate 按参数生成相移或格雷码图案并编译
+ * 3. inspect  打印.patn文件的内容，并把数据块解码后重新编码，检查是否逐字节一致
+ *
+ * 用法：
+ *   patternCompiler compile <imageDir> <out.patn> [options]
+ *   patternCompiler generate phase:<steps>:<period> | gray:<bits> <out.patn> [options]
+ *   patternCompiler inspect <file.patn>
+ * options:
+ *   --dmd DLP2010|DLP3010|DLP4710  目标DMD，默认DLP4710
+ *   --set-size N                   每个集合的图案数量，默认全部放在一个集合
+ *   --horizontal                   水平图案（像素线沿图像列方向）
+ *   --one-bit                      一位深度，像素不小于128时为1
+ *   --illumination R|G|B|RGB       LED，默认B
+ *   --exposure us --pre us --post us
+ *   --flip-ew --flip-la            东西翻转、沿长轴翻转
+ */
+
+#include "patternBlockFile.h"
+#include "patternEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using slmaster::device::PatternBlockFile;
+using slmaster::device::PatternEncoder;
+using slmaster::device::PatternOrderSet;
+using slmaster::device::PatternProfile;
+using slmaster::device::PatternProfileSet;
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+/** @brief 编译参数 */
+struct Options {
+    DLPC34XX_INT_PAT_DMD_e dmd_ = DLPC34XX_INT_PAT_DMD_DLP4710;
+    size_t setSize_ = 0;
+    bool isVertical_ = true;
+    bool isOneBit_ = false;
+    slmaster::device::Illumination illumination_ = slmaster::device::Blue;
+    int exposureTime_ = 4000;
+    int preExposureTime_ = 3000;
+    int postExposureTime_ = 3000;
+    bool eastWestFlip_ = false;
+    bool longAxisFlip_ = false;
+};
+
+void printUsage() {
+    std::cout
+        << "usage:\n"
+           "  patternCompiler compile <imageDir> <out.patn> [options]\n"
+           "  patternCompiler generate phase:<steps>:<period> | gray:<bits> "
+           "<out.patn> [options]\n"
+           "  patternCompiler inspect <file.patn>\n"
+           "options:\n"
+           "  --dmd DLP2010|DLP3010|DLP4710  --set-size N  --horizontal  "
+           "--one-bit\n"
+           "  --illumination R|G|B|RGB  --exposure us  --pre us  --post us\n"
+           "  --flip-ew  --flip-la"
+        << std::endl;
+}
+
+bool parseOptions(int argc, char **argv, int first, Options &options) {
+    for (int i = first; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--dmd" && hasValue) {
+            const std::string dmd = argv[++i];
+            if (dmd == "DLP2010") {
+                options.dmd_ = DLPC34XX_INT_PAT_DMD_DLP2010;
+            } else if (dmd == "DLP3010") {
+                options.dmd_ = DLPC34XX_INT_PAT_DMD_DLP3010;
+            } else if (dmd == "DLP4710") {
+                options.dmd_ = DLPC34XX_INT_PAT_DMD_DLP4710;
+            } else {
+                return false;
+            }
+        } else if (arg == "--set-size" && hasValue) {
+            options.setSize_ = (size_t)std::atoi(argv[++i]);
+        } else if (arg == "--horizontal") {
+            options.isVertical_ = false;
+        } else if (arg == "--one-bit") {
+            options.isOneBit_ = true;
+        } else if (arg == "--illumination" && hasValue) {
+            const std::string led = argv[++i];
+            options.illumination_ = led == "R"   ? slmaster::device::Red
+                                    : led == "G" ? slmaster::device::Grren
+                                    : led == "B" ? slmaster::device::Blue
+                                                 : slmaster::device::RGB;
+        } else if (arg == "--exposure" && hasValue) {
+            options.exposureTime_ = std::atoi(argv[++i]);
+        } else if (arg == "--pre" && hasValue) {
+            options.preExposureTime_ = std::atoi(argv[++i]);
+        } else if (arg == "--post" && hasValue) {
+            options.postExposureTime_ = std::atoi(argv[++i]);
+        } else if (arg == "--flip-ew") {
+            options.eastWestFlip_ = true;
+        } else if (arg == "--flip-la") {
+            options.longAxisFlip_ = true;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief 获取DMD一条像素线的长度
+ */
+uint32_t getLineLength(const Options &options) {
+    DLPC34XX_INT_PAT_Encoder_s encoder;
+    DLPC34XX_INT_PAT_InitEncoder(&encoder, options.dmd_, 0, nullptr, 0, nullptr,
+                                 nullptr, nullptr);
+
+    return options.isVertical_ ? encoder.DMDInfo.Width
+                               : encoder.DMDInfo.Height;
+}
+
+/**
+ * @brief 按setSize_把图案分成若干集合
+ */
+std::vector<PatternProfileSet>
+toProfileTable(const std::vector<PatternProfile> &profiles,
+               const Options &options) {
+    const size_t setSize =
+        options.setSize_ > 0 ? options.setSize_ : profiles.size();
+
+    std::vector<PatternProfileSet> table;
+    for (size_t i = 0; i < profiles.size(); i += setSize) {
+        PatternProfileSet set;
+        set.illumination_ = options.illumination_;
+        set.invertPatterns_ = false;
+        set.isOneBit_ = options.isOneBit_;
+        // 图片与生成的图案都是灰度，一位深度时由编码器二值化
+        set.isRawOneBit_ = options.isOneBit_;
+        set.exposureTime_ = options.exposureTime_;
+        set.preExposureTime_ = options.preExposureTime_;
+        set.postExposureTime_ = options.postExposureTime_;
+        set.profiles_.assign(
+            profiles.begin() + i,
+            profiles.begin() + std::min(i + setSize, profiles.size()));
+        table.push_back(set);
+    }
+
+    return table;
+}
+
+/**
+ * @brief 读取目录中的图片，按文件名中的序号排序（I2在I10之前）
+ */
+bool loadImages(const std::string &directory, const Options &options,
+                std::vector<PatternProfile> &profiles) {
+    std::error_code errorCode;
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory, errorCode)) {
+        const std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() &&
+            (extension == ".png" || extension == ".bmp" ||
+             extension == ".jpg" || extension == ".tif")) {
+            paths.push_back(entry.path());
+        }
+    }
+
+    auto numberOf = [](const std::filesystem::path &path) {
+        const std::string stem = path.stem().string();
+        const size_t digit = stem.find_first_of("0123456789");
+        return digit == std::string::npos ? -1L
+                                          : std::atol(stem.c_str() + digit);
+    };
+    std::sort(paths.begin(), paths.end(),
+              [&](const std::filesystem::path &lhs,
+                  const std::filesystem::path &rhs) {
+                  const long lhsNumber = numberOf(lhs);
+                  const long rhsNumber = numberOf(rhs);
+                  return lhsNumber != rhsNumber ? lhsNumber < rhsNumber
+                                                : lhs < rhs;
+              });
+
+    PatternOrderSet set;
+    set.patternArrayCounts_ = (int)getLineLength(options);
+    set.illumination_ = options.illumination_;
+    set.invertPatterns_ = false;
+    set.isVertical_ = options.isVertical_;
+    set.isOneBit_ = options.isOneBit_;
+    set.exposureTime_ = options.exposureTime_;
+    set.preExposureTime_ = options.preExposureTime_;
+    set.postExposureTime_ = options.postExposureTime_;
+    for (const auto &path : paths) {
+        set.imgs_.push_back(cv::imread(path.string(), 0));
+    }
+
+    PatternProfileSet profileSet;
+    if (paths.empty() ||
+        !slmaster::device::toPatternProfileSet(set, profileSet)) {
+        return false;
+    }
+
+    profiles = profileSet.profiles_;
+    std::cout << "loaded " << profiles.size() << " images from " << directory
+              << std::endl;
+
+    return true;
+}
+
+/**
+ * @brief 生成相移（phase:steps:period）或格雷码（gray:bits）图案
+ */
+bool generatePatterns(const std::string &spec, const Options &options,
+                      std::vector<PatternProfile> &profiles) {
+    const uint32_t length = getLineLength(options);
+    const size_t first = spec.find(':');
+    if (first == std::string::npos) {
+        return false;
+    }
+
+    const std::string kind = spec.substr(0, first);
+    if (kind == "phase") {
+        const size_t second = spec.find(':', first + 1);
+        if (second == std::string::npos) {
+            return false;
+        }
+
+        const int steps = std::atoi(spec.c_str() + first + 1);
+        const double period = std::atof(spec.c_str() + second + 1);
+        if (steps <= 0 || period <= 0) {
+            return false;
+        }
+
+        for (int i = 0; i < steps; ++i) {
+            PatternProfile profile;
+            profile.isVertical_ = options.isVertical_;
+            profile.line_.resize(length);
+            for (uint32_t x = 0; x < length; ++x) {
+                const double value =
+                    127.5 + 127.5 * std::cos(2 * kPi * x / period +
+                                             2 * kPi * i / steps);
+                profile.line_[x] = (uint8_t)value;
+            }
+            profiles.push_back(profile);
+        }
+    } else if (kind == "gray") {
+        const int bits = std::atoi(spec.c_str() + first + 1);
+        if (bits <= 0 || bits > 16) {
+            return false;
+        }
+
+        for (int i = 0; i < bits; ++i) {
+            PatternProfile profile;
+            profile.isVertical_ = options.isVertical_;
+            profile.line_.resize(length);
+            for (uint32_t x = 0; x < length; ++x) {
+                const uint32_t code = (uint32_t)((uint64_t)x << bits) / length;
+                const uint32_t gray = code ^ (code >> 1);
+                const bool isOn = (gray >> (bits - 1 - i)) & 1;
+                profile.line_[x] = isOn ? 255 : 0;
+            }
+            profiles.push_back(profile);
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+int compile(const std::vector<PatternProfile> &profiles,
+            const std::string &output, const Options &options) {
+    const std::vector<PatternProfileSet> table =
+        toProfileTable(profiles, options);
+
+    PatternEncoder encoder(options.dmd_);
+    if (!encoder.build(table) ||
+        !PatternBlockFile::save(output, encoder, options.eastWestFlip_,
+                                options.longAxisFlip_)) {
+        std::cout << "failed to compile " << output << std::endl;
+        return 1;
+    }
+
+    std::cout << "wrote " << output << ": " << table.size() << " sets, "
+              << encoder.getNumOfPatterns() << " patterns, "
+              << encoder.getBlock().size() << " bytes" << std::endl;
+
+    return 0;
+}
+
+int inspect(const std::string &path) {
+    PatternBlockFile file;
+    if (!file.open(path)) {
+        std::cout << "not a valid .patn file: " << path << std::endl;
+        return 1;
+    }
+
+    char hash[32];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)file.getHash());
+    std::cout << path << ": DMD " << (int)file.getDMD() << ", hash " << hash
+              << ", block " << file.getBlockSize() << " bytes, header "
+              << file.getHeaderSize() << " bytes, flips ew="
+              << file.isEastWestFlip() << " la=" << file.isLongAxisFlip()
+              << std::endl;
+
+    const auto &orderTable = file.getPatternOrderTable();
+    for (size_t i = 0; i < orderTable.size(); ++i) {
+        std::cout << "  order " << i << ": set "
+                  << (int)orderTable[i].PatternSetIndex << ", "
+                  << (int)orderTable[i].NumDisplayPatterns
+                  << " patterns, illumination "
+                  << (int)orderTable[i].IlluminationSelect << ", "
+                  << orderTable[i].PreIlluminationDarkTimeInMicroseconds
+                  << "/" << orderTable[i].IlluminationTimeInMicroseconds << "/"
+                  << orderTable[i].PostIlluminationDarkTimeInMicroseconds
+                  << " us" << std::endl;
+    }
+
+    std::vector<PatternProfileSet> table;
+    file.decode(table);
+    for (size_t i = 0; i < table.size(); ++i) {
+        const auto &profiles = table[i].profiles_;
+        std::cout << "  set " << i << ": " << profiles.size() << " "
+                  << (profiles.empty() || profiles[0].isVertical_
+                          ? "vertical"
+                          : "horizontal")
+                  << " patterns, " << (table[i].isOneBit_ ? 1 : 8) << "-bit"
+                  << std::endl;
+        for (size_t j = 0; j < profiles.size(); ++j) {
+            std::cout << "    pattern " << j << ":";
+            for (size_t x = 0; x < std::min<size_t>(16, profiles[j].line_.size());
+                 ++x) {
+                std::cout << " " << (int)profiles[j].line_[x];
+            }
+            std::cout << " ..." << std::endl;
+        }
+    }
+
+    // 解码结果重新编码后应得到同一个数据块
+    PatternEncoder encoder(file.getDMD());
+    const bool isSame =
+        encoder.build(table) &&
+        encoder.encodeBlock(file.isEastWestFlip(), file.isLongAxisFlip()) &&
+        encoder.getBlock().size() == file.getBlockSize() &&
+        memcmp(encoder.getBlock().data(), file.getBlock(),
+               file.getBlockSize()) == 0;
+    std::cout << "re-encoded block: " << (isSame ? "identical" : "MISMATCH")
+              << std::endl;
+
+    return isSame ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string command = argv[1];
+    if (command == "inspect") {
+        return inspect(argv[2]);
+    }
+
+    Options options;
+    if ((command != "compile" && command != "generate") || argc < 4 ||
+        !parseOptions(argc, argv, 4, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<PatternProfile> profiles;
+    const bool isLoaded = command == "compile"
+                              ? loadImages(argv[2], options, profiles)
+                              : generatePatterns(argv[2], options, profiles);
+    if (!isLoaded) {
+        std::cout << "no patterns from " << argv[2] << std::endl;
+        return 1;
+    }
+
+    return compile(profiles, argv[3], options);
+}
@@ -0,0 +1,330 @@
+/**
+ * @file PatternEncoderBench.cpp
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief 内部图案编码器微基准测试
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * 不需要连接投影仪，对比：
+ * 1. 原始编码器（PatternEncoderBenchLegacy.c中冻结的副本）与当前编码器生成的"PATN"数据块，
+ *    覆盖DLP2010/DLP3010单控制器与DLP4710双控制器、八位竖直与一位水平图案及全部翻转组合
+ * 2. DLP4710 双控制器下原始编码器、逐字节回调、整块回调与线程池并行编码的耗时
+ * 3. 一位深度灰度线先转换为0/1再打包与打包时直接二值化
+ * 各路径的输出会逐字节比较，不一致时返回非零退出码。
+ */
+
+#include "dlpc347x_internal_patterns.h"
+#include "dlpc347x_pattern_packer.h"
+#include "dlpc_common.h"
+#include "threadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using slmaster::device::ThreadPool;
+
+extern "C" {
+/**
+ * @brief 原始编码器的冻结副本，见PatternEncoderBenchLegacy.c
+ */
+uint32_t LEGACY_GeneratePatternDataBlock(
+    DLPC34XX_INT_PAT_DMD_e DMD, uint32_t PatternSetCount,
+    DLPC34XX_INT_PAT_PatternSet_s *PatternSetArray,
+    uint32_t PatternOrderTableCount,
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s *PatternOrderTable,
+    DLPC34XX_INT_PAT_WritePatternDataCallback WritePatternDataCallback,
+    bool EastWestFlip, bool LongAxisFlip);
+}
+
+namespace {
+
+constexpr uint32_t kLineBytes = 256;
+constexpr int kLineIterations = 20000;
+constexpr int kBlockIterations = 20;
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<uint8_t> s_Output;
+
+void collectPatternData(uint8_t length, uint8_t *data) {
+    s_Output.insert(s_Output.end(), data, data + length);
+}
+
+void collectPatternDataBlock(uint32_t length, uint8_t *data, void *userData) {
+    s_Output.insert(s_Output.end(), data, data + length);
+}
+
+template <typename Func> double measureMicroseconds(int iterations, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           iterations;
+}
+
+DLPC34XX_INT_PAT_PatternOrderTableEntry_s makeOrderTableEntry(
+    int numOfPatterns) {
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s orderTableEntry;
+    orderTableEntry.PatternSetIndex = 0;
+    orderTableEntry.NumDisplayPatterns = numOfPatterns;
+    orderTableEntry.IlluminationSelect = DLPC34XX_INT_PAT_ILLUMINATION_RED;
+    orderTableEntry.InvertPatterns = false;
+    orderTableEntry.IlluminationTimeInMicroseconds = 10000;
+    orderTableEntry.PreIlluminationDarkTimeInMicroseconds = 0;
+    orderTableEntry.PostIlluminationDarkTimeInMicroseconds = 0;
+
+    return orderTableEntry;
+}
+
+/**
+ * @brief 随机像素线，位深度以上的位为0
+ *
+ * @param numOfPatterns 图案数量
+ * @param length 像素线长度
+ * @param bitDepth 位深度
+ */
+std::vector<std::vector<uint8_t>> makeRandomLines(int numOfPatterns,
+                                                  uint32_t length,
+                                                  uint32_t bitDepth) {
+    std::mt19937 rng(2024 + numOfPatterns + length + bitDepth);
+    std::vector<std::vector<uint8_t>> lines(numOfPatterns,
+                                            std::vector<uint8_t>(length));
+    for (auto &line : lines) {
+        for (auto &pixel : line) {
+            pixel = (uint8_t)(rng() & ((1u << bitDepth) - 1));
+        }
+    }
+
+    return lines;
+}
+
+/**
+ * @brief 用原始编码器与当前编码器生成同一数据块并逐字节比较
+ *
+ * @return true 全部翻转组合下输出一致
+ */
+bool compareWithLegacy(const char *name, DLPC34XX_INT_PAT_DMD_e dmd,
+                       uint32_t length, DLPC34XX_INT_PAT_Direction_e direction,
+                       DLPC34XX_INT_PAT_BitDepth_e bitDepth) {
+    constexpr int kNumOfPatterns = 3;
+    std::vector<std::vector<uint8_t>> lines =
+        makeRandomLines(kNumOfPatterns, length, (uint32_t)bitDepth);
+    std::vector<DLPC34XX_INT_PAT_PatternData_s> patterns(kNumOfPatterns);
+    for (int i = 0; i < kNumOfPatterns; ++i) {
+        patterns[i].PixelArray = lines[i].data();
+        patterns[i].PixelArrayCount = length;
+    }
+
+    DLPC34XX_INT_PAT_PatternSet_s patternSet;
+    patternSet.BitDepth = bitDepth;
+    patternSet.Direction = direction;
+    patternSet.PatternCount = kNumOfPatterns;
+    patternSet.PatternArray = patterns.data();
+    patternSet.ThresholdPixels = false;
+
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s orderTableEntry =
+        makeOrderTableEntry(kNumOfPatterns);
+
+    bool isSame = true;
+    for (int flips = 0; flips < 4; ++flips) {
+        const bool eastWestFlip = (flips & 1) != 0;
+        const bool longAxisFlip = (flips & 2) != 0;
+
+        s_Output.clear();
+        LEGACY_GeneratePatternDataBlock(dmd, 1, &patternSet, 1,
+                                        &orderTableEntry, collectPatternData,
+                                        eastWestFlip, longAxisFlip);
+        const std::vector<uint8_t> expected = s_Output;
+
+        s_Output.clear();
+        DLPC34XX_INT_PAT_GeneratePatternDataBlock(
+            dmd, 1, &patternSet, 1, &orderTableEntry, collectPatternData,
+            eastWestFlip, longAxisFlip);
+
+        isSame = !expected.empty() && expected == s_Output && isSame;
+    }
+
+    std::cout << "  " << name << ", " << (uint32_t)bitDepth << "-bit "
+              << (direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL
+                      ? "vertical"
+                      : "horizontal")
+              << ", all flips: " << (isSame ? "identical" : "MISMATCH")
+              << std::endl;
+
+    return isSame;
+}
+
+/**
+ * @brief 对比一位深度灰度线的两种打包方式，含东西翻转的反向段
+ *
+ * @return true 两条路径输出一致
+ */
+bool benchThreshold(const std::vector<uint8_t> &line) {
+    const uint32_t half = DLP4710_WIDTH / 2;
+    const DLPC34XX_INT_PAT_PixelSegment_s segments[2] = {
+        {half, half - 1, true}, {half, DLP4710_WIDTH - 1, true}};
+    std::vector<uint8_t> binary(line.size());
+    uint8_t expected[kLineBytes];
+    uint8_t actual[kLineBytes];
+
+    auto convertAndPack = [&] {
+        for (size_t x = 0; x < line.size(); ++x) {
+            binary[x] = line[x] >= 128 ? 1 : 0;
+        }
+        DLPC34XX_INT_PAT_PackBitPlanesSegments(binary.data(),
+                                               (uint32_t)binary.size(),
+                                               segments, 2, 1, expected,
+                                               kLineBytes);
+    };
+    auto thresholdPack = [&] {
+        DLPC34XX_INT_PAT_PackThresholdSegments(
+            line.data(), (uint32_t)line.size(), segments, 2, actual);
+    };
+
+    convertAndPack();
+    thresholdPack();
+    const bool isSame = memcmp(expected, actual, DLP4710_WIDTH / 8) == 0;
+
+    double convertUs = measureMicroseconds(kLineIterations, convertAndPack);
+    double thresholdUs = measureMicroseconds(kLineIterations, thresholdPack);
+
+    std::cout << "  1-bit gray line, flipped (" << DLP4710_WIDTH
+              << " px): convert+pack " << convertUs << " us, threshold-pack "
+              << thresholdUs << " us, speedup " << convertUs / thresholdUs
+              << "x, " << (isSame ? "identical" : "MISMATCH") << std::endl;
+
+    return isSame;
+}
+
+/**
+ * @brief 生成2N张相移图案组成的整个数据块
+ *
+ * @return true 各路径输出与原始编码器一致
+ */
+bool benchBlock(int numOfPatterns) {
+    std::vector<std::vector<uint8_t>> lines(numOfPatterns,
+                                            std::vector<uint8_t>(DLP4710_WIDTH));
+    std::vector<DLPC34XX_INT_PAT_PatternData_s> patterns(numOfPatterns);
+    for (int i = 0; i < numOfPatterns; ++i) {
+        for (int x = 0; x < DLP4710_WIDTH; ++x) {
+            lines[i][x] = (uint8_t)(127.5 + 127.5 * std::cos(
+                                                2 * kPi * x / 64.0 +
+                                                2 * kPi * i / numOfPatterns));
+        }
+        patterns[i].PixelArray = lines[i].data();
+        patterns[i].PixelArrayCount = DLP4710_WIDTH;
+    }
+
+    DLPC34XX_INT_PAT_PatternSet_s patternSet;
+    patternSet.BitDepth = DLPC34XX_INT_PAT_BITDEPTH_EIGHT;
+    patternSet.Direction = DLPC34XX_INT_PAT_DIRECTION_VERTICAL;
+    patternSet.PatternCount = numOfPatterns;
+    patternSet.PatternArray = patterns.data();
+    patternSet.ThresholdPixels = false;
+
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s orderTableEntry =
+        makeOrderTableEntry(numOfPatterns);
+
+    double legacyUs = measureMicroseconds(kBlockIterations, [&] {
+        s_Output.clear();
+        LEGACY_GeneratePatternDataBlock(
+            DLPC34XX_INT_PAT_DMD_DLP4710, 1, &patternSet, 1, &orderTableEntry,
+            collectPatternData, false, false);
+    });
+    const std::vector<uint8_t> legacy = s_Output;
+
+    double blockUs = measureMicroseconds(kBlockIterations, [&] {
+        s_Output.clear();
+        DLPC34XX_INT_PAT_GeneratePatternDataBlock(
+            DLPC34XX_INT_PAT_DMD_DLP4710, 1, &patternSet, 1, &orderTableEntry,
+            collectPatternData, false, false);
+    });
+    bool isSame = s_Output == legacy;
+    double blockCallbackUs = measureMicroseconds(kBlockIterations, [&] {
+        s_Output.clear();
+        DLPC34XX_INT_PAT_GeneratePatternDataBlockEx(
+            DLPC34XX_INT_PAT_DMD_DLP4710, 1, &patternSet, 1, &orderTableEntry,
+            collectPatternDataBlock, nullptr, false, false);
+    });
+
+    isSame = s_Output == legacy && isSame;
+
+    DLPC34XX_INT_PAT_Encoder_s encoder;
+    DLPC34XX_INT_PAT_InitEncoder(&encoder, DLPC34XX_INT_PAT_DMD_DLP4710, 1,
+                                 &patternSet, 1, &orderTableEntry, nullptr,
+                                 nullptr);
+    std::vector<uint8_t> block(DLPC34XX_INT_PAT_GetEncodedBlockSize(&encoder));
+    ThreadPool threadPool;
+    double blockParallelUs = measureMicroseconds(kBlockIterations, [&] {
+        DLPC34XX_INT_PAT_EncodeBlockLayout(&encoder, block.data(),
+                                           (uint32_t)block.size());
+        threadPool.parallelFor(2 * numOfPatterns, [&](size_t index, size_t) {
+            const uint32_t pattern = (uint32_t)index / 2;
+            const bool isMaster = index % 2 == 0;
+            const uint32_t offset = DLPC34XX_INT_PAT_GetPatternSlotOffset(
+                &encoder, 0, pattern, isMaster);
+            DLPC34XX_INT_PAT_EncodePatternSlot(&encoder, 0, pattern, isMaster,
+                                               false, false, &block[offset]);
+        });
+    });
+
+    isSame = block == legacy && isSame;
+
+    std::cout << "  DLP4710 block, " << numOfPatterns << " patterns: "
+              << legacy.size() << " bytes in " << legacyUs / 1000.0
+              << " ms (original), " << blockUs / 1000.0
+              << " ms (byte callback), " << blockCallbackUs / 1000.0
+              << " ms (block callback), " << blockParallelUs / 1000.0
+              << " ms (" << threadPool.getNumOfWorkers() << " threads), "
+              << (isSame ? "identical" : "MISMATCH") << std::endl;
+
+    return isSame;
+}
+
+} // namespace
+
+int main() {
+    std::cout << "Bit-plane packer: " << DLPC34XX_INT_PAT_GetPackerName()
+              << std::endl;
+
+    std::mt19937 rng(2024);
+    std::vector<uint8_t> line(DLP4710_WIDTH);
+    for (auto &pixel : line) {
+        pixel = (uint8_t)rng();
+    }
+
+    bool isSame = benchThreshold(line);
+
+    const struct {
+        const char *name_;
+        DLPC34XX_INT_PAT_DMD_e dmd_;
+        uint32_t width_;
+        uint32_t height_;
+    } dmds[] = {
+        {"DLP2010", DLPC34XX_INT_PAT_DMD_DLP2010, DLP2010_WIDTH, DLP2010_HEIGHT},
+        {"DLP3010", DLPC34XX_INT_PAT_DMD_DLP3010, DLP3010_WIDTH, DLP3010_HEIGHT},
+        {"DLP4710", DLPC34XX_INT_PAT_DMD_DLP4710, DLP4710_WIDTH, DLP4710_HEIGHT},
+    };
+    for (const auto &dmd : dmds) {
+        isSame = compareWithLegacy(dmd.name_, dmd.dmd_, dmd.width_,
+                                   DLPC34XX_INT_PAT_DIRECTION_VERTICAL,
+                                   DLPC34XX_INT_PAT_BITDEPTH_EIGHT) &&
+                 isSame;
+        isSame = compareWithLegacy(dmd.name_, dmd.dmd_, dmd.height_,
+                                   DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL,
+                                   DLPC34XX_INT_PAT_BITDEPTH_ONE) &&
+                 isSame;
+    }
+
+    isSame = benchBlock(12) && isSame;
+    isSame = benchBlock(24) && isSame;
+
+    return isSame ? 0 : 1;
+}
@@ -21,6 +21,7 @@
 #include "projector.h"
 #include "projectorDlpc34xx.h"
 #include "projectorDlpc34xxDual.h" // 投影仪工厂类头文件，提供投影仪实例创建功能
+#include "patternSource.h"
 #include <iostream>
 #include <chrono>
 #include <thread>
@@ -1113,6 +1114,42 @@ void testImageGeneration() {
     std::cout << "图像生成测试完成" << std::endl;
 }
 
+// ==================== 流式烧录测试 ====================
+
+/**
+ * @brief 从相移图案源流式烧录并连续投影
+ * @details 不生成整幅图像，每张图案只计算一条像素线，边编码边写入flash
+ */
+void testProjectorStreamPhaseShiftFringes() {
+    std::cout << "\n--- 测试流式烧录（四步相移条纹图案源） ---" << std::endl;
+
+    auto projectorFactory = slmaster::device::ProjectorFactory();
+    auto projectorDlpcApi = projectorFactory.getProjector(testProjector4710);
+    bool isSucess = projectorDlpcApi->connect();
+    assertTrue(isSucess, "投影仪连接成功");
+    if (!isSucess) { return; }
+
+    slmaster::device::PhaseShiftPatternSource source(1920, 1080, 15, 100, 128, 4);
+    source.setTiming(slmaster::device::Blue, 8000, 5000, 5000);
+
+    auto start = std::chrono::steady_clock::now();
+    isSucess = projectorDlpcApi->populatePatternTableData(source);
+    auto end = std::chrono::steady_clock::now();
+    assertTrue(isSucess, "流式烧录成功");
+    std::cout << "流式烧录耗时: "
+              << std::chrono::duration<double>(end - start).count() << " s" << std::endl;
+    if (!isSucess) { projectorDlpcApi->disConnect(); return; }
+
+    isSucess = projectorDlpcApi->project(true);
+    assertTrue(isSucess, "连续投影模式开始成功");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+    isSucess = projectorDlpcApi->stop();
+    assertTrue(isSucess, "投影停止成功");
+    isSucess = projectorDlpcApi->disConnect();
+    assertTrue(isSucess, "断开连接操作成功");
+}
+
 // ==================== LED控制功能测试 ====================
 
 /**
@@ -1178,6 +1215,7 @@ void runAllTests() {
 
     // 图案数据管理测试
     //testProjectorPopulatePatternTableData();//测试投影仪的图案数据管理是否成功
+    //testProjectorStreamPhaseShiftFringes();//测试从图案源流式烧录是否成功
 
     // 步进投影测试
     testProjectorStep();//测试投影仪的步进投影是否成功
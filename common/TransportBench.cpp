@@ -0,0 +1,133 @@
+/**
+ * @file TransportBench.cpp
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief 读命令单次耗时基准测试
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * 连续发送短状态读命令（isConnect()在每条投影仪命令前发送的命令），按命令统计输出
+ * 单次读取的平均值、中位数与99分位数：
+ * 1. sim      在模拟控制器上对比三种链路：Cypress桥接芯片（写与读各一次USB往返）、
+ *             i2c-dev写与读分开发送、i2c-dev组合传输（一次系统调用）
+ * 2. cypress  经由Cypress USB-Serial桥接芯片读取实际控制器
+ * 3. i2c-dev  经由Linux i2c-dev读取实际控制器
+ *
+ * 用法：
+ *   transportBench sim [reads]
+ *   transportBench cypress [reads]
+ *   transportBench i2c-dev [devicePath] [reads]
+ */
+
+#include "commandStats.h"
+#include "dlpc34xx.h"
+#include "simulatedDlpc.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace slmaster::device;
+
+namespace {
+
+constexpr int kDefaultReads = 200;
+constexpr uint8_t kShortStatusOpcode = 0xD0;
+
+uint8_t s_WriteBuffer[64];
+uint8_t s_ReadBuffer[64];
+
+/**
+ * @brief 经由指定传输连续读取短状态并输出单次耗时
+ *
+ * @return true 全部读取成功
+ */
+bool benchReads(const char *name, Transport &transport, const int reads) {
+    CommandContext context;
+    context.init(&transport, s_WriteBuffer, sizeof(s_WriteBuffer),
+                 s_ReadBuffer, sizeof(s_ReadBuffer));
+    CommandContextScope scope(context);
+    if (!transport.open()) {
+        std::cout << "  " << name << ": open failed" << std::endl;
+        return false;
+    }
+
+    context.getStats().reset();
+    context.getStats().enable(true);
+
+    bool isSucess = true;
+    for (int i = 0; i < reads && isSucess; ++i) {
+        DLPC34XX_ShortStatus_s shortStatus;
+        isSucess = DLPC34XX_ReadShortStatus(&shortStatus) == SUCCESS;
+    }
+
+    context.getStats().enable(false);
+    transport.close();
+
+    CommandOpcodeStats stats;
+    if (!context.getStats().getStats(kShortStatusOpcode, stats)) {
+        return false;
+    }
+
+    const uint64_t count = stats.reads_;
+    std::cout << "  " << name << ": " << count << " reads, mean "
+              << stats.totalSeconds_ * 1e6 / count << " us, p50 "
+              << stats.p50Seconds_ * 1e6 << " us, p99 "
+              << stats.p99Seconds_ * 1e6 << " us, failures "
+              << stats.failures_ << std::endl;
+
+    return isSucess;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const std::string mode = argc > 1 ? argv[1] : "sim";
+
+    if (mode == "sim") {
+        const int reads = argc > 2 ? std::atoi(argv[2]) : kDefaultReads;
+
+        SimulatedDlpcTiming split = SimulatedDlpcTiming::linuxI2c();
+        split.callsPerRead_ = 2;
+
+        SimulatedDlpcTransport cypress(SimulatedDlpcTiming::cypress(400000));
+        SimulatedDlpcTransport linuxSplit(split);
+        SimulatedDlpcTransport linuxCombined(SimulatedDlpcTiming::linuxI2c());
+
+        std::cout << "simulated link, short status reads" << std::endl;
+        bool isSucess = benchReads("cypress 400 kHz", cypress, reads);
+        isSucess &= benchReads("i2c-dev 400 kHz, split", linuxSplit, reads);
+        isSucess &=
+            benchReads("i2c-dev 400 kHz, combined", linuxCombined, reads);
+
+        return isSucess ? 0 : 1;
+    }
+
+    if (mode == "cypress") {
+        const int reads = argc > 2 ? std::atoi(argv[2]) : kDefaultReads;
+
+        CypressTransport transport;
+        std::cout << "cypress bridge, short status reads" << std::endl;
+
+        return benchReads("cypress", transport, reads) ? 0 : 1;
+    }
+
+    if (mode == "i2c-dev") {
+        const std::string path = argc > 2 ? argv[2] : "/dev/i2c-1";
+        const int reads = argc > 3 ? std::atoi(argv[3]) : kDefaultReads;
+
+        LinuxI2cTransport transport(path);
+        std::cout << path << ", short status reads" << std::endl;
+
+        return benchReads("i2c-dev", transport, reads) ? 0 : 1;
+    }
+
+    std::cout << "usage: transportBench sim|cypress|i2c-dev [devicePath] "
+                 "[reads]"
+              << std::endl;
+
+    return 1;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file fnvHash.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_FNV_HASH_H_
+#define __PROJECTOR_FNV_HASH_H_
+
+#include "typeDef.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+//FNV-1a 64的初始哈希
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+
+/**
+ * @brief 以FNV-1a 64累加哈希
+ * @note 图案源指纹、数据块哈希与flash校验共用；结果保存在缓存与指纹记录文件中，不能更改算法
+ *
+ * @param data 数据
+ * @param length 数据长度
+ * @param hash 之前的哈希
+ * @return uint64_t 新的哈希
+ */
+inline uint64_t fnvHash(IN const void *data, IN const size_t length,
+                        IN uint64_t hash = kFnvOffsetBasis) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_FNV_HASH_H_
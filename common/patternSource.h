@@ -0,0 +1,254 @@
+/**
+ * @file patternSource.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_PATTERN_SOURCE_H_
+#define __PROJECTOR_PATTERN_SOURCE_H_
+
+#include "projector.h"
+
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief N步相移条纹图案源
+ * @note 先竖直N张、再水平N张，各为一个集合，灰度为offset+intensity*sin(2π*frequency*t+2πk/N)；
+ *       每张图案只在需要时计算一条像素线，不生成整幅图像。像素线只由构造参数决定，不加噪声，
+ *       指纹由构造参数计算
+ */
+class PhaseShiftPatternSource : public PatternSource {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param width 幅面宽度
+     * @param height 幅面高度
+     * @param frequency 条纹频率（整幅中的周期数）
+     * @param intensity 振幅
+     * @param offset 亮度偏移
+     * @param steps 相移步数N
+     * @param isWithHorizontal 是否包含水平条纹集合
+     */
+    PhaseShiftPatternSource(IN const int width, IN const int height,
+                            IN const int frequency, IN const int intensity,
+                            IN const int offset, IN const int steps,
+                            IN const bool isWithHorizontal = true)
+        : width_(width), height_(height), frequency_(frequency),
+          intensity_(std::min(std::max(intensity, 0), 255)),
+          offset_(std::min(std::max(offset, 0), 255)), steps_(steps),
+          isWithHorizontal_(isWithHorizontal), illumination_(Blue),
+          exposureTime_(8000), preExposureTime_(5000), postExposureTime_(5000) {
+    }
+    /**
+     * @brief 设置LED与曝光时间，应用于所有集合
+     *
+     * @param illumination LED控制
+     * @param exposureTime 曝光时间(us)
+     * @param preExposureTime 曝光前时间(us)
+     * @param postExposureTime 曝光后时间(us)
+     */
+    void setTiming(IN const Illumination illumination,
+                   IN const int exposureTime, IN const int preExposureTime,
+                   IN const int postExposureTime) {
+        illumination_ = illumination;
+        exposureTime_ = exposureTime;
+        preExposureTime_ = preExposureTime;
+        postExposureTime_ = postExposureTime;
+    }
+
+    size_t getNumOfPatternSets() override {
+        if (width_ <= 0 || height_ <= 0 || frequency_ <= 0 || steps_ <= 0) {
+            return 0;
+        }
+
+        return isWithHorizontal_ ? 2 : 1;
+    }
+
+    bool getPatternSet(IN const size_t index,
+                       OUT PatternProfileSet &set) override {
+        set.profiles_.assign(steps_, PatternProfile());
+        for (auto &profile : set.profiles_) {
+            profile.isVertical_ = index == 0;
+        }
+        set.illumination_ = illumination_;
+        set.invertPatterns_ = false;
+        set.isOneBit_ = false;
+        set.isRawOneBit_ = false;
+        set.exposureTime_ = exposureTime_;
+        set.preExposureTime_ = preExposureTime_;
+        set.postExposureTime_ = postExposureTime_;
+
+        return index < getNumOfPatternSets();
+    }
+
+    bool getProfile(IN const size_t setIndex, IN const size_t patternIndex,
+                    OUT PatternProfile &profile) override {
+        if (setIndex >= getNumOfPatternSets() ||
+            patternIndex >= (size_t)steps_) {
+            return false;
+        }
+
+        const double twoPi = 2.0 * 3.14159265358979323846;
+        const double phase = twoPi * patternIndex / steps_;
+        const int length = setIndex == 0 ? width_ : height_;
+
+        profile.isVertical_ = setIndex == 0;
+        profile.line_.resize(length);
+        for (int i = 0; i < length; ++i) {
+            const double t = static_cast<double>(i) / length;
+            const long gray = std::lround(
+                offset_ + intensity_ * std::sin(twoPi * frequency_ * t + phase));
+            profile.line_[i] = (uint8_t)std::min(std::max(gray, 0L), 255L);
+        }
+
+        return true;
+    }
+
+    uint64_t getFingerprint() override {
+        const char kind[] = "PhaseShiftPatternSource";
+        const int params[] = {width_,     height_, frequency_,
+                              intensity_, offset_, steps_,
+                              isWithHorizontal_ ? 1 : 0};
+
+        return hashBytes(params, sizeof(params), hashBytes(kind, sizeof(kind)));
+    }
+
+  private:
+    //幅面宽度
+    const int width_;
+    //幅面高度
+    const int height_;
+    //条纹频率
+    const int frequency_;
+    //振幅
+    const int intensity_;
+    //亮度偏移
+    const int offset_;
+    //相移步数
+    const int steps_;
+    //是否包含水平条纹集合
+    const bool isWithHorizontal_;
+    //LED控制
+    Illumination illumination_;
+    //曝光时间(us)
+    int exposureTime_;
+    //曝光前时间(us)
+    int preExposureTime_;
+    //曝光后时间(us)
+    int postExposureTime_;
+};
+
+/**
+ * @brief 图片文件图案源
+ * @note 每次只读取一张图片并提取像素线，内存占用与图片数量无关；
+ *       指纹由图片文件的字节计算，只读取文件不解码图片
+ */
+class ImageFilePatternSource : public PatternSource {
+  public:
+    /**
+     * @brief 添加一个集合
+     *
+     * @param set 集合参数，imgs_不使用
+     * @param paths 集合中图片的路径，按投影顺序
+     */
+    void addPatternSet(IN const PatternOrderSet &set,
+                       IN const std::vector<std::string> &paths) {
+        sets_.push_back(set);
+        sets_.back().imgs_.clear();
+        paths_.push_back(paths);
+    }
+
+    size_t getNumOfPatternSets() override { return sets_.size(); }
+
+    bool getPatternSet(IN const size_t index,
+                       OUT PatternProfileSet &set) override {
+        if (index >= sets_.size()) {
+            return false;
+        }
+
+        const PatternOrderSet &orderSet = sets_[index];
+        set.profiles_.assign(paths_[index].size(), PatternProfile());
+        for (auto &profile : set.profiles_) {
+            profile.isVertical_ = orderSet.isVertical_;
+        }
+        set.illumination_ = orderSet.illumination_;
+        set.invertPatterns_ = orderSet.invertPatterns_;
+        set.isOneBit_ = orderSet.isOneBit_;
+        set.isRawOneBit_ = orderSet.isOneBit_;
+        set.exposureTime_ = orderSet.exposureTime_;
+        set.preExposureTime_ = orderSet.preExposureTime_;
+        set.postExposureTime_ = orderSet.postExposureTime_;
+
+        return true;
+    }
+
+    bool getProfile(IN const size_t setIndex, IN const size_t patternIndex,
+                    OUT PatternProfile &profile) override {
+        if (setIndex >= sets_.size() ||
+            patternIndex >= paths_[setIndex].size()) {
+            return false;
+        }
+
+        const PatternOrderSet &set = sets_[setIndex];
+        return toPatternProfile(
+            cv::imread(paths_[setIndex][patternIndex], cv::IMREAD_GRAYSCALE),
+            set.isVertical_, set.patternArrayCounts_, profile);
+    }
+
+    uint64_t getFingerprint() override {
+        const char kind[] = "ImageFilePatternSource";
+        uint64_t hash = hashBytes(kind, sizeof(kind));
+        std::vector<char> buffer(64 * 1024);
+        for (size_t i = 0; i < sets_.size(); ++i) {
+            const int params[] = {sets_[i].isVertical_ ? 1 : 0,
+                                  sets_[i].patternArrayCounts_};
+            hash = hashBytes(params, sizeof(params), hash);
+
+            for (const auto &path : paths_[i]) {
+                // 只读取文件字节不解码图片；保留修改时间的同尺寸替换也会改变指纹
+                std::ifstream file(path, std::ios::binary);
+                if (!file) {
+                    return 0;
+                }
+
+                uint64_t size = 0;
+                while (file.read(buffer.data(), buffer.size()) ||
+                       file.gcount() > 0) {
+                    hash = hashBytes(buffer.data(), (size_t)file.gcount(),
+                                     hash);
+                    size += (uint64_t)file.gcount();
+                }
+                if (file.bad()) {
+                    return 0;
+                }
+
+                hash = hashBytes(&size, sizeof(size), hash);
+            }
+        }
+
+        return hash;
+    }
+
+  private:
+    //集合参数
+    std::vector<PatternOrderSet> sets_;
+    //每个集合的图片路径
+    std::vector<std::vector<std::string>> paths_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_PATTERN_SOURCE_H_
@@ -12,10 +12,15 @@
 #ifndef __PROJECTOR_H_
 #define __PROJECTOR_H_
 
+#include "fnvHash.h"
 #include "typeDef.h"
 
 #include <opencv2/opencv.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
 namespace slmaster {
 /** @brief 设备库 */
 namespace device {
@@ -36,12 +41,220 @@ struct DEVICE_API PatternOrderSet {
     int postExposureTime_;      // 曝光后时间(us)
 };
 
+/**
+ * @brief 一维投影图案
+ * @note DLPC34xx内部图案每张只存储一条像素线，直接使用像素线可免去整幅图像的内存与转置开销
+ */
+struct DEVICE_API PatternProfile {
+    std::vector<uint8_t> line_; // 像素线，竖直图案为一行，水平图案为一列
+    bool isVertical_;           // 是否竖直图案（像素线沿图像行方向）
+};
+
+/** @brief 一维投影图案集合 */
+struct DEVICE_API PatternProfileSet {
+    std::vector<PatternProfile> profiles_; // 集合中的图案，方向需一致
+    Illumination illumination_;            // LED控制
+    bool invertPatterns_;                  // 反转图片
+    bool isOneBit_;                        // 是否为一位深度，像素取值为0或1
+    bool isRawOneBit_ = false;             // 一位深度像素为原始灰度，编码时不小于128为1
+    int exposureTime_;                     // 曝光时间(us)
+    int preExposureTime_;                  // 曝光前时间(us)
+    int postExposureTime_;                 // 曝光后时间(us)
+};
+
+/**
+ * @brief 从图片提取一维图案
+ * @note 竖直图案取第一行，水平图案取第一列，最多取maxCount个像素
+ *
+ * @param img 图片，需为CV_8UC1
+ * @param isVertical 是否竖直图案
+ * @param maxCount 最大像素数
+ * @param profile 一维图案，复用已有的像素线内存
+ * @return true 成功
+ * @return false 图片为空或类型不是CV_8UC1
+ */
+inline bool toPatternProfile(IN const cv::Mat &img, IN const bool isVertical,
+                             IN const int maxCount,
+                             OUT PatternProfile &profile) {
+    if (img.empty() || img.type() != CV_8UC1) {
+        return false;
+    }
+
+    const int length = isVertical ? img.cols : img.rows;
+    const int count = std::min(std::max(maxCount, 0), length);
+
+    profile.isVertical_ = isVertical;
+    profile.line_.resize(count);
+    if (isVertical) {
+        std::copy(img.ptr<uint8_t>(0), img.ptr<uint8_t>(0) + count,
+                  profile.line_.begin());
+    } else {
+        for (int j = 0; j < count; ++j) {
+            profile.line_[j] = img.at<uint8_t>(j, 0);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief 从图案集提取一维图案集合
+ * @note 竖直图案取第一行，水平图案取第一列，最多取patternArrayCounts_个像素；
+ *       一位深度图案保留原始灰度并置isRawOneBit_，由编码器打包时二值化（不小于128时为1）
+ *
+ * @param set 投影图案集，图片需为CV_8UC1
+ * @param profileSet 一维图案集合
+ * @return true 成功
+ * @return false 图片为空或类型不是CV_8UC1
+ */
+inline bool toPatternProfileSet(IN const PatternOrderSet &set,
+                                OUT PatternProfileSet &profileSet) {
+    profileSet.profiles_.resize(set.imgs_.size());
+    profileSet.illumination_ = set.illumination_;
+    profileSet.invertPatterns_ = set.invertPatterns_;
+    profileSet.isOneBit_ = set.isOneBit_;
+    profileSet.isRawOneBit_ = set.isOneBit_;
+    profileSet.exposureTime_ = set.exposureTime_;
+    profileSet.preExposureTime_ = set.preExposureTime_;
+    profileSet.postExposureTime_ = set.postExposureTime_;
+
+    for (size_t i = 0; i < set.imgs_.size(); ++i) {
+        if (!toPatternProfile(set.imgs_[i], set.isVertical_,
+                              set.patternArrayCounts_,
+                              profileSet.profiles_[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief 按需生成一维图案的图案源
+ * @note 流式烧录时逐张取出像素线，边生成边编码边写入flash，内存占用与图案数量无关；
+ *       每张图案在一次烧录中只读取一次
+ */
+class DEVICE_API PatternSource {
+  public:
+    virtual ~PatternSource() {}
+    /**
+     * @brief 获取图案集合数量
+     *
+     * @return size_t 图案集合数量
+     */
+    virtual size_t getNumOfPatternSets() = 0;
+    /**
+     * @brief 获取图案集合的参数
+     *
+     * @param index 集合索引
+     * @param set 集合参数，profiles_只需给出图案数量与方向，像素线可为空
+     * @return true 成功
+     * @return false 失败
+     */
+    virtual bool getPatternSet(IN const size_t index,
+                               OUT PatternProfileSet &set) = 0;
+    /**
+     * @brief 生成一张图案的像素线
+     *
+     * @param setIndex 集合索引
+     * @param patternIndex 图案在集合中的索引
+     * @param profile 一维图案，复用已有的像素线内存
+     * @return true 成功
+     * @return false 失败，将中止烧录
+     */
+    virtual bool getProfile(IN const size_t setIndex,
+                            IN const size_t patternIndex,
+                            OUT PatternProfile &profile) = 0;
+    /**
+     * @brief 获取像素线内容的指纹，不生成像素线
+     * @note 指纹相同时须生成相同的像素线，用于判断flash中是否已是相同的图案；
+     *       能以很小的代价得到时实现，如由生成参数或未解码的文件字节计算；
+     *       不能只用文件的路径、大小与修改时间，保留修改时间的替换不会改变它们
+     *
+     * @return uint64_t 指纹，0表示无法给出，此时每次都擦除并烧录
+     */
+    virtual uint64_t getFingerprint() { return 0; }
+
+  protected:
+    /**
+     * @brief 以FNV-1a累加哈希，供派生类计算指纹
+     *
+     * @param data 数据
+     * @param length 数据长度
+     * @param hash 之前的哈希
+     * @return uint64_t 新的哈希
+     */
+    static uint64_t hashBytes(IN const void *data, IN const size_t length,
+                              IN uint64_t hash = kFnvOffsetBasis) {
+        return fnvHash(data, length, hash);
+    }
+};
+
+/** @brief 图案数据块缓存统计 */
+struct DEVICE_API PatternCacheStats {
+    uint64_t hits_;        // 命中次数
+    uint64_t misses_;      // 未命中次数
+    uint64_t stores_;      // 写入次数
+    uint64_t bytesLoaded_; // 命中时读取的字节数
+};
+
+/**
+ * @brief 最近一次flash烧录的统计
+ * @note encoderStallSeconds_较大说明链路是瓶颈，linkIdleSeconds_较大说明编码是瓶颈
+ */
+struct DEVICE_API FlashProgramStats {
+    uint64_t bytes_;             // 烧录字节数
+    uint32_t chunks_;            // 写入命令数量
+    uint32_t chunkSize_;         // 最后使用的写入命令数据长度
+    double seconds_;             // 从开始烧录到全部写入完成的耗时(s)
+    double bytesPerSecond_;      // 平均吞吐量(B/s)
+    double meanChunkSeconds_;    // 写入命令的平均发送耗时(s)
+    double maxChunkSeconds_;     // 写入命令的最大发送耗时(s)
+    double encoderStallSeconds_; // 编码器等待空闲写入块的时间(s)
+    double linkIdleSeconds_;     // I/O线程等待数据的时间(s)
+};
+
+/** @brief 图案表烧录预估，不访问设备 */
+struct DEVICE_API PatternTablePlan {
+    bool isValid_;            // 图案表是否有效
+    uint32_t blockSize_;      // 数据块字节数
+    uint32_t flashCapacity_;  // 控制器flash图案数据区字节数
+    bool isFitFlash_;         // 数据块能否放入图案数据区
+    bool isProgrammed_;       // flash中是否已是该数据块，烧录时将跳过擦除与烧录
+    double estimatedSeconds_; // 预估擦除与烧录耗时(s)，按实测的链路吞吐量
+};
+
+/** @brief 后台状态检查发现的控制器故障 */
+struct DEVICE_API ProjectorFault {
+    bool isLinkLost_;           // 状态读取失败
+    bool isSystemError_;        // 短状态报告系统错误
+    bool isCommunicationError_; // 短状态报告通信错误
+    bool isDmdError_;           // 系统状态报告DMD器件、接口或训练错误
+    bool isLedError_;           // 系统状态报告LED错误
+    bool isSequenceError_;      // 系统状态报告序列中止或序列错误
+
+    /**
+     * @brief 是否存在故障
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isFault() const {
+        return isLinkLost_ || isSystemError_ || isCommunicationError_ ||
+               isDmdError_ || isLedError_ || isSequenceError_;
+    }
+};
+
+/** @brief 控制器故障回调，在后台检查线程中调用 */
+using ProjectorFaultCallback = std::function<void(const ProjectorFault &)>;
+
 /** @brief 相机信息 **/
 struct DEVICE_API ProjectorInfo {
-    std::string dlpEvmType_; // DLP评估模块
-    int width_;              // 幅面宽度
-    int height_;             // 幅面高度
-    bool isFind_;            // 是否找到
+    std::string dlpEvmType_;     // DLP评估模块
+    int width_;                  // 幅面宽度
+    int height_;                 // 幅面高度
+    bool isFind_;                // 是否找到
+    uint32_t i2cClockFrequency_; // 协商后的I2C时钟频率(Hz)，未连接时为0
 };
 
 /** @brief 投影仪控制类 */
@@ -75,13 +288,106 @@ class DEVICE_API Projector {
      * @return false 失败
      */
     virtual bool isConnect() = 0;
+    /**
+     * @brief 从一维图案集合制作投影序列
+     *
+     * @param table 一维图案集合
+     * @return true 成功
+     * @return false 失败
+     */
+    virtual bool populatePatternTableData(
+        IN const std::vector<PatternProfileSet> &table) = 0;
     /**
      * @brief 从图案集制作投影序列
+     * @note 提取每张图片的像素线后调用一维图案接口，见toPatternProfileSet
      *
      * @param table 投影图案集
      */
     virtual bool
-    populatePatternTableData(IN std::vector<PatternOrderSet> table) = 0;
+    populatePatternTableData(IN std::vector<PatternOrderSet> table) {
+        std::vector<PatternProfileSet> profileTable(table.size());
+        for (size_t i = 0; i < table.size(); ++i) {
+            if (!toPatternProfileSet(table[i], profileTable[i])) {
+                return false;
+            }
+        }
+
+        return populatePatternTableData(profileTable);
+    }
+    /**
+     * @brief 从图案源流式制作投影序列
+     * @note 默认实现先取出全部像素线再调用一维图案接口；支持流式烧录的投影仪逐张生成、
+     *       编码并写入flash，第一块数据在最后一张图案生成之前即开始烧录。
+     *       是否跳过烧录由集合参数与PatternSource::getFingerprint()判断，不预先读取图案
+     *
+     * @param source 图案源
+     * @return true 成功
+     * @return false 失败
+     */
+    virtual bool populatePatternTableData(IN PatternSource &source) {
+        std::vector<PatternProfileSet> table(source.getNumOfPatternSets());
+        for (size_t i = 0; i < table.size(); ++i) {
+            if (!source.getPatternSet(i, table[i])) {
+                return false;
+            }
+
+            for (size_t j = 0; j < table[i].profiles_.size(); ++j) {
+                if (!source.getProfile(i, j, table[i].profiles_[j])) {
+                    return false;
+                }
+            }
+        }
+
+        return populatePatternTableData(table);
+    }
+    /**
+     * @brief 预估一维图案集合的烧录，不访问设备
+     * @note 在擦除flash之前发现无效或过大的图案表，并给出预计耗时
+     *
+     * @param table 一维图案集合
+     * @param plan 预估结果
+     * @return true 图案表有效且能放入flash
+     * @return false 不支持、图案表无效或超出flash容量
+     */
+    virtual bool planPatternTableData(
+        IN const std::vector<PatternProfileSet> &table,
+        OUT PatternTablePlan &plan) {
+        plan = PatternTablePlan();
+        return false;
+    }
+    /**
+     * @brief 预估图案集的烧录，不访问设备
+     * @note 提取每张图片的像素线后调用一维图案接口，见toPatternProfileSet
+     *
+     * @param table 投影图案集
+     * @param plan 预估结果
+     * @return true 图案表有效且能放入flash
+     * @return false 不支持、图案表无效或超出flash容量
+     */
+    virtual bool planPatternTableData(IN const std::vector<PatternOrderSet> &table,
+                                      OUT PatternTablePlan &plan) {
+        plan = PatternTablePlan();
+
+        std::vector<PatternProfileSet> profileTable(table.size());
+        for (size_t i = 0; i < table.size(); ++i) {
+            if (!toPatternProfileSet(table[i], profileTable[i])) {
+                return false;
+            }
+        }
+
+        return planPatternTableData(profileTable, plan);
+    }
+    /**
+     * @brief 从离线编译的图案数据块文件（.patn）制作投影序列
+     * @note 数据块以内存映射方式直接烧录，不解码图片也不重新编码
+     *
+     * @param path 数据块文件路径
+     * @return true 成功
+     * @return false 不支持、文件无效或DMD不一致
+     */
+    virtual bool loadPatternBlockFile(IN const std::string &path) {
+        return false;
+    }
     /**
      * @brief 投影
      *
@@ -146,6 +452,55 @@ class DEVICE_API Projector {
      * @return int 图片数量
      */
     virtual int getFlashImgsNum() = 0;
+    /**
+     * @brief 设置图案数据块缓存目录
+     * @note 图案内容未变化时直接烧录缓存的数据块，不再重新编码；
+     *       目录中同时按设备标识记录flash中数据块的指纹，重启后内容未变化时跳过擦除与烧录，
+     *       多台投影仪可共用同一目录；设备标识未知时指纹只记录在内存中。空字符串表示关闭缓存
+     *
+     * @param directory 缓存目录
+     * @return true 成功
+     * @return false 不支持或目录不可用
+     */
+    virtual bool setPatternCacheDirectory(IN const std::string &directory) {
+        return false;
+    }
+    /**
+     * @brief 获取图案数据块缓存统计
+     *
+     * @return PatternCacheStats 统计
+     */
+    virtual PatternCacheStats getPatternCacheStats() {
+        return PatternCacheStats();
+    }
+    /**
+     * @brief 获取最近一次flash烧录的统计
+     * @note 烧录期间也可调用，返回调用时的统计快照
+     *
+     * @return FlashProgramStats 统计，尚未烧录时全部为0
+     */
+    virtual FlashProgramStats getFlashProgramStats() {
+        return FlashProgramStats();
+    }
+    /**
+     * @brief 开启快速控制
+     * @note project/stop/pause/resume/step只发送控制命令，不再先读取短状态；
+     *       后台线程按间隔读取短状态与系统状态，发现故障时调用onFault，
+     *       故障期间控制命令返回失败。命令进行中时后台线程跳过本次检查，不占用链路
+     *
+     * @param interval 检查间隔
+     * @param onFault 故障回调，每次由正常变为故障时调用一次
+     * @return true 成功
+     * @return false 不支持或未连接
+     */
+    virtual bool enableFastControl(IN const std::chrono::milliseconds interval,
+                                   IN const ProjectorFaultCallback &onFault) {
+        return false;
+    }
+    /**
+     * @brief 关闭快速控制，停止后台检查，控制命令前重新读取短状态
+     */
+    virtual void disableFastControl() {}
 
   private:
 };
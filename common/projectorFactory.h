@@ -12,6 +12,7 @@
 #ifndef __PROJECTORY_FACTORY_H_
 #define __PROJECTORY_FACTORY_H_
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -50,6 +51,39 @@ class DEVICE_API ProjectorFactory {
 
         return projector;
     }
+    /**
+     * @brief 获取经由指定Cypress USB-Serial桥接芯片连接的投影仪
+     * @note 同一进程中可同时使用多台同型号投影仪，各自独立收发命令
+     *
+     * @param dlpEvm DLP评估模块
+     * @param serialNumber 桥接芯片的USB序列号
+     * @return Projector* 投影仪，不支持的型号为空
+     */
+    Projector *getProjector(const std::string dlpEvm,
+                            const std::string serialNumber) {
+        const std::string key = dlpEvm + "#" + serialNumber;
+        if (projectoies_.count(key)) {
+            return projectoies_[key];
+        }
+
+        auto transport = std::make_shared<CypressTransport>(serialNumber);
+        Projector *projector = nullptr;
+        if ("DLP4710" == dlpEvm) {
+            auto dual = new ProjectorDlpc34xxDual();
+            dual->setTransport(transport);
+            projector = dual;
+        } else if ("DLP3010" == dlpEvm) {
+            auto single = new ProjectorDlpc34xx();
+            single->setTransport(transport);
+            projector = single;
+        }
+
+        if (projector) {
+            projectoies_[key] = projector;
+        }
+
+        return projector;
+    }
 
   private:
     std::unordered_map<std::string, Projector *> projectoies_;
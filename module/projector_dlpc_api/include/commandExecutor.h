@@ -0,0 +1,178 @@
+/**
+ * @file commandExecutor.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_COMMAND_EXECUTOR_H_
+#define __PROJECTOR_COMMAND_EXECUTOR_H_
+
+#include "transport.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/** @brief 控制器命令的优先级，数值越小越先执行 */
+enum class CommandPriority {
+    Critical = 0, //时序关键的投影控制：步进、开始、停止
+    Normal,       //一般的设置与查询
+    Background,   //flash烧录等批量工作与后台状态检查
+};
+
+/**
+ * @brief 每台投影仪的命令执行线程
+ * @note 所有控制器命令都在该线程中按优先级依次执行，同一优先级先提交先执行，
+ *       命令之间不会交错；执行线程选择投影仪的命令库上下文。
+ *       批量工作在没有命令传输的间隙调用runUrgent()，排队的关键命令可插在其中执行
+ */
+class DEVICE_API CommandExecutor {
+  public:
+    /**
+     * @brief 构造，启动执行线程
+     *
+     * @param context 执行线程使用的命令库上下文，需在执行器析构前保持有效
+     */
+    explicit CommandExecutor(IN CommandContext &context);
+    /**
+     * @brief 析构，执行完已提交的命令后退出
+     */
+    ~CommandExecutor();
+    CommandExecutor(const CommandExecutor &) = delete;
+    CommandExecutor &operator=(const CommandExecutor &) = delete;
+    /**
+     * @brief 提交命令
+     *
+     * @param priority 优先级
+     * @param function 命令
+     * @return std::future 命令的返回值
+     */
+    template <typename Function>
+    auto submit(IN const CommandPriority priority, IN Function &&function)
+        -> std::future<decltype(function())>;
+    /**
+     * @brief 提交命令并等待完成
+     * @note 在命令中调用时直接执行，避免等待自身
+     *
+     * @param priority 优先级
+     * @param function 命令
+     * @return 命令的返回值
+     */
+    template <typename Function>
+    auto execute(IN const CommandPriority priority, IN Function &&function)
+        -> decltype(function());
+    /**
+     * @brief 在调用线程中执行排队的关键命令
+     * @note 只能在正在执行的命令（或其I/O线程）没有命令传输时调用
+     */
+    void runUrgent();
+    /**
+     * @brief 在调用线程中执行关键命令直到指定时刻，期间新提交的关键命令立即执行
+     * @note 供批量工作在等待控制器时代替休眠，调用条件同runUrgent()
+     *
+     * @param deadline 返回时刻
+     */
+    void runUrgentUntil(IN const std::chrono::steady_clock::time_point deadline);
+    /**
+     * @brief 调用线程是否正在执行本执行器的命令
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isInTask() const;
+    /**
+     * @brief 是否有命令在执行或排队
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isBusy();
+    /**
+     * @brief 获取插在批量工作中执行的关键命令数量
+     *
+     * @return uint64_t 数量
+     */
+    uint64_t getNumOfUrgentRuns();
+
+  private:
+    /**
+     * @brief 加入命令队列
+     *
+     * @param priority 优先级
+     * @param task 命令
+     */
+    void enqueue(IN const CommandPriority priority,
+                 IN std::function<void()> &&task);
+    /**
+     * @brief 在调用线程中执行命令，期间isInTask()为true
+     *
+     * @param task 命令
+     */
+    void invoke(IN const std::function<void()> &task);
+    /**
+     * @brief 执行线程主循环
+     */
+    void run();
+    //执行线程使用的命令库上下文
+    CommandContext &context_;
+    //保护以下状态
+    std::mutex mutex_;
+    //新命令到达或退出
+    std::condition_variable wakeUp_;
+    //关键命令到达或退出，唤醒runUrgentUntil()
+    std::condition_variable urgentQueued_;
+    //各优先级的命令队列
+    std::array<std::deque<std::function<void()>>, 3> queues_;
+    //执行线程是否正在执行命令
+    bool isExecuting_;
+    //插在批量工作中执行的关键命令数量
+    uint64_t numOfUrgentRuns_;
+    //是否退出
+    bool isExit_;
+    //执行线程
+    std::thread thread_;
+};
+
+template <typename Function>
+auto CommandExecutor::submit(const CommandPriority priority,
+                             Function &&function)
+    -> std::future<decltype(function())> {
+    using Result = decltype(function());
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Function>(function));
+    std::future<Result> result = task->get_future();
+    enqueue(priority, [task] { (*task)(); });
+
+    return result;
+}
+
+template <typename Function>
+auto CommandExecutor::execute(const CommandPriority priority,
+                              Function &&function) -> decltype(function()) {
+    if (isInTask()) {
+        return function();
+    }
+
+    return submit(priority, std::forward<Function>(function)).get();
+}
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_COMMAND_EXECUTOR_H_
@@ -0,0 +1,124 @@
+/**
+ * @file commandStats.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_COMMAND_STATS_H_
+#define __PROJECTOR_COMMAND_STATS_H_
+
+#include "typeDef.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/** @brief 单个操作码的命令统计快照 */
+struct DEVICE_API CommandOpcodeStats {
+    uint8_t opcode_;         //操作码
+    uint64_t writes_;        //只写命令次数
+    uint64_t reads_;         //读命令次数
+    uint64_t failures_;      //传输失败次数
+    uint64_t retries_;       //失败后重发的次数，重发的命令同样计入writes_/reads_
+    uint64_t bytesSent_;     //发送字节数，含操作码
+    uint64_t bytesReceived_; //接收字节数
+    double totalSeconds_;    //总耗时(s)
+    double maxSeconds_;      //最大耗时(s)
+    double p50Seconds_;      //耗时中位数(s)
+    double p90Seconds_;      //耗时90分位数(s)
+    double p99Seconds_;      //耗时99分位数(s)
+};
+
+/**
+ * @brief 单个命令库上下文的命令统计
+ * @note 统计位于命令库的读写回调中，即DLPC_COMMON_SendWrite()/SendRead()的下一层，
+ *       由CommandContext持有，同一进程中的多个投影仪互不影响；关闭时每条命令只多一次原子读取。
+ *       计数与直方图均为无锁原子变量，可在任意线程读取。
+ *       命令层失败即返回不重发，重发由上层决定，目前只有flash烧录会按相同长度重发被丢弃的数据命令，
+ *       由其调用recordRetry()计入
+ */
+class DEVICE_API CommandStats {
+  public:
+    CommandStats();
+    ~CommandStats();
+    CommandStats(const CommandStats &) = delete;
+    CommandStats &operator=(const CommandStats &) = delete;
+    /**
+     * @brief 开启或关闭命令统计
+     *
+     * @param isEnable 是否开启
+     */
+    void enable(IN const bool isEnable);
+    /**
+     * @brief 命令统计是否开启
+     *
+     * @return true 开启
+     * @return false 关闭
+     */
+    bool isEnabled() const;
+    /**
+     * @brief 清零全部统计
+     */
+    void reset();
+    /**
+     * @brief 记录一条命令
+     *
+     * @param opcode 操作码
+     * @param bytesSent 发送字节数
+     * @param bytesReceived 接收字节数，0表示只写命令
+     * @param microseconds 耗时(us)
+     * @param isSucess 传输是否成功
+     */
+    void record(IN const uint8_t opcode, IN const uint32_t bytesSent,
+                IN const uint32_t bytesReceived,
+                IN const uint64_t microseconds, IN const bool isSucess);
+    /**
+     * @brief 记录一次重发，在重发失败的命令前调用
+     *
+     * @param opcode 操作码
+     */
+    void recordRetry(IN const uint8_t opcode);
+    /**
+     * @brief 获取单个操作码的统计
+     *
+     * @param opcode 操作码
+     * @param stats 统计快照
+     * @return true 该操作码有记录
+     * @return false 无记录
+     */
+    bool getStats(IN const uint8_t opcode, OUT CommandOpcodeStats &stats) const;
+    /**
+     * @brief 以JSON导出全部有记录的操作码的统计与耗时直方图
+     * @note 直方图为对数线性分桶，每个2的幂区间8个桶，相对误差不超过12.5%；
+     *       每个桶输出为[下界us, 次数]，只输出非空的桶
+     *
+     * @return std::string JSON
+     */
+    std::string toJson() const;
+
+  private:
+    struct OpcodeCounters;
+    /**
+     * @brief 读取单个操作码的计数与直方图
+     */
+    bool takeSnapshot(const uint8_t opcode, CommandOpcodeStats &stats,
+                      uint32_t *buckets) const;
+    //是否开启
+    std::atomic<bool> isEnabled_;
+    //按操作码索引的计数，共256个
+    std::unique_ptr<OpcodeCounters[]> counters_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_COMMAND_STATS_H_
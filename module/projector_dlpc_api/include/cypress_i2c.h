@@ -48,13 +48,48 @@ extern "C" {
 #include "stdbool.h"
 #include "stdint.h"
 
-bool CYPRESS_I2C_RequestI2CBusAccess();
-bool CYPRESS_I2C_RelinquishI2CBusAccess();
-bool CYPRESS_I2C_WriteI2C(uint32_t WriteDataLength, uint8_t* WriteData);
-bool CYPRESS_I2C_ReadI2C(uint32_t ReadDataLength, uint8_t* ReadData);
-bool CYPRESS_I2C_ConnectToCyI2C();
-bool CYPRESS_I2C_GetCyGpio(uint8_t GpioNum, uint8_t* Value);
-bool CYPRESS_I2C_SetCyGpio(uint8_t GpioNum, uint8_t Value);
+/*
+ * State of one bridge connection: handle, data configuration and clock
+ * negotiation. Each connection owns a device so that several bridges can be
+ * driven from one process.
+ */
+typedef struct CYPRESS_I2C_Device CYPRESS_I2C_Device_s;
+
+CYPRESS_I2C_Device_s* CYPRESS_I2C_CreateDevice();
+void CYPRESS_I2C_DestroyDevice(CYPRESS_I2C_Device_s* Device);
+
+/*
+ * Bridges are selected by the serial number string descriptor when
+ * SerialNumber is not NULL or empty, otherwise by BridgeIndex, the position
+ * among the vendor class I2C interfaces in enumeration order. With neither
+ * given the first I2C interface that can be opened is used.
+ */
+bool CYPRESS_I2C_IsPresent(const char* SerialNumber, int32_t BridgeIndex);
+bool CYPRESS_I2C_ConnectToCyI2C(CYPRESS_I2C_Device_s* Device,
+                                const char* SerialNumber, int32_t BridgeIndex);
+/*
+ * Serial number string descriptor of the connected bridge, empty before
+ * CYPRESS_I2C_ConnectToCyI2C() succeeds.
+ */
+const char* CYPRESS_I2C_GetSerialNumber(CYPRESS_I2C_Device_s* Device);
+bool CYPRESS_I2C_RequestI2CBusAccess(CYPRESS_I2C_Device_s* Device);
+bool CYPRESS_I2C_RelinquishI2CBusAccess(CYPRESS_I2C_Device_s* Device);
+bool CYPRESS_I2C_WriteI2C(CYPRESS_I2C_Device_s* Device,
+                          uint32_t WriteDataLength, uint8_t* WriteData);
+bool CYPRESS_I2C_ReadI2C(CYPRESS_I2C_Device_s* Device,
+                         uint32_t ReadDataLength, uint8_t* ReadData);
+bool CYPRESS_I2C_WriteReadI2C(CYPRESS_I2C_Device_s* Device,
+                              uint32_t WriteDataLength, uint8_t* WriteData,
+                              uint32_t ReadDataLength, uint8_t* ReadData);
+bool CYPRESS_I2C_GetCyGpio(CYPRESS_I2C_Device_s* Device, uint8_t GpioNum, uint8_t* Value);
+bool CYPRESS_I2C_SetCyGpio(CYPRESS_I2C_Device_s* Device, uint8_t GpioNum, uint8_t Value);
+
+typedef bool (*CYPRESS_I2C_LinkTestCallback)(void* UserData);
+
+uint32_t CYPRESS_I2C_NegotiateClockFrequency(CYPRESS_I2C_Device_s* Device,
+                                             CYPRESS_I2C_LinkTestCallback LinkTest,
+                                             void* UserData);
+uint32_t CYPRESS_I2C_GetClockFrequency(CYPRESS_I2C_Device_s* Device);
 
 #ifdef __cplusplus    /* matches __cplusplus construct above */
 }
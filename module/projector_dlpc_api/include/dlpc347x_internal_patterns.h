@@ -48,6 +48,9 @@ extern "C" {
 #include "stdbool.h"
 
 #define ERR_UNSUPPORTED_DMD 100
+#define ERR_BUFFER_TOO_SMALL 101
+#define ERR_PATTERN_SLOT_MISMATCH 102
+#define ERR_PATTERN_SOURCE 103
 
 typedef enum
 {
@@ -95,7 +98,7 @@ typedef struct
      * If the number of bytes is greater than the expected value, the excess bytes
      * are ignored.
      */
-    uint8_t* PixelArray;
+    const uint8_t* PixelArray;
 } DLPC34XX_INT_PAT_PatternData_s;
 
 typedef struct
@@ -104,6 +107,14 @@ typedef struct
     DLPC34XX_INT_PAT_Direction_e    Direction;
     uint32_t                        PatternCount;
     DLPC34XX_INT_PAT_PatternData_s* PatternArray;
+
+    /**
+     * Only used for 1-bit patterns. When true, the pixel arrays hold 8-bit
+     * gray values and a pixel is on when it is >= 128, so a gray line can be
+     * encoded without first converting it to 0 or 1. When false, bit 0 of
+     * each byte is used.
+     */
+    bool                            ThresholdPixels;
 } DLPC34XX_INT_PAT_PatternSet_s;
 
 typedef struct
@@ -126,6 +137,256 @@ typedef struct
  */
 typedef void(*DLPC34XX_INT_PAT_WritePatternDataCallback)(uint8_t Length, uint8_t* Data);
 
+/**
+ * The block callback used to transfer pattern data to the caller. Contiguous
+ * runs (headers, zero padding and whole packed rows of a bit plane) are
+ * transferred in a single call.
+ *
+ * \param[in] Length   Number of bytes transferred
+ * \param[in] Data     Pointer to the data bytes. Only valid during the call.
+ * \param[in] UserData The pointer given to DLPC34XX_INT_PAT_GeneratePatternDataBlockEx
+ */
+typedef void(*DLPC34XX_INT_PAT_WritePatternDataBlockCallback)(uint32_t Length, uint8_t* Data, void* UserData);
+
+/**
+ * The callback used by a streaming encoder to fetch the pixels of one pattern
+ * right before they are packed, so the caller never has to hold the pixels of
+ * all patterns at once. A dual controller set is packed as all master halves
+ * followed by all slave halves, so each of its patterns is requested twice.
+ *
+ * \param[in]  PatternSetIndex Index of the pattern set
+ * \param[in]  PatternIndex    Index of the pattern in the set
+ * \param[out] PatternData     The pixels of the pattern. The pixel array only
+ *                             needs to stay valid until the next call.
+ * \param[in]  UserData        The pointer given to DLPC34XX_INT_PAT_SetPatternDataSource
+ *
+ * \return DLPC_SUCCESS to continue, any other value aborts the encoding
+ */
+typedef uint32_t(*DLPC34XX_INT_PAT_ReadPatternDataCallback)(uint32_t PatternSetIndex, uint32_t PatternIndex, DLPC34XX_INT_PAT_PatternData_s* PatternData, void* UserData);
+
+/**
+ * Geometry of the DMD the pattern data is generated for
+ */
+typedef struct
+{
+    DLPC34XX_INT_PAT_DMD_e DMD;
+    uint32_t               Width;
+    uint32_t               Height;
+    uint8_t                MirrorTopOffset;
+    uint8_t                MirrorBottomOffset;
+    uint8_t                MirrorLeftOffset;
+    uint8_t                MirrorRightOffset;
+    bool                   RequiresDualController;
+} DLPC34XX_INT_PAT_DMDInfo_s;
+
+/**
+ * Encoder context. Holds the DMD info, the pattern sets, the pattern order
+ * table and the output sink of one pattern data block, so that independent
+ * encoders can run at the same time on different threads. Initialize with
+ * DLPC34XX_INT_PAT_InitEncoder; the fields are private to the encoder.
+ */
+typedef struct
+{
+    DLPC34XX_INT_PAT_DMDInfo_s                     DMDInfo;
+    uint32_t                                       PatternSetCount;
+    DLPC34XX_INT_PAT_PatternSet_s*                 PatternSetArray;
+    uint32_t                                       PatternOrderTableCount;
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s*     PatternOrderTable;
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback WritePatternDataBlockCallback;
+    void*                                          UserData;
+    DLPC34XX_INT_PAT_WritePatternDataCallback      WritePatternDataCallback;
+    DLPC34XX_INT_PAT_ReadPatternDataCallback       ReadPatternDataCallback;
+    void*                                          ReadPatternDataUserData;
+} DLPC34XX_INT_PAT_Encoder_s;
+
+/**
+ * Initializes an encoder context. The pattern sets and the pattern order
+ * table are referenced, not copied, and must stay valid while the encoder is
+ * used.
+ *
+ * \param[out] Encoder                       The encoder context
+ * \param[in]  DMD                           The DMD for which pattern data is
+ *                                           being generated
+ * \param[in]  PatternSetCount               Number of pattern sets
+ * \param[in]  PatternSetArray               An array of DLPC34XX_INT_PAT_PatternSet_s
+ * \param[in]  PatternOrderTableCount        Number of rows in the pattern order table
+ * \param[in]  PatternOrderTable             An array of DLPC34XX_INT_PAT_PatternOrderTableEntry_s
+ * \param[in]  WritePatternDataBlockCallback The callback used to transfer data
+ *                                           to the caller. May be NULL if the
+ *                                           encoder is only used to query sizes.
+ * \param[in]  UserData                      Passed through to the callback
+ *
+ * \return DLPC_SUCCESS         if successful
+ *         ERR_UNSUPPORTED_DMD  if the DMD is not supported
+ */
+uint32_t DLPC34XX_INT_PAT_InitEncoder(
+    DLPC34XX_INT_PAT_Encoder_s*                    Encoder,
+    DLPC34XX_INT_PAT_DMD_e                         DMD,
+    uint32_t                                       PatternSetCount,
+    DLPC34XX_INT_PAT_PatternSet_s*                 PatternSetArray,
+    uint32_t                                       PatternOrderTableCount,
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s*     PatternOrderTable,
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback WritePatternDataBlockCallback,
+    void*                                          UserData
+);
+
+/**
+ * Makes DLPC34XX_INT_PAT_EncodePatternDataBlock fetch the pixels of every
+ * pattern from a callback instead of the PatternArray of its set. Only the
+ * sequential encoder streams; the slot functions keep using PatternArray.
+ *
+ * \param[in] Encoder                 The encoder context
+ * \param[in] ReadPatternDataCallback The callback, or NULL to use PatternArray
+ * \param[in] UserData                Passed through to the callback
+ *
+ * \return DLPC_SUCCESS if successful
+ */
+uint32_t DLPC34XX_INT_PAT_SetPatternDataSource(
+    DLPC34XX_INT_PAT_Encoder_s*              Encoder,
+    DLPC34XX_INT_PAT_ReadPatternDataCallback ReadPatternDataCallback,
+    void*                                    UserData
+);
+
+/**
+ * Generates the pattern data block of an initialized encoder. Only touches the
+ * given encoder, so different encoders may be used concurrently as long as
+ * they do not share pattern data.
+ *
+ * \param[in] Encoder      The encoder context
+ * \param[in] EastWestFlip Whether to E/W flip pattern data
+ * \param[in] LongAxisFlip Whether to flip pattern data along the long axis
+ *
+ * \return DLPC_SUCCESS if successful, otherwise the value returned by the
+ *         pattern data source that aborted the encoding. The bytes already
+ *         transferred are the start of the block.
+ */
+uint32_t DLPC34XX_INT_PAT_EncodePatternDataBlock(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder,
+    bool                        EastWestFlip,
+    bool                        LongAxisFlip
+);
+
+/**
+ * Gets the size of the pattern data block of an initialized encoder in bytes
+ *
+ * \param[in] Encoder The encoder context
+ *
+ * \return the size of the pattern data block in bytes
+ */
+uint32_t DLPC34XX_INT_PAT_GetEncodedBlockSize(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder
+);
+
+/**
+ * Gets the offset of one pattern's data inside the pattern data block. Every
+ * pattern of a set has a fixed size slot, which allows the patterns to be
+ * encoded independently and in any order.
+ *
+ * \param[in] Encoder         The encoder context
+ * \param[in] PatternSetIndex Index of the pattern set
+ * \param[in] PatternIndex    Index of the pattern in the set
+ * \param[in] MasterASIC      Whether the slot holds the master controller half.
+ *                            Ignored for single controller DMDs.
+ *
+ * \return the offset of the slot from the start of the block in bytes
+ */
+uint32_t DLPC34XX_INT_PAT_GetPatternSlotOffset(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder,
+    uint32_t                    PatternSetIndex,
+    uint32_t                    PatternIndex,
+    bool                        MasterASIC
+);
+
+/**
+ * Gets the size of one pattern slot of a pattern set in bytes
+ *
+ * \param[in] Encoder         The encoder context
+ * \param[in] PatternSetIndex Index of the pattern set
+ *
+ * \return the size of the slot in bytes
+ */
+uint32_t DLPC34XX_INT_PAT_GetPatternSlotSize(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder,
+    uint32_t                    PatternSetIndex
+);
+
+/**
+ * Writes everything of the pattern data block except the pattern slots: the
+ * block header, the pattern order table and the pattern set headers.
+ *
+ * \param[in]  Encoder   The encoder context
+ * \param[out] Block     Buffer of at least DLPC34XX_INT_PAT_GetEncodedBlockSize bytes
+ * \param[in]  BlockSize Size of Block in bytes
+ *
+ * \return DLPC_SUCCESS          if successful
+ *         ERR_BUFFER_TOO_SMALL  if Block cannot hold the pattern data block
+ */
+uint32_t DLPC34XX_INT_PAT_EncodeBlockLayout(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder,
+    uint8_t*                    Block,
+    uint32_t                    BlockSize
+);
+
+/**
+ * Encodes one pattern into its slot. The pattern data is only read, so
+ * several slots, including both halves of the same pattern, may be encoded
+ * concurrently.
+ *
+ * \param[in]  Encoder          The encoder context
+ * \param[in]  PatternSetIndex  Index of the pattern set
+ * \param[in]  PatternIndex     Index of the pattern in the set
+ * \param[in]  MasterASIC       Whether to encode the master controller half.
+ *                              Must be true for single controller DMDs.
+ * \param[in]  EastWestFlip     Whether to E/W flip pattern data
+ * \param[in]  LongAxisFlip     Whether to flip pattern data along the long axis
+ * \param[out] Slot             Start of the slot, see DLPC34XX_INT_PAT_GetPatternSlotOffset
+ *
+ * \return DLPC_SUCCESS               if successful
+ *         ERR_PATTERN_SLOT_MISMATCH  if the encoded data does not fill the
+ *                                    slot exactly; use
+ *                                    DLPC34XX_INT_PAT_EncodePatternDataBlock
+ */
+uint32_t DLPC34XX_INT_PAT_EncodePatternSlot(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder,
+    uint32_t                    PatternSetIndex,
+    uint32_t                    PatternIndex,
+    bool                        MasterASIC,
+    bool                        EastWestFlip,
+    bool                        LongAxisFlip,
+    uint8_t*                    Slot
+);
+
+/**
+ * Decodes one pattern slot back into the 1-D pixel array it was encoded
+ * from, undoing the flips. Only the pixels displayed by the given controller
+ * are written, so a dual controller pattern needs both halves decoded into
+ * the same array. Pixels the encoder never displays are left unchanged. The
+ * pattern's PixelArrayCount gives the length of the output array; its
+ * PixelArray is not used.
+ *
+ * \param[in]  Encoder          The encoder context
+ * \param[in]  PatternSetIndex  Index of the pattern set
+ * \param[in]  PatternIndex     Index of the pattern in the set
+ * \param[in]  MasterASIC       Whether the slot holds the master controller
+ *                              half. Must be true for single controller DMDs.
+ * \param[in]  EastWestFlip     Whether the data was E/W flipped
+ * \param[in]  LongAxisFlip     Whether the data was flipped along the long axis
+ * \param[in]  Slot             Start of the slot, see DLPC34XX_INT_PAT_GetPatternSlotOffset
+ * \param[out] PixelArray       The decoded pixels, 0 or 1 for 1-bit sets
+ *
+ * \return DLPC_SUCCESS if successful
+ */
+uint32_t DLPC34XX_INT_PAT_DecodePatternSlot(
+    DLPC34XX_INT_PAT_Encoder_s* Encoder,
+    uint32_t                    PatternSetIndex,
+    uint32_t                    PatternIndex,
+    bool                        MasterASIC,
+    bool                        EastWestFlip,
+    bool                        LongAxisFlip,
+    const uint8_t*              Slot,
+    uint8_t*                    PixelArray
+);
+
 /**
  * Generates the pattern data block from the given inputs. In order to avoid
  * dynamic memory allocation, this function uses a callback to transfer data to
@@ -160,6 +421,38 @@ uint32_t DLPC34XX_INT_PAT_GeneratePatternDataBlock(
     bool                                       LongAxisFlip
 );
 
+/**
+ * Same as DLPC34XX_INT_PAT_GeneratePatternDataBlock, but transfers the data
+ * through a block callback with a 32-bit length, so the caller can copy
+ * whole runs at once instead of receiving at most 255 bytes per call.
+ *
+ * \param[in] DMD                           The DMD for which pattern data is
+ *                                          being generated
+ * \param[in] PatternSetCount               Number of pattern sets
+ * \param[in] PatternSetArray               An array of DLPC34XX_INT_PAT_PatternSet_s
+ * \param[in] PatternOrderTableCount        Number of rows in the pattern order table
+ * \param[in] PatternOrderTable             An array of DLPC34XX_INT_PAT_PatternOrderTableEntry_s
+ * \param[in] WritePatternDataBlockCallback The callback used to transfer data
+ *                                          to the caller
+ * \param[in] UserData                      Passed through to the callback
+ * \param[in] EastWestFlip                  Whether to E/W flip pattern data
+ * \param[in] LongAxisFlip                  Whether to flip pattern data along the long axis
+ *
+ * \return DLPC_SUCCESS         if successful
+ *         ERR_UNSUPPORTED_DMD  if the DMD is not supported
+ */
+uint32_t DLPC34XX_INT_PAT_GeneratePatternDataBlockEx(
+    DLPC34XX_INT_PAT_DMD_e                         DMD,
+    uint32_t                                       PatternSetCount,
+    DLPC34XX_INT_PAT_PatternSet_s*                 PatternSetArray,
+    uint32_t                                       PatternOrderTableCount,
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s*     PatternOrderTable,
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback WritePatternDataBlockCallback,
+    void*                                          UserData,
+    bool                                           EastWestFlip,
+    bool                                           LongAxisFlip
+);
+
 /**
  * Gets the size of the pattern data block in bytes for the given inputs
  *
@@ -0,0 +1,124 @@
+/**
+ * @file dlpc347x_pattern_packer.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief  Bit-plane packer used by the 347x internal pattern encoder. Splits a
+ *         line of pixels into its bit planes in a single pass, using SSE2/AVX2
+ *         movemask when available and a scalar loop otherwise.
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef DLPC34XX_INT_PAT_PACKER_H
+#define DLPC34XX_INT_PAT_PACKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdbool.h"
+#include "stdint.h"
+
+/**
+ * A run of output pixels read from consecutive source pixels, either in
+ * increasing or in decreasing order. Used to apply the East/West and long
+ * axis flips while packing instead of reversing the source in place.
+ */
+typedef struct
+{
+    /** Number of output pixels in the run */
+    uint32_t Count;
+    /** Source index of the first output pixel of the run */
+    uint32_t Start;
+    /** Read Start, Start - 1, ... instead of Start, Start + 1, ... */
+    bool     Reverse;
+} DLPC34XX_INT_PAT_PixelSegment_s;
+
+/**
+ * Packs the pixels [StartPixel, EndPixel) of a pattern line into BitDepth bit
+ * planes. Bit i of output byte k of plane p holds bit p of pixel
+ * StartPixel + 8 * k + i, i.e. the same layout the encoder writes to flash.
+ * Pixels at or beyond PixelArrayCount are packed as zeros.
+ *
+ * \param[in]  PixelArray      The 1-D pixel data array
+ * \param[in]  PixelArrayCount Number of bytes in the pixel array
+ * \param[in]  StartPixel      First pixel to pack
+ * \param[in]  EndPixel        One past the last pixel to pack
+ * \param[in]  BitDepth        Number of bit planes to produce (1-8)
+ * \param[out] PlaneArray      Output planes, (EndPixel - StartPixel + 7) / 8
+ *                             bytes each
+ * \param[in]  PlaneStride     Distance in bytes between consecutive planes
+ */
+void DLPC34XX_INT_PAT_PackBitPlanes(const uint8_t* PixelArray,
+                                    uint32_t       PixelArrayCount,
+                                    uint32_t       StartPixel,
+                                    uint32_t       EndPixel,
+                                    uint32_t       BitDepth,
+                                    uint8_t*       PlaneArray,
+                                    uint32_t       PlaneStride);
+
+/**
+ * Packs the pixels described by a list of segments into BitDepth bit planes.
+ * The output pixels are the segments laid out one after another; source
+ * indices outside [0, PixelArrayCount) are packed as zeros. The source array
+ * is only read.
+ *
+ * \param[in]  PixelArray      The 1-D pixel data array
+ * \param[in]  PixelArrayCount Number of bytes in the pixel array
+ * \param[in]  Segments        The runs of source pixels, in output order
+ * \param[in]  SegmentCount    Number of segments
+ * \param[in]  BitDepth        Number of bit planes to produce (1-8)
+ * \param[out] PlaneArray      Output planes, (total count + 7) / 8 bytes each
+ * \param[in]  PlaneStride     Distance in bytes between consecutive planes
+ */
+void DLPC34XX_INT_PAT_PackBitPlanesSegments(const uint8_t*                         PixelArray,
+                                            uint32_t                               PixelArrayCount,
+                                            const DLPC34XX_INT_PAT_PixelSegment_s* Segments,
+                                            uint32_t                               SegmentCount,
+                                            uint32_t                               BitDepth,
+                                            uint8_t*                               PlaneArray,
+                                            uint32_t                               PlaneStride);
+
+/**
+ * Packs the pixels described by a list of segments into a single 1-bit plane,
+ * thresholding 8-bit gray pixels on the way: a pixel is on when it is >= 128.
+ * Packs 8 (scalar), 16 (SSE2) or 32 (AVX2) pixels per step straight from the
+ * source, so no separate 0/1 line is needed.
+ *
+ * \param[in]  PixelArray      The 1-D pixel data array
+ * \param[in]  PixelArrayCount Number of bytes in the pixel array
+ * \param[in]  Segments        The runs of source pixels, in output order
+ * \param[in]  SegmentCount    Number of segments
+ * \param[out] PlaneArray      Output plane, (total count + 7) / 8 bytes
+ */
+void DLPC34XX_INT_PAT_PackThresholdSegments(const uint8_t*                         PixelArray,
+                                            uint32_t                               PixelArrayCount,
+                                            const DLPC34XX_INT_PAT_PixelSegment_s* Segments,
+                                            uint32_t                               SegmentCount,
+                                            uint8_t*                               PlaneArray);
+
+/**
+ * Reference implementation of DLPC34XX_INT_PAT_PackBitPlanes which extracts
+ * one bit at a time. Used for tails, for targets without SSE2 and to verify
+ * the vectorized path.
+ */
+void DLPC34XX_INT_PAT_PackBitPlanesScalar(const uint8_t* PixelArray,
+                                          uint32_t       PixelArrayCount,
+                                          uint32_t       StartPixel,
+                                          uint32_t       EndPixel,
+                                          uint32_t       BitDepth,
+                                          uint8_t*       PlaneArray,
+                                          uint32_t       PlaneStride);
+
+/**
+ * \return Name of the instruction set used by DLPC34XX_INT_PAT_PackBitPlanes
+ *         ("AVX2", "SSE2" or "scalar")
+ */
+const char* DLPC34XX_INT_PAT_GetPackerName();
+
+#ifdef __cplusplus    /* matches __cplusplus construct above */
+}
+#endif
+#endif /* DLPC34XX_INT_PAT_PACKER_H */
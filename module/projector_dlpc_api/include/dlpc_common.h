@@ -152,6 +152,74 @@ void DLPC_COMMON_InitCommandLibrary(
     DLPC_COMMON_ReadCommandCallback  ReadCommandCallback
 );
 
+/**
+* The command library state: buffers, callbacks, protocol data and the caller
+* data passed back to the callbacks.
+*
+* DLPC_COMMON_InitCommandLibrary() initializes a process-wide default context.
+* To drive several controllers from one process, give each controller its own
+* context and select it on every thread that issues its commands.
+*/
+typedef struct
+{
+    uint8_t*                          WriteBuffer;
+    uint16_t                          WriteBufferSize;
+    uint16_t                          WriteBufferIndex;
+    uint8_t*                          ReadBuffer;
+    uint16_t                          ReadBufferSize;
+    uint16_t                          ReadBufferIndex;
+    DLPC_COMMON_WriteCommandCallback  WriteCommandCallback;
+    DLPC_COMMON_ReadCommandCallback   ReadCommandCallback;
+    DLPC_COMMON_CommandProtocolData_s ProtocolData;
+    void*                             UserData;
+} DLPC_COMMON_Context_s;
+
+/**
+* Initializes a command library context, see DLPC_COMMON_InitCommandLibrary()
+*
+* \param[out] Context              The context
+* \param[in]  WriteBuffer          The write buffer
+* \param[in]  WriteBufferSize      The write buffer size in bytes
+* \param[in]  ReadBuffer           The read buffer
+* \param[in]  ReadBufferSize       The read buffer size in bytes
+* \param[in]  WriteCommandCallback The write callback
+* \param[in]  ReadCommandCallback  The read callback
+* \param[in]  UserData             Caller data, see DLPC_COMMON_GetUserData()
+*/
+void DLPC_COMMON_InitContext(
+    DLPC_COMMON_Context_s*           Context,
+    uint8_t*                         WriteBuffer,
+    uint16_t                         WriteBufferSize,
+    uint8_t*                         ReadBuffer,
+    uint16_t                         ReadBufferSize,
+    DLPC_COMMON_WriteCommandCallback WriteCommandCallback,
+    DLPC_COMMON_ReadCommandCallback  ReadCommandCallback,
+    void*                            UserData
+);
+
+/**
+* Selects the context used by the command APIs on the calling thread
+*
+* \param[in] Context  The context, NULL selects the default context
+*
+* \return The previously selected context, NULL for the default context
+*/
+DLPC_COMMON_Context_s* DLPC_COMMON_SelectContext(DLPC_COMMON_Context_s* Context);
+
+/**
+* Gets the context selected on the calling thread
+*
+* \return The selected context, NULL for the default context
+*/
+DLPC_COMMON_Context_s* DLPC_COMMON_GetSelectedContext();
+
+/**
+* Gets the caller data of the context in use, for the command callbacks
+*
+* \return The caller data, NULL for the default context
+*/
+void* DLPC_COMMON_GetUserData();
+
 
 #ifdef __cplusplus    /* matches __cplusplus construct above */
 }
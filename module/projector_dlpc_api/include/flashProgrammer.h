@@ -0,0 +1,342 @@
+/**
+ * @file flashProgrammer.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_FLASH_PROGRAMMER_H_
+#define __PROJECTOR_FLASH_PROGRAMMER_H_
+
+#include "dlpc_common.h"
+#include "projector.h"
+#include "waiter.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//控制器flash中图案数据区的大小，默认值按评估模块固件，可在编译时定义覆盖
+#ifndef PATTERN_FLASH_SIZE
+#define PATTERN_FLASH_SIZE (4 * 1024 * 1024)
+#endif
+//尚未实测时使用的烧录吞吐量(B/s)，按100kHz I2C扣除命令开销估计
+#define DEFAULT_FLASH_WRITE_THROUGHPUT 8000.0
+//尚未实测时使用的擦除耗时(s)
+#define DEFAULT_FLASH_ERASE_SECONDS 2.0
+//等待擦除完成的超时时间(s)
+#define FLASH_ERASE_TIMEOUT_SECONDS 60
+//烧录环形缓冲区的写入块数量，至少为2，可在编译时定义覆盖
+#ifndef FLASH_PROGRAM_QUEUE_DEPTH
+#define FLASH_PROGRAM_QUEUE_DEPTH 4
+#endif
+//回退时允许的最小写入命令数据长度
+#define FLASH_MIN_CHUNK_SIZE 256
+//同一写入命令数据长度连续失败多少次后才改用更短的长度，偶发的NAK由重发吸收
+#ifndef FLASH_CHUNK_RETRIES
+#define FLASH_CHUNK_RETRIES 3
+#endif
+//实测吞吐量所需的最少烧录字节数，样本更少时计时误差大
+#define FLASH_THROUGHPUT_MIN_BYTES (8 * 1024)
+//跳过烧录前从数据块起始处读回校验的字节数，覆盖头部与首个一维图案，可在编译时定义覆盖
+#ifndef FLASH_VERIFY_BYTES
+#define FLASH_VERIFY_BYTES (8 * 1024)
+#endif
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 图案数据flash烧录器，每台投影仪各持有一份缓冲状态
+ * @note begin()与finish()之间由专用I/O线程发送写入块，调用方线程只负责填充环形缓冲区，
+ *       I2C发送第k块时编码器可以填充第k+1块；期间其它控制器命令只能由空闲回调插入。
+ *       写入命令的数据长度从控制器的上限开始，同一长度连续失败FLASH_CHUNK_RETRIES次后
+ *       才视为控制器或桥接芯片不接受，改用减半的长度；每次begin()重新从上限开始。
+ *       指纹、擦除耗时与吞吐量的查询可在烧录期间从其它线程调用
+ */
+class DEVICE_API FlashProgrammer {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param isDualController 是否为DLPC34xx dual控制器
+     */
+    explicit FlashProgrammer(IN const bool isDualController);
+    /**
+     * @brief 析构，结束未完成的烧录
+     */
+    ~FlashProgrammer();
+    FlashProgrammer(const FlashProgrammer &) = delete;
+    FlashProgrammer &operator=(const FlashProgrammer &) = delete;
+    /**
+     * @brief 擦除图案数据区并等待完成，记录擦除耗时
+     *
+     * @return true 成功
+     * @return false 超时未完成
+     */
+    bool erase();
+    /**
+     * @brief 获取最近一次擦除的等待结果
+     *
+     * @return WaitResult 等待耗时与状态查询次数
+     */
+    WaitResult getEraseWait() const;
+    /**
+     * @brief 开始一次烧录，设置写入块长度、清空缓冲区并启动I/O线程
+     * @note I/O线程使用调用线程当前选择的命令库上下文
+     */
+    void begin();
+    /**
+     * @brief 缓冲数据，写入块满时交给I/O线程烧录
+     * @note 没有空闲写入块时等待，等待时间计入encoderStallSeconds_
+     *
+     * @param length 数据长度
+     * @param pData 数据，返回后即可复用
+     */
+    void write(IN uint32_t length, IN uint8_t *pData);
+    /**
+     * @brief 烧录缓冲区中剩余的数据，等待I/O线程发送完毕后返回
+     *
+     * @return true 成功
+     * @return false 有数据未能写入
+     */
+    bool finish();
+    /**
+     * @brief 获取最近一次烧录的统计
+     * @note 可在烧录期间从其它线程调用，返回调用时的快照
+     *
+     * @return FlashProgramStats 统计
+     */
+    FlashProgramStats getStats() const;
+    /**
+     * @brief 从flash的图案数据区起始处读取数据
+     *
+     * @param length 数据长度
+     * @param pData 数据
+     * @return true 成功
+     * @return false 失败
+     */
+    bool read(IN uint32_t length, OUT uint8_t *pData);
+    /**
+     * @brief 判断flash中是否已是指定的图案数据块
+     * @note 指纹与最近一次烧录的记录一致，且从flash读回的头部与期望一致、
+     *       起始FLASH_VERIFY_BYTES字节与烧录时记录的校验值一致时才认为已烧录；
+     *       只读取数据块起始处，不含校验值的旧记录视为未烧录
+     *
+     * @param fingerprint 数据块指纹
+     * @param pHeader 期望的数据块头部
+     * @param headerLength 头部长度
+     * @return true 已烧录，可跳过擦除与烧录
+     * @return false 需要重新烧录
+     */
+    bool isProgrammed(IN const uint64_t fingerprint, IN const uint8_t *pHeader,
+                      IN const uint32_t headerLength);
+    /**
+     * @brief 记录已烧录的数据块指纹
+     * @note 同时记录最近一次烧录写入的起始数据的校验值，供isProgrammed()读回比较
+     *
+     * @param fingerprint 数据块指纹，0表示flash内容未知
+     */
+    void setProgrammed(IN const uint64_t fingerprint);
+    /**
+     * @brief 获取最近一次烧录的数据块指纹，不访问设备
+     *
+     * @return uint64_t 指纹，0表示未知
+     */
+    uint64_t getProgrammed() const;
+    /**
+     * @brief 获取图案数据区大小
+     *
+     * @return uint32_t 字节数
+     */
+    uint32_t getCapacity() const { return PATTERN_FLASH_SIZE; }
+    /**
+     * @brief 获取控制器单条写入命令可携带的最大数据长度，命令写缓冲区需按此分配
+     *
+     * @return uint16_t 字节数
+     */
+    uint16_t getMaxChunkSize() const { return maxChunkSize_; }
+    /**
+     * @brief 获取本次烧录当前使用的写入命令数据长度
+     *
+     * @return uint16_t 字节数，0表示所有候选长度都被拒绝
+     */
+    uint16_t getChunkSize() const {
+        return chunkSizeIndex_ < chunkSizes_.size()
+                   ? chunkSizes_[chunkSizeIndex_]
+                   : 0;
+    }
+    /**
+     * @brief 获取烧录吞吐量
+     * @note 按已完成的烧录实测，尚未烧录时为DEFAULT_FLASH_WRITE_THROUGHPUT
+     *
+     * @return double 字节每秒
+     */
+    double getWriteThroughput() const;
+    /**
+     * @brief 预估擦除并烧录数据块的耗时，不访问设备
+     *
+     * @param blockSize 数据块大小
+     * @return double 秒
+     */
+    double estimateSeconds(IN const uint32_t blockSize) const;
+    /**
+     * @brief 设置指纹记录文件，进程重启后仍能识别flash中的数据块
+     *
+     * @param path 记录文件路径，空字符串表示只记录在内存中
+     */
+    void setFingerprintFile(IN const std::string &path);
+    /**
+     * @brief 生成设备的指纹记录文件路径
+     * @note 记录文件按设备标识命名，多台投影仪可共用同一目录
+     *
+     * @param directory 记录文件所在目录
+     * @param controller 控制器名称
+     * @param identity 设备标识，见Transport::getIdentity()
+     * @return std::string 记录文件路径，目录或标识为空时为空字符串
+     */
+    static std::string
+    getFingerprintFilePath(IN const std::string &directory,
+                           IN const std::string &controller,
+                           IN const std::string &identity);
+    /**
+     * @brief 设置空闲回调，在两条写入命令之间与擦除等待的两次状态查询之间调用
+     * @note 调用时没有命令在传输，回调可使用同一上下文插入其它控制器命令；
+     *       参数为回调最晚返回的时刻，写入命令之间为当前时刻，擦除等待时为下次状态查询的时刻，
+     *       回调可阻塞到该时刻并随到随插新的命令。
+     *       烧录期间在I/O线程中调用，擦除期间在调用erase()的线程中调用
+     *
+     * @param hook 空闲回调，为空时不调用
+     */
+    void setIdleHook(
+        IN const std::function<void(std::chrono::steady_clock::time_point)>
+            &hook) {
+        idleHook_ = hook;
+    }
+    /**
+     * @brief 供DLPC34XX_INT_PAT_EncodePatternDataBlock使用的回调
+     *
+     * @param length 数据长度
+     * @param pData 数据
+     * @param userData FlashProgrammer指针
+     */
+    static void writePatternData(IN uint32_t length, IN uint8_t *pData,
+                                 IN void *userData);
+
+  private:
+    /**
+     * @brief 烧录，长度与上一条命令不同时先设置写入命令数据长度
+     *
+     * @param length 数据长度
+     * @param pData 数据
+     * @return true 成功
+     * @return false 失败
+     */
+    bool program(IN uint16_t length, IN uint8_t *pData);
+    /**
+     * @brief 按写入命令数据长度分条烧录一个写入块
+     *
+     * @param length 数据长度
+     * @param pData 数据
+     * @return true 成功
+     * @return false 所有候选长度都被拒绝
+     */
+    bool sendBlock(IN uint32_t length, IN uint8_t *pData);
+    /**
+     * @brief 调用空闲回调
+     *
+     * @param until 回调最晚返回的时刻，默认立即返回
+     */
+    void runIdleHook(IN const std::chrono::steady_clock::time_point until =
+                         std::chrono::steady_clock::time_point()) {
+        if (idleHook_) {
+            idleHook_(until);
+        }
+    }
+    /**
+     * @brief 将正在填充的写入块交给I/O线程，并等待下一个空闲写入块
+     */
+    void submit();
+    /**
+     * @brief I/O线程，按提交顺序烧录写入块
+     */
+    void ioLoop();
+    //是否为DLPC34xx dual控制器
+    const bool isDualController_;
+    //下一次烧录是否为起始块
+    bool startProgramming_;
+    //控制器单条写入命令可携带的最大数据长度
+    const uint16_t maxChunkSize_;
+    //候选写入命令数据长度，从长到短
+    std::vector<uint16_t> chunkSizes_;
+    //本次烧录使用的候选长度索引，之前的长度已被拒绝
+    size_t chunkSizeIndex_;
+    //当前长度连续失败的次数
+    int numOfChunkFailures_;
+    //控制器当前设置的写入命令数据长度
+    uint16_t dataLength_;
+    //环形缓冲区
+    std::vector<std::vector<uint8_t>> buffers_;
+    //各写入块的数据长度
+    std::vector<uint32_t> lengths_;
+    //正在填充的写入块
+    size_t fillIndex_;
+    //正在填充的写入块已用长度
+    uint32_t bufferPtr_;
+    //本次烧录起始数据的校验值
+    uint64_t writeHash_;
+    //本次烧录已计入校验值的字节数，至多FLASH_VERIFY_BYTES
+    uint32_t numOfHashedBytes_;
+    //已提交、尚未烧录完成的写入块数量
+    size_t numOfQueued_;
+    //是否不再提交写入块
+    bool isFinishing_;
+    //本次烧录是否有数据未能写入
+    bool isFailed_;
+    //保护环形缓冲区状态与烧录统计
+    mutable std::mutex mutex_;
+    //写入块提交或烧录完成
+    std::condition_variable queueChanged_;
+    //I/O线程
+    std::thread ioThread_;
+    //空闲回调
+    std::function<void(std::chrono::steady_clock::time_point)> idleHook_;
+    //I/O线程使用的命令库上下文，begin()时取自调用线程
+    DLPC_COMMON_Context_s *commandContext_;
+    //最近一次烧录的统计
+    FlashProgramStats stats_;
+    //最近一次烧录的开始时间
+    std::chrono::steady_clock::time_point programStart_;
+    //保护指纹、擦除耗时与累计吞吐量，预估时在其它线程读取
+    mutable std::mutex recordMutex_;
+    //最近一次烧录的数据块指纹，0表示未知
+    uint64_t fingerprint_;
+    //已烧录数据块起始数据的校验值
+    uint64_t verifyHash_;
+    //校验值覆盖的字节数，0表示无法校验
+    uint32_t verifyLength_;
+    //指纹记录文件
+    std::string fingerprintFile_;
+    //最近一次擦除耗时(s)，尚未擦除时为DEFAULT_FLASH_ERASE_SECONDS
+    double eraseSeconds_;
+    //最近一次擦除的等待结果
+    WaitResult eraseWait_;
+    //累计烧录字节数
+    uint64_t writtenBytes_;
+    //累计烧录耗时(s)
+    double writtenSeconds_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_FLASH_PROGRAMMER_H_
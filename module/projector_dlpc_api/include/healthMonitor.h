@@ -0,0 +1,133 @@
+/**
+ * @file healthMonitor.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_HEALTH_MONITOR_H_
+#define __PROJECTOR_HEALTH_MONITOR_H_
+
+#include "projector.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 控制器状态的后台检查线程
+ * @note 按固定间隔调用检查函数，由正常变为故障时调用故障回调一次；
+ *       检查函数返回false表示本次跳过（如控制命令正在进行），不改变故障状态
+ */
+class DEVICE_API HealthMonitor {
+  public:
+    /**
+     * @brief 状态检查
+     *
+     * @param fault 检查结果
+     * @return true 已检查
+     * @return false 本次跳过
+     */
+    using Check = std::function<bool(ProjectorFault &fault)>;
+
+    HealthMonitor();
+    ~HealthMonitor();
+    HealthMonitor(const HealthMonitor &) = delete;
+    HealthMonitor &operator=(const HealthMonitor &) = delete;
+    /**
+     * @brief 启动后台检查，已启动时先停止
+     *
+     * @param interval 检查间隔
+     * @param check 状态检查
+     * @param onFault 故障回调，可为空
+     */
+    void start(IN const std::chrono::milliseconds interval, IN const Check &check,
+               IN const ProjectorFaultCallback &onFault);
+    /**
+     * @brief 停止后台检查
+     * @note 可在故障回调中调用，此时不等待线程退出，回调返回后线程自行结束
+     */
+    void stop();
+    /**
+     * @brief 后台检查是否在运行
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isRunning() const { return isRunning_; }
+    /**
+     * @brief 最近一次检查是否发现故障
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isFaulted() const { return state_->isFaulted_; }
+    /**
+     * @brief 获取已完成的检查次数
+     *
+     * @return uint64_t 次数
+     */
+    uint64_t getNumOfChecks() const { return state_->numOfChecks_; }
+    /**
+     * @brief 获取跳过的检查次数
+     *
+     * @return uint64_t 次数
+     */
+    uint64_t getNumOfSkippedChecks() const {
+        return state_->numOfSkippedChecks_;
+    }
+
+  private:
+    /**
+     * @brief 后台线程共享的状态
+     * @note 由线程与监视器共同持有，在故障回调中析构监视器后线程仍可安全退出
+     */
+    struct State {
+        //保护isExit_
+        std::mutex mutex_;
+        //退出通知
+        std::condition_variable wakeUp_;
+        //检查间隔
+        std::chrono::milliseconds interval_;
+        //状态检查
+        Check check_;
+        //故障回调
+        ProjectorFaultCallback onFault_;
+        //是否退出
+        bool isExit_ = true;
+        //最近一次检查是否发现故障
+        std::atomic<bool> isFaulted_{false};
+        //已完成的检查次数
+        std::atomic<uint64_t> numOfChecks_{0};
+        //跳过的检查次数
+        std::atomic<uint64_t> numOfSkippedChecks_{0};
+    };
+    /**
+     * @brief 后台线程主循环
+     *
+     * @param state 共享状态
+     */
+    static void run(std::shared_ptr<State> state);
+    //后台线程
+    std::thread thread_;
+    //当前后台线程的共享状态
+    std::shared_ptr<State> state_;
+    //是否在运行
+    std::atomic<bool> isRunning_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_HEALTH_MONITOR_H_
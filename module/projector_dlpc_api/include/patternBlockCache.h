@@ -0,0 +1,91 @@
+/**
+ * @file patternBlockCache.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_PATTERN_BLOCK_CACHE_H_
+#define __PROJECTOR_PATTERN_BLOCK_CACHE_H_
+
+#include "projector.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 已编码"PATN"数据块的磁盘缓存
+ * @note 以图案内容的哈希为键，每个数据块保存为目录下的一个文件，内容相同的图案表无需重新编码
+ */
+class DEVICE_API PatternBlockCache {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param directory 缓存目录，不存在时创建
+     */
+    explicit PatternBlockCache(IN const std::string &directory);
+    /**
+     * @brief 缓存目录是否可用
+     *
+     * @return true 可用
+     * @return false 不可用
+     */
+    bool isValid() const { return isValid_; }
+    /**
+     * @brief 读取数据块
+     *
+     * @param key 图案内容哈希
+     * @param blockSize 数据块大小，文件大小不一致时视为未命中
+     * @param block 数据块
+     * @return true 命中
+     * @return false 未命中
+     */
+    bool load(IN const uint64_t key, IN const uint32_t blockSize,
+              OUT std::vector<uint8_t> &block);
+    /**
+     * @brief 保存数据块
+     *
+     * @param key 图案内容哈希
+     * @param block 数据块
+     * @return true 成功
+     * @return false 失败
+     */
+    bool store(IN const uint64_t key, IN const std::vector<uint8_t> &block);
+    /**
+     * @brief 获取缓存统计
+     *
+     * @return PatternCacheStats 统计
+     */
+    PatternCacheStats getStats();
+
+  private:
+    /**
+     * @brief 获取数据块文件路径
+     *
+     * @param key 图案内容哈希
+     * @return std::string 文件路径
+     */
+    std::string getPath(IN const uint64_t key) const;
+    //缓存目录
+    const std::string directory_;
+    //缓存目录是否可用
+    bool isValid_;
+    //保护统计
+    std::mutex mutex_;
+    //统计
+    PatternCacheStats stats_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_PATTERN_BLOCK_CACHE_H_
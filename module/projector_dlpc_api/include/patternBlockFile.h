@@ -0,0 +1,182 @@
+/**
+ * @file patternBlockFile.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_PATTERN_BLOCK_FILE_H_
+#define __PROJECTOR_PATTERN_BLOCK_FILE_H_
+
+#include "projector.h"
+
+#include "dlpc347x_internal_patterns.h"
+#include "patternEncoder.h"
+
+#include <string>
+#include <vector>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 离线编译的图案数据块文件（.patn）
+ * @note 文件由一个小的文件头（DMD、翻转、图案顺序表和图案内容哈希）和紧随其后的
+ *       "PATN"数据块组成，数据块与DLPC34XX_INT_PAT_GeneratePatternDataBlock的输出逐字节一致；
+ *       打开时以内存映射方式读取，可直接烧录，无需解码或重新编码
+ */
+class DEVICE_API PatternBlockFile {
+  public:
+    PatternBlockFile();
+    ~PatternBlockFile();
+    PatternBlockFile(const PatternBlockFile &) = delete;
+    PatternBlockFile &operator=(const PatternBlockFile &) = delete;
+    /**
+     * @brief 编码图案表并保存为数据块文件
+     *
+     * @param path 文件路径
+     * @param encoder 已调用build的编码器
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return true 成功
+     * @return false 编码或写文件失败
+     */
+    static bool save(IN const std::string &path, IN PatternEncoder &encoder,
+                     IN const bool eastWestFlip = false,
+                     IN const bool longAxisFlip = false);
+    /**
+     * @brief 以内存映射方式打开数据块文件
+     *
+     * @param path 文件路径
+     * @return true 成功
+     * @return false 文件不存在或格式不正确
+     */
+    bool open(IN const std::string &path);
+    /**
+     * @brief 关闭文件，解除映射
+     */
+    void close();
+    /**
+     * @brief 是否已打开
+     *
+     * @return true 已打开
+     * @return false 未打开
+     */
+    bool isOpen() const { return data_ != nullptr; }
+    /**
+     * @brief 获取目标DMD
+     *
+     * @return DLPC34XX_INT_PAT_DMD_e 目标DMD
+     */
+    DLPC34XX_INT_PAT_DMD_e getDMD() const { return encoder_.DMDInfo.DMD; }
+    /**
+     * @brief 获取图案内容哈希，与PatternEncoder::getHash一致
+     *
+     * @return uint64_t 哈希
+     */
+    uint64_t getHash() const { return hash_; }
+    /**
+     * @brief 是否东西翻转
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isEastWestFlip() const { return isEastWestFlip_; }
+    /**
+     * @brief 是否沿长轴翻转
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isLongAxisFlip() const { return isLongAxisFlip_; }
+    /**
+     * @brief 获取映射的数据块
+     *
+     * @return const uint8_t* 数据块，文件关闭后失效
+     */
+    const uint8_t *getBlock() const { return block_; }
+    /**
+     * @brief 获取数据块大小
+     *
+     * @return uint32_t 字节数
+     */
+    uint32_t getBlockSize() const { return blockSize_; }
+    /**
+     * @brief 获取数据块头部大小，即第一张图案数据之前的字节数
+     *
+     * @return uint32_t 字节数
+     */
+    uint32_t getHeaderSize() const { return headerSize_; }
+    /**
+     * @brief 获取图案顺序表
+     *
+     * @return const std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s>& 图案顺序表
+     */
+    const std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s> &
+    getPatternOrderTable() const {
+        return patternOrderTable_;
+    }
+    /**
+     * @brief 获取图案数量
+     *
+     * @return int 图案数量
+     */
+    int getNumOfPatterns() const { return (int)patterns_.size(); }
+    /**
+     * @brief 获取图案集合数量
+     *
+     * @return int 图案集合数量
+     */
+    int getNumOfPatternSets() const { return (int)patternSets_.size(); }
+    /**
+     * @brief 把数据块解码为一维图案集合，用于检查
+     * @note 撤销编码时的翻转；DMD上不显示的像素为0
+     *
+     * @param table 一维图案集合，每个图案集合对应一个集合，曝光等参数取自引用该集合的第一条顺序表项
+     * @return true 成功
+     * @return false 文件未打开
+     */
+    bool decode(OUT std::vector<PatternProfileSet> &table);
+
+  private:
+    /**
+     * @brief 解析数据块中的图案集合，初始化解码用的编码上下文
+     *
+     * @return true 成功
+     * @return false 数据块格式不正确
+     */
+    bool parseBlock();
+    //映射的文件内容
+    const uint8_t *data_;
+    //文件大小
+    size_t size_;
+    //数据块
+    const uint8_t *block_;
+    //数据块大小
+    uint32_t blockSize_;
+    //数据块头部大小
+    uint32_t headerSize_;
+    //图案内容哈希
+    uint64_t hash_;
+    //是否东西翻转
+    bool isEastWestFlip_;
+    //是否沿长轴翻转
+    bool isLongAxisFlip_;
+    //解码用的编码上下文
+    DLPC34XX_INT_PAT_Encoder_s encoder_;
+    //图案数据，像素数为整条像素线
+    std::vector<DLPC34XX_INT_PAT_PatternData_s> patterns_;
+    //图案集合
+    std::vector<DLPC34XX_INT_PAT_PatternSet_s> patternSets_;
+    //图案顺序表
+    std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s> patternOrderTable_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_PATTERN_BLOCK_FILE_H_
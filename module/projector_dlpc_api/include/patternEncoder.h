@@ -0,0 +1,270 @@
+/**
+ * @file patternEncoder.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_PATTERN_ENCODER_H_
+#define __PROJECTOR_PATTERN_ENCODER_H_
+
+#include "projector.h"
+
+#include "dlpc347x_internal_patterns.h"
+#include "dlpc_common.h"
+#include "patternBlockCache.h"
+#include "threadPool.h"
+
+#include <functional>
+#include <memory>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief DLPC34xx内部图案数据块编码器
+ * @note 每个实例持有自己的编码上下文和图案表内存，不同实例可在不同线程中同时编码；
+ *       图案表内存在多次编码之间复用，不会每次重新分配
+ */
+class DEVICE_API PatternEncoder {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param dmd 目标DMD
+     */
+    explicit PatternEncoder(IN const DLPC34XX_INT_PAT_DMD_e dmd);
+    /**
+     * @brief 从一维图案集合制作图案表
+     *
+     * @param table 一维图案集合，只读取，编码结束前需保持有效
+     * @return true 成功
+     * @return false 图案表无效：为空、超过256个集合、集合为空或超过255张图案、
+     *               时间为负或同一集合中的图案方向不一致
+     */
+    bool build(IN const std::vector<PatternProfileSet> &table);
+    /**
+     * @brief 从图案源制作图案表，只读取集合参数，不生成像素线
+     * @note 之后用encodeStream编码，getHash(source)计算指纹
+     *
+     * @param source 图案源
+     * @return true 成功
+     * @return false 图案源失败或图案表无效，见build
+     */
+    bool build(IN PatternSource &source);
+    /**
+     * @brief 获取图案数据块大小
+     *
+     * @return uint32_t 字节数，失败时为UINT32_MAX
+     */
+    uint32_t getBlockSize();
+    /**
+     * @brief 编码图案数据块
+     *
+     * @param callback 数据输出回调
+     * @param userData 回调用户数据
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return true 成功
+     * @return false 失败
+     */
+    bool encode(IN DLPC34XX_INT_PAT_WritePatternDataBlockCallback callback,
+                IN void *userData, IN const bool eastWestFlip = false,
+                IN const bool longAxisFlip = false);
+    /**
+     * @brief 从图案源流式编码图案数据块
+     * @note 按数据块顺序逐张生成像素线并立即编码输出，每张图案只读取一次，只保留当前集合的像素线，
+     *       内存占用与集合数量无关；不经过缓存。需先调用build(source)
+     *
+     * @param source 图案源
+     * @param callback 数据输出回调
+     * @param userData 回调用户数据
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return true 成功
+     * @return false 图案源失败或像素线方向与集合不一致，已输出的数据不完整
+     */
+    bool encodeStream(IN PatternSource &source,
+                      IN DLPC34XX_INT_PAT_WritePatternDataBlockCallback callback,
+                      IN void *userData, IN const bool eastWestFlip = false,
+                      IN const bool longAxisFlip = false);
+    /**
+     * @brief 编码数据块头部，即第一张图案数据之前的字节，不读取像素线
+     *
+     * @param header 数据块头部，长度为getHeaderSize
+     * @return true 成功
+     * @return false 失败
+     */
+    bool encodeHeader(OUT std::vector<uint8_t> &header);
+    /**
+     * @brief 并行编码图案数据块
+     * @note 按预先计算的偏移为每张图案（双控制器时为主、从两半）保留位置，在线程池中并行编码，
+     *       完成后按顺序一次性输出整个数据块，输出与encode逐字节一致；
+     *       设置了缓存时，先按图案内容哈希查找缓存，命中则直接输出缓存的数据块
+     *
+     * @param callback 数据输出回调
+     * @param userData 回调用户数据
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return true 成功
+     * @return false 失败
+     */
+    bool encodeParallel(IN DLPC34XX_INT_PAT_WritePatternDataBlockCallback callback,
+                        IN void *userData, IN const bool eastWestFlip = false,
+                        IN const bool longAxisFlip = false);
+    /**
+     * @brief 并行编码整个数据块，结果通过getBlock获取
+     * @note 设置了缓存时，先按图案内容哈希查找缓存
+     *
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return true 成功
+     * @return false 失败
+     */
+    bool encodeBlock(IN const bool eastWestFlip = false,
+                     IN const bool longAxisFlip = false);
+    /**
+     * @brief 获取encodeBlock编码的数据块
+     *
+     * @return const std::vector<uint8_t>& 数据块
+     */
+    const std::vector<uint8_t> &getBlock() const { return block_; }
+    /**
+     * @brief 获取数据块头部大小，即第一张图案数据之前的字节数
+     * @note 头部包括块头、图案顺序表和第一个集合的头
+     *
+     * @return uint32_t 字节数
+     */
+    uint32_t getHeaderSize();
+    /**
+     * @brief 计算图案表内容哈希
+     * @note 覆盖DMD、翻转、每个集合的位深与方向、每张图案的像素线以及图案顺序表
+     *
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return uint64_t 哈希
+     */
+    uint64_t getHash(IN const bool eastWestFlip = false,
+                     IN const bool longAxisFlip = false) const;
+    /**
+     * @brief 由集合参数与图案源的指纹计算图案表哈希，不读取图案
+     * @note 像素线由PatternSource::getFingerprint()代表，结果与从相同像素线build后getHash的结果不同；
+     *       需先调用build(source)
+     *
+     * @param source 图案源
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return uint64_t 哈希，图案源不提供指纹时为0
+     */
+    uint64_t getHash(IN PatternSource &source,
+                     IN const bool eastWestFlip = false,
+                     IN const bool longAxisFlip = false) const;
+    /**
+     * @brief 设置数据块缓存
+     *
+     * @param cache 缓存，为空时关闭缓存
+     */
+    void setCache(IN const std::shared_ptr<PatternBlockCache> &cache) {
+        cache_ = cache;
+    }
+    /**
+     * @brief 获取数据块缓存
+     *
+     * @return std::shared_ptr<PatternBlockCache> 缓存，未设置时为空
+     */
+    std::shared_ptr<PatternBlockCache> getCache() const { return cache_; }
+    /**
+     * @brief 设置并行编码线程数量
+     *
+     * @param numOfThreads 后台线程数量，0表示按硬件并发数
+     */
+    void setNumOfThreads(IN const size_t numOfThreads);
+    /**
+     * @brief 获取目标DMD
+     *
+     * @return DLPC34XX_INT_PAT_DMD_e 目标DMD
+     */
+    DLPC34XX_INT_PAT_DMD_e getDMD() const { return dmd_; }
+    /**
+     * @brief 获取build制作的图案顺序表
+     *
+     * @return const std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s>& 图案顺序表
+     */
+    const std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s> &
+    getPatternOrderTable() const {
+        return patternOrderTable_;
+    }
+    /**
+     * @brief 获取图案数量
+     *
+     * @return int 图案数量
+     */
+    int getNumOfPatterns() const { return (int)patterns_.size(); }
+    /**
+     * @brief 获取图案集合数量
+     *
+     * @return int 图案集合数量
+     */
+    int getNumOfPatternSets() const { return (int)patternSets_.size(); }
+
+  private:
+    /**
+     * @brief 在线程池中并行编码每张图案到block_，不经过缓存
+     *
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @return true 成功
+     * @return false 失败
+     */
+    bool encodeSlots(IN const bool eastWestFlip, IN const bool longAxisFlip);
+    /**
+     * @brief 计算哈希，每张图案的像素由fetch给出
+     *
+     * @param eastWestFlip 是否东西翻转
+     * @param longAxisFlip 是否沿长轴翻转
+     * @param fetch 取出第i个集合第j张图案的像素，失败时返回false
+     * @return uint64_t 哈希，fetch失败时为0
+     */
+    uint64_t hashPatterns(
+        IN const bool eastWestFlip, IN const bool longAxisFlip,
+        IN const std::function<bool(uint32_t, uint32_t,
+                                    DLPC34XX_INT_PAT_PatternData_s &)> &fetch)
+        const;
+    //目标DMD
+    const DLPC34XX_INT_PAT_DMD_e dmd_;
+    //编码上下文
+    DLPC34XX_INT_PAT_Encoder_s encoder_;
+    //图案数据
+    std::vector<DLPC34XX_INT_PAT_PatternData_s> patterns_;
+    //图案集合
+    std::vector<DLPC34XX_INT_PAT_PatternSet_s> patternSets_;
+    //图案顺序表
+    std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s> patternOrderTable_;
+    //从图案源读取的集合参数，像素线为空
+    std::vector<PatternProfileSet> sourceTable_;
+    /** @brief 图案在数据块中的位置 */
+    struct PatternSlot {
+        uint32_t patternSetIndex_;
+        uint32_t patternIndex_;
+        bool isMaster_;
+    };
+    //待并行编码的图案位置
+    std::vector<PatternSlot> slots_;
+    //并行编码输出的数据块
+    std::vector<uint8_t> block_;
+    //后台线程数量
+    size_t numOfThreads_;
+    //并行编码线程池，首次并行编码时创建
+    std::unique_ptr<ThreadPool> threadPool_;
+    //数据块缓存
+    std::shared_ptr<PatternBlockCache> cache_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_PATTERN_ENCODER_H_
@@ -0,0 +1,134 @@
+/**
+ * @file patternLoader.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_PATTERN_LOADER_H_
+#define __PROJECTOR_PATTERN_LOADER_H_
+
+#include "projector.h"
+
+#include "flashProgrammer.h"
+#include "patternEncoder.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 图案表的加载流程，DLPC34xx与DLPC34xx dual控制器共用
+ * @note flash中已是相同的数据块时跳过擦除与烧录；否则擦除（同时编码）并烧录，
+ *       最后由控制器从flash重新加载图案序列。需在投影仪的命令执行线程中调用
+ */
+class DEVICE_API PatternLoader {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param encoder 图案数据块编码器
+     * @param flashProgrammer flash烧录器
+     * @param prepare 检查与烧录flash之前的控制器步骤（如停止投影），可为空
+     * @param reload 控制器从flash重新加载图案序列
+     */
+    PatternLoader(IN PatternEncoder &encoder,
+                  IN FlashProgrammer &flashProgrammer,
+                  IN const std::function<void()> &prepare,
+                  IN const std::function<void()> &reload);
+    PatternLoader(const PatternLoader &) = delete;
+    PatternLoader &operator=(const PatternLoader &) = delete;
+    /**
+     * @brief 从一维图案集合制作投影序列
+     * @note 数据块在擦除flash期间于后台线程编码，总耗时约为max(擦除, 编码)+烧录
+     *
+     * @param table 一维图案集合
+     * @return true 成功
+     * @return false 失败
+     */
+    bool populate(IN const std::vector<PatternProfileSet> &table);
+    /**
+     * @brief 从图案源流式制作投影序列
+     * @note 由集合参数与图案源的指纹判断是否跳过烧录，不预先读取图案；
+     *       需要烧录时每张图案只读取一次，第一块数据在最后一张图案生成之前即开始烧录
+     *
+     * @param source 图案源
+     * @return true 成功
+     * @return false 失败
+     */
+    bool populate(IN PatternSource &source);
+    /**
+     * @brief 从离线编译的图案数据块文件（.patn）制作投影序列
+     *
+     * @param path 数据块文件路径
+     * @return true 成功
+     * @return false 文件无效、DMD不一致或烧录失败
+     */
+    bool loadFile(IN const std::string &path);
+    /**
+     * @brief 预估一维图案集合的烧录，不访问设备
+     *
+     * @param table 一维图案集合
+     * @param plan 预估结果
+     * @return true 图案表有效且能放入flash
+     * @return false 图案表无效或超出flash容量
+     */
+    bool plan(IN const std::vector<PatternProfileSet> &table,
+              OUT PatternTablePlan &plan) const;
+    /**
+     * @brief 获取最近一次加载的图案数量
+     *
+     * @return int 图案数量
+     */
+    int getNumOfPatterns() const { return numOfPatterns_; }
+    /**
+     * @brief 获取最近一次加载的图案集合数量
+     *
+     * @return int 图案集合数量
+     */
+    int getNumOfPatternSets() const { return numOfPatternSets_; }
+
+  private:
+    /**
+     * @brief 烧录图案数据块，flash中已是相同的数据块时跳过擦除与烧录
+     *
+     * @param blockSize 数据块大小
+     * @param header 数据块头部，用于与flash中的头部比较
+     * @param headerSize 数据块头部大小
+     * @param fingerprint 数据块指纹
+     * @param encodeBlock 需要烧录时在后台线程中与擦除同时运行，为空时不调用
+     * @param writeBlock 擦除与encodeBlock都完成后调用，按顺序把整个数据块写入flashProgrammer_
+     * @return true 成功
+     * @return false 数据块超出flash容量（未擦除），或encodeBlock、writeBlock失败
+     */
+    bool programBlock(IN const uint32_t blockSize, IN const uint8_t *header,
+                      IN const uint32_t headerSize,
+                      IN const uint64_t fingerprint,
+                      IN const std::function<bool()> &encodeBlock,
+                      IN const std::function<bool()> &writeBlock);
+    //图案数据块编码器
+    PatternEncoder &encoder_;
+    //flash烧录器
+    FlashProgrammer &flashProgrammer_;
+    //检查与烧录flash之前的控制器步骤
+    std::function<void()> prepare_;
+    //控制器从flash重新加载图案序列
+    std::function<void()> reload_;
+    //图案数量
+    int numOfPatterns_;
+    //图案集合数量
+    int numOfPatternSets_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_PATTERN_LOADER_H_
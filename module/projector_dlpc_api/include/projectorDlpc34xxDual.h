@@ -14,8 +14,18 @@
 
 #include "projector.h"
 
+#include "commandExecutor.h"
 #include "dlpc347x_internal_patterns.h"
 #include "dlpc_common.h"
+#include "flashProgrammer.h"
+#include "healthMonitor.h"
+#include "patternEncoder.h"
+#include "patternLoader.h"
+#include "transport.h"
+
+#include <functional>
+#include <future>
+#include <memory>
 
 #include <time.h>
 
@@ -23,7 +33,11 @@
 namespace slmaster {
 /** @brief 设备库 **/
 namespace device {
-/** @brief DLPC34xx dual系列投影仪 */
+/**
+ * @brief DLPC34xx dual系列投影仪
+ * @note 控制器命令都在投影仪的命令执行线程中执行，调用方线程提交后等待结果；
+ *       步进、开始、停止等关键命令排在其它命令之前，并可插在flash擦除与烧录的间隙执行
+ */
 class DEVICE_API ProjectorDlpc34xxDual : public Projector {
   public:
     ProjectorDlpc34xxDual();
@@ -55,13 +69,55 @@ class DEVICE_API ProjectorDlpc34xxDual : public Projector {
      * @return false 失败
      */
     bool isConnect() override;
+    using Projector::populatePatternTableData;
+    using Projector::planPatternTableData;
+    /**
+     * @brief 从一维图案集合制作投影序列
+     * @note 数据块在擦除flash期间于后台线程编码，总耗时约为max(擦除, 编码)+烧录
+     *
+     * @param table 一维图案集合
+     * @return true 成功
+     * @return false 失败
+     */
+    bool populatePatternTableData(
+        IN const std::vector<PatternProfileSet> &table) override;
+    /**
+     * @brief 预估一维图案集合的烧录，不访问设备
+     *
+     * @param table 一维图案集合
+     * @param plan 预估结果
+     * @return true 图案表有效且能放入flash
+     * @return false 图案表无效或超出flash容量
+     */
+    bool planPatternTableData(IN const std::vector<PatternProfileSet> &table,
+                              OUT PatternTablePlan &plan) override;
+    /**
+     * @brief 从离线编译的图案数据块文件（.patn）制作投影序列
+     *
+     * @param path 数据块文件路径
+     * @return true 成功
+     * @return false 失败
+     */
+    bool loadPatternBlockFile(IN const std::string &path) override;
+    /**
+     * @brief 从图案源流式制作投影序列
+     * @note 由集合参数与PatternSource::getFingerprint()判断，flash中已是相同数据块时跳过烧录，
+     *       不预先读取图案；否则擦除后逐张生成、编码并写入flash，每张图案只读取一次，
+     *       只保留当前集合的像素线和烧录环形缓冲区
+     *
+     * @param source 图案源
+     * @return true 成功
+     * @return false 失败
+     */
+    bool populatePatternTableData(IN PatternSource &source) override;
     /**
-     * @brief 从图案集制作投影序列
+     * @brief 在命令执行线程中从图案源流式制作投影序列，不等待完成
+     * @note 烧录期间提交的关键命令插在写入命令之间执行
      *
-     * @param table 投影图案集
+     * @param source 图案源，需保持有效直到返回值就绪
+     * @return std::future<bool> 是否成功
      */
-    bool
-    populatePatternTableData(IN std::vector<PatternOrderSet> table) override;
+    std::future<bool> populatePatternTableDataAsync(IN PatternSource &source);
     /**
      * @brief 投影
      *
@@ -99,6 +155,26 @@ class DEVICE_API ProjectorDlpc34xxDual : public Projector {
      * @return false
      */
     bool step() override;
+    /**
+     * @brief 提交投影命令，不等待完成
+     *
+     * @param isContinue 是否连续投影
+     * @return std::future<bool> 是否成功
+     */
+    std::future<bool> projectAsync(IN const bool isContinue);
+    /**
+     * @brief 提交停止命令，不等待完成
+     *
+     * @return std::future<bool> 是否成功
+     */
+    std::future<bool> stopAsync();
+    /**
+     * @brief 提交步进命令，不等待完成
+     * @warning 仅在步进模式下使用
+     *
+     * @return std::future<bool> 是否成功
+     */
+    std::future<bool> stepAsync();
     /**
      * @brief 获取当前LED三色灯电流值
      *
@@ -126,6 +202,62 @@ class DEVICE_API ProjectorDlpc34xxDual : public Projector {
      * @return int 图片数量
      */
     int getFlashImgsNum() override;
+    /**
+     * @brief 设置图案数据块缓存目录
+     *
+     * @param directory 缓存目录，空字符串表示关闭缓存
+     * @return true 成功
+     * @return false 目录不可用
+     */
+    bool setPatternCacheDirectory(IN const std::string &directory) override;
+    /**
+     * @brief 获取图案数据块缓存统计
+     *
+     * @return PatternCacheStats 统计
+     */
+    PatternCacheStats getPatternCacheStats() override;
+    /**
+     * @brief 设置控制器命令的传输，在connect()前调用，默认经由Cypress USB-Serial
+     *
+     * @param transport 传输
+     */
+    void setTransport(IN const std::shared_ptr<Transport> &transport);
+    /**
+     * @brief 获取最近一次flash烧录的统计
+     *
+     * @return FlashProgramStats 统计
+     */
+    FlashProgramStats getFlashProgramStats() override;
+    /**
+     * @brief 开启快速控制，控制命令只发送命令本身，由后台线程按间隔检查短状态与系统状态
+     *
+     * @param interval 检查间隔
+     * @param onFault 故障回调，在后台线程中调用
+     * @return true 成功
+     * @return false 未连接
+     */
+    bool enableFastControl(IN const std::chrono::milliseconds interval,
+                           IN const ProjectorFaultCallback &onFault) override;
+    /**
+     * @brief 关闭快速控制
+     */
+    void disableFastControl() override;
+    /**
+     * @brief 清空寄存器影子，控制器被外部复位或配置后调用，之后的读写都访问控制器
+     */
+    void invalidateRegisterShadow() { registerShadow_.invalidate(); }
+    /**
+     * @brief 获取本投影仪的命令统计，默认关闭
+     *
+     * @return CommandStats& 命令统计
+     */
+    CommandStats &getCommandStats() { return commandContext_.getStats(); }
+    /**
+     * @brief 获取插在批量工作中执行的关键命令数量
+     *
+     * @return uint64_t 数量
+     */
+    uint64_t getNumOfUrgentCommands() { return executor_.getNumOfUrgentRuns(); }
   private:
     /**
      * @brief 初始化Cypress USB-Serial和DLPC控制器
@@ -133,21 +265,59 @@ class DEVICE_API ProjectorDlpc34xxDual : public Projector {
      * @return bool 成功初始化
      */
     bool initConnectionAndCommandLayer();
+    /**
+     * @brief 控制命令前的连接检查，快速控制时使用后台检查的结果，否则读取短状态
+     *
+     * @return true 已连接
+     * @return false 未连接
+     */
+    bool isReady();
+    /**
+     * @brief 后台检查：读取短状态与系统状态，有命令在执行或排队时跳过
+     *
+     * @param fault 检查结果
+     * @return true 已检查
+     * @return false 本次跳过
+     */
+    bool checkHealth(OUT ProjectorFault &fault);
     /**
      * @brief 从flash加载图案序列
      *
      */
     void loadPatternOrderTableEntryFromFlash();
+    /**
+     * @brief 按缓存目录与传输的设备标识设置flash指纹记录文件
+     *
+     */
+    void updateFingerprintFile();
     //是否已成功初始化
     bool isInitial_;
     //投影仪幅面列数
     uint16_t cols_;
     //投影仪幅面行数
     uint16_t rows_;
-    //图案数量
-    int numOfPatterns_;
-    //图案集合数量
-    int numOfPatternSets_;
+    //图案数据块编码器
+    PatternEncoder patternEncoder_;
+    //flash烧录器
+    FlashProgrammer flashProgrammer_;
+    //图案表的加载流程
+    PatternLoader patternLoader_;
+    //图案数据块缓存目录，同时存放flash指纹记录，空表示未设置
+    std::string patternCacheDirectory_;
+    //命令写缓冲区，可容纳最长的flash写入命令
+    std::vector<uint8_t> writeBuffer_;
+    //命令读缓冲区
+    std::vector<uint8_t> readBuffer_;
+    //控制器命令的传输
+    std::shared_ptr<Transport> transport_;
+    //寄存器影子
+    RegisterShadow registerShadow_;
+    //命令库上下文，每台投影仪独立，可在同一进程中并行收发命令
+    CommandContext commandContext_;
+    //快速控制的后台检查线程
+    HealthMonitor healthMonitor_;
+    //命令执行线程，最先析构
+    CommandExecutor executor_;
 };
 } // namespace device
 } // namespace slmaster
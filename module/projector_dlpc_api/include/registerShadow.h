@@ -0,0 +1,130 @@
+/**
+ * @file registerShadow.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_REGISTER_SHADOW_H_
+#define __PROJECTOR_REGISTER_SHADOW_H_
+
+#include "typeDef.h"
+
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 控制器寄存器的主机端影子
+ * @note 只保存读多写少、只由主机修改的配置：工作模式、显示尺寸、LED控制方式与使能、LED最大电流、
+ *       触发配置与控制器ID。与影子相同的写命令不再发送，能由影子应答的读命令不再访问总线；
+ *       图案控制、flash与状态等命令不经过影子。重新连接或任一命令传输失败时清空
+ */
+class DEVICE_API RegisterShadow {
+  public:
+    RegisterShadow();
+    /**
+     * @brief 清空影子，之后的读写都访问控制器
+     */
+    void invalidate();
+    /**
+     * @brief 写命令是否与影子相同，相同时无需发送
+     *
+     * @param pData 操作码与参数
+     * @param length 长度
+     * @return true 相同
+     * @return false 不同或不在影子中
+     */
+    bool isRedundantWrite(IN const uint8_t *pData, IN const uint16_t length);
+    /**
+     * @brief 写命令发送后更新影子
+     *
+     * @param pData 操作码与参数
+     * @param length 长度
+     * @param isSucess 传输是否成功
+     */
+    void onWrite(IN const uint8_t *pData, IN const uint16_t length,
+                 IN const bool isSucess);
+    /**
+     * @brief 由影子应答读命令
+     *
+     * @param pWriteData 操作码与参数
+     * @param writeLength 长度
+     * @param pReadData 应答
+     * @param readLength 应答长度
+     * @return true 已应答
+     * @return false 需访问控制器
+     */
+    bool read(IN const uint8_t *pWriteData, IN const uint16_t writeLength,
+              OUT uint8_t *pReadData, IN const uint16_t readLength);
+    /**
+     * @brief 读命令完成后更新影子
+     *
+     * @param pWriteData 操作码与参数
+     * @param writeLength 长度
+     * @param pReadData 应答
+     * @param readLength 应答长度
+     * @param isSucess 传输是否成功
+     */
+    void onRead(IN const uint8_t *pWriteData, IN const uint16_t writeLength,
+                IN const uint8_t *pReadData, IN const uint16_t readLength,
+                IN const bool isSucess);
+    /**
+     * @brief 获取未发送的写命令数量
+     *
+     * @return uint64_t 数量
+     */
+    uint64_t getNumOfSkippedWrites();
+    /**
+     * @brief 获取由影子应答的读命令数量
+     *
+     * @return uint64_t 数量
+     */
+    uint64_t getNumOfCachedReads();
+
+  private:
+    /**
+     * @brief 查找写命令对应的影子键
+     *
+     * @param pData 操作码与参数
+     * @param length 长度
+     * @param key 影子键
+     * @return true 在影子中
+     * @return false 不在影子中
+     */
+    bool findWriteKey(IN const uint8_t *pData, IN const uint16_t length,
+                      OUT uint16_t &key) const;
+    /**
+     * @brief 查找读命令对应的影子键
+     *
+     * @param pData 操作码与参数
+     * @param length 长度
+     * @param key 影子键
+     * @return true 可由影子应答
+     * @return false 不可
+     */
+    bool findReadKey(IN const uint8_t *pData, IN const uint16_t length,
+                     OUT uint16_t &key) const;
+
+    //互斥锁，烧录I/O线程与调用方线程都会发送命令
+    std::mutex mutex_;
+    //寄存器值，键为写命令操作码与索引参数
+    std::map<uint16_t, std::vector<uint8_t>> values_;
+    //未发送的写命令数量
+    uint64_t numOfSkippedWrites_;
+    //由影子应答的读命令数量
+    uint64_t numOfCachedReads_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_REGISTER_SHADOW_H_
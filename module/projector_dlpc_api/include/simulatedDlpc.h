@@ -0,0 +1,281 @@
+/**
+ * @file simulatedDlpc.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_SIMULATED_DLPC_H_
+#define __PROJECTOR_SIMULATED_DLPC_H_
+
+#include "transport.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 模拟控制器的时延模型
+ * @note 每次传输耗时为每次调用的固定开销乘以调用次数，加上各字节（含地址字节）按每字节9个时钟的传输时间
+ */
+struct SimulatedDlpcTiming {
+    uint32_t clockFrequency_;   //I2C时钟频率(Hz)，0表示传输不耗时
+    double transactionSeconds_; //每次调用的固定开销(s)，如USB桥接的往返
+    uint32_t callsPerRead_;     //读命令的调用次数，写与读分开发送时为2
+    double eraseSeconds_;       //擦除flash的耗时(s)
+
+    /**
+     * @brief 不模拟耗时，用于功能测试
+     *
+     * @return SimulatedDlpcTiming 时延模型
+     */
+    static SimulatedDlpcTiming instant() { return {0, 0, 1, 0}; }
+    /**
+     * @brief 经由Cypress USB-Serial桥接芯片的典型耗时，读命令的写与读各一次USB往返
+     *
+     * @param clockFrequency I2C时钟频率(Hz)
+     * @param eraseSeconds 擦除flash的耗时(s)
+     * @return SimulatedDlpcTiming 时延模型
+     */
+    static SimulatedDlpcTiming
+    cypress(IN const uint32_t clockFrequency = 100000,
+            IN const double eraseSeconds = 2.0) {
+        return {clockFrequency, 0.001, 2, eraseSeconds};
+    }
+    /**
+     * @brief 经由Linux i2c-dev的典型耗时，读命令以一次系统调用完成
+     *
+     * @param clockFrequency I2C时钟频率(Hz)
+     * @param eraseSeconds 擦除flash的耗时(s)
+     * @return SimulatedDlpcTiming 时延模型
+     */
+    static SimulatedDlpcTiming
+    linuxI2c(IN const uint32_t clockFrequency = 400000,
+             IN const double eraseSeconds = 2.0) {
+        return {clockFrequency, 0.00005, 1, eraseSeconds};
+    }
+};
+
+/**
+ * @brief DLPC34xx/DLPC34xx双控制器的软件模型，不访问硬件
+ * @note 解码dlpc34xx.c/dlpc34xx_dual.c使用的命令：flash擦除、烧录与读取，图案顺序表重载，
+ *       内部图案控制，短状态与控制器ID；其余写命令按寄存器保存，读命令（写命令操作码+1）
+ *       返回最近写入的内容。flash按NOR语义只能把位从1写为0。
+ *       图案状态只随命令变化，不模拟按曝光时间自动播放
+ */
+class DEVICE_API SimulatedDlpcTransport : public Transport {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param timing 时延模型
+     * @param flashSize 图案数据区容量(byte)
+     * @param deviceId 控制器ID，默认为DLPC3479
+     */
+    explicit SimulatedDlpcTransport(
+        IN const SimulatedDlpcTiming &timing = SimulatedDlpcTiming::instant(),
+        IN const uint32_t flashSize = 4 * 1024 * 1024,
+        IN const uint8_t deviceId = 0xC);
+    bool open() override;
+    void close() override;
+    bool write(IN uint16_t length, IN const uint8_t *pData) override;
+    bool writeRead(IN uint16_t writeLength, IN const uint8_t *pWriteData,
+                   IN uint16_t readLength, OUT uint8_t *pReadData) override;
+    uint32_t
+    negotiateClockFrequency(IN const std::function<bool()> &linkTest) override;
+    uint32_t getClockFrequency() override { return timing_.clockFrequency_; }
+    std::string getIdentity() override { return identity_; }
+    /**
+     * @brief 设置标识，模拟同一主机上的多个桥接芯片
+     *
+     * @param identity 标识，默认为空（未知）
+     */
+    void setIdentity(IN const std::string &identity) { identity_ = identity; }
+    /**
+     * @brief 设置单条flash写命令的最大数据长度，超出时命令失败
+     *
+     * @param length 最大数据长度(byte)，0表示不限制
+     */
+    void setMaxFlashWriteLength(IN const uint16_t length);
+    /**
+     * @brief 模拟接下来的若干条flash写命令在总线上被NAK，控制器未收到
+     *
+     * @param count 命令条数
+     */
+    void setFlashWriteNaks(IN const uint32_t count);
+    /**
+     * @brief 获取flash图案数据区的内容
+     *
+     * @return std::vector<uint8_t> flash内容
+     */
+    std::vector<uint8_t> getFlash();
+    /**
+     * @brief 直接改写flash图案数据区的一个字节，模拟flash被其它工具改写
+     *
+     * @param offset 偏移
+     * @param value 新的值
+     */
+    void setFlashByte(IN const uint32_t offset, IN const uint8_t value);
+    /**
+     * @brief 图案是否正在投影
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isPatternRunning();
+    /**
+     * @brief 模拟控制器系统错误，短状态的系统错误位随之置位
+     *
+     * @param isError 是否存在系统错误
+     */
+    void setSystemError(IN const bool isError);
+    /**
+     * @brief 获取擦除次数
+     *
+     * @return uint64_t 次数
+     */
+    uint64_t getNumOfErases();
+    /**
+     * @brief 获取传输次数
+     *
+     * @return uint64_t 次数
+     */
+    uint64_t getNumOfTransactions();
+    /**
+     * @brief 获取传输的字节数，不含地址字节
+     *
+     * @return uint64_t 字节数
+     */
+    uint64_t getNumOfBytes();
+    /**
+     * @brief 获取时延模型计算的链路占用时间，不含擦除
+     *
+     * @return double 时间(s)
+     */
+    double getLinkSeconds();
+
+  private:
+    /** @brief 图案顺序表中的一项 */
+    struct OrderEntry {
+        uint8_t patternSetIndex_;    //图案集合索引
+        uint8_t numDisplayPatterns_; //显示的图案数量
+    };
+    /**
+     * @brief 按时延模型占用链路
+     *
+     * @param numOfBytes 传输的字节数，不含地址字节
+     * @param numOfMessages I2C消息数
+     * @param numOfCalls 调用次数
+     */
+    void occupyLink(IN const uint32_t numOfBytes,
+                    IN const uint32_t numOfMessages,
+                    IN const uint32_t numOfCalls);
+    /**
+     * @brief 执行写命令
+     *
+     * @param pData 操作码与参数
+     * @param length 长度
+     * @return true 成功
+     * @return false 失败
+     */
+    bool executeWrite(IN const uint8_t *pData, IN const uint16_t length);
+    /**
+     * @brief 执行读命令
+     *
+     * @param pData 操作码与参数
+     * @param length 长度
+     * @param pReadData 应答
+     * @param readLength 应答长度
+     * @return true 成功
+     * @return false 失败
+     */
+    bool executeRead(IN const uint8_t *pData, IN const uint16_t length,
+                     OUT uint8_t *pReadData, IN const uint16_t readLength);
+    /**
+     * @brief 写入flash
+     *
+     * @param pData 数据
+     * @param length 长度
+     * @return true 成功
+     * @return false 失败
+     */
+    bool programFlash(IN const uint8_t *pData, IN const uint16_t length);
+    /**
+     * @brief 从flash中的"PATN"数据块重载图案顺序表
+     */
+    void reloadOrderTable();
+    /**
+     * @brief 执行内部图案控制
+     *
+     * @param control 控制命令
+     */
+    void controlPattern(IN const uint8_t control);
+    /**
+     * @brief 擦除是否完成
+     *
+     * @return true 是
+     * @return false 否
+     */
+    bool isEraseComplete() const;
+
+    //时延模型
+    const SimulatedDlpcTiming timing_;
+    //控制器ID
+    const uint8_t deviceId_;
+    //标识
+    std::string identity_;
+    //互斥锁
+    std::mutex mutex_;
+    //是否已连接
+    bool isOpen_;
+    //flash图案数据区
+    std::vector<uint8_t> flash_;
+    //flash读写位置
+    uint32_t flashAddress_;
+    //flash数据长度
+    uint16_t flashDataLength_;
+    //单条flash写命令的最大数据长度，0表示不限制
+    uint16_t maxFlashWriteLength_;
+    //接下来被NAK的flash写命令条数
+    uint32_t numOfFlashWriteNaks_;
+    //擦除完成的时刻
+    std::chrono::steady_clock::time_point eraseDoneTime_;
+    //是否发生flash错误
+    bool isFlashError_;
+    //是否存在系统错误
+    bool isSystemError_;
+    //写命令保存的参数，按操作码索引
+    std::map<uint8_t, std::vector<uint8_t>> registers_;
+    //图案顺序表
+    std::vector<OrderEntry> orderTable_;
+    //图案集合中的图案数量
+    std::vector<uint8_t> patternSetSizes_;
+    //图案是否正在投影
+    bool isRunning_;
+    //当前图案顺序表项
+    size_t orderIndex_;
+    //当前表项已显示的图案数量
+    uint8_t numOfDisplayed_;
+    //链路空闲的时刻
+    std::chrono::steady_clock::time_point linkFreeTime_;
+    //擦除次数
+    uint64_t numOfErases_;
+    //传输次数
+    uint64_t numOfTransactions_;
+    //传输的字节数
+    uint64_t numOfBytes_;
+    //链路占用时间(s)
+    double linkSeconds_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_SIMULATED_DLPC_H_
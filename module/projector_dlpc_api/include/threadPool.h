@@ -0,0 +1,100 @@
+/**
+ * @file threadPool.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_THREAD_POOL_H_
+#define __PROJECTOR_THREAD_POOL_H_
+
+#include "typeDef.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 固定大小的线程池，用于把一批相互独立的任务分到多个核心上执行
+ */
+class DEVICE_API ThreadPool {
+  public:
+    /**
+     * @brief 并行任务，index为任务序号，worker为执行线程序号
+     * @note worker取值范围为[0, getNumOfWorkers())，同一时刻不会有两个任务使用同一个worker
+     */
+    using Task = std::function<void(size_t index, size_t worker)>;
+    /**
+     * @brief 构造
+     *
+     * @param numOfThreads 后台线程数量，0表示使用硬件并发数减一（调用线程也参与执行）
+     */
+    explicit ThreadPool(IN const size_t numOfThreads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    /**
+     * @brief 获取参与执行的线程数量（包括调用线程）
+     *
+     * @return size_t 线程数量
+     */
+    size_t getNumOfWorkers() const { return threads_.size() + 1; }
+    /**
+     * @brief 并行执行count个任务，全部完成后返回
+     *
+     * @param count 任务数量
+     * @param task 任务
+     */
+    void parallelFor(IN const size_t count, IN const Task &task);
+
+  private:
+    /**
+     * @brief 后台线程主循环
+     *
+     * @param worker 线程序号
+     */
+    void run(IN const size_t worker);
+    /**
+     * @brief 领取并执行任务，直到任务全部被领取
+     *
+     * @param worker 线程序号
+     */
+    void work(IN const size_t worker);
+    //后台线程
+    std::vector<std::thread> threads_;
+    //保证同一时刻只有一批任务
+    std::mutex parallelForMutex_;
+    //保护以下状态
+    std::mutex mutex_;
+    //新一批任务到达或退出
+    std::condition_variable wakeUp_;
+    //后台线程全部完成
+    std::condition_variable done_;
+    //当前任务
+    const Task *task_;
+    //当前任务数量
+    size_t count_;
+    //下一个待领取的任务序号
+    std::atomic<size_t> next_;
+    //尚未完成当前批次的后台线程数量
+    size_t numOfBusy_;
+    //批次序号
+    uint64_t generation_;
+    //是否退出
+    bool isExit_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_THREAD_POOL_H_
@@ -0,0 +1,339 @@
+/**
+ * @file transport.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_TRANSPORT_H_
+#define __PROJECTOR_TRANSPORT_H_
+
+#include "commandStats.h"
+#include "dlpc_common.h"
+#include "registerShadow.h"
+#include "typeDef.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//DLPC控制器的7位I2C地址
+#define DLPC_I2C_ADDRESS (0x36 >> 1)
+
+struct CYPRESS_I2C_Device;
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief DLPC命令的传输通道
+ * @note 由CommandContext::init()绑定到DLPC命令库上下文，选择该上下文的命令都经由绑定的传输
+ */
+class DEVICE_API Transport {
+  public:
+    virtual ~Transport() {}
+    /**
+     * @brief 判断设备是否存在，不建立连接
+     *
+     * @return true 存在
+     * @return false 不存在
+     */
+    virtual bool isPresent() { return true; }
+    /**
+     * @brief 建立连接
+     *
+     * @return true 成功
+     * @return false 失败
+     */
+    virtual bool open() = 0;
+    /**
+     * @brief 断开连接
+     */
+    virtual void close() = 0;
+    /**
+     * @brief 写入
+     *
+     * @param length 数据长度
+     * @param pData 数据
+     * @return true 成功
+     * @return false 失败
+     */
+    virtual bool write(IN uint16_t length, IN const uint8_t *pData) = 0;
+    /**
+     * @brief 写入命令后读取应答
+     * @note 支持时在同一次传输中以重复起始条件完成写与读
+     *
+     * @param writeLength 写入数据长度
+     * @param pWriteData 写入数据
+     * @param readLength 读取数据长度
+     * @param pReadData 读取到的数据
+     * @return true 成功
+     * @return false 失败
+     */
+    virtual bool writeRead(IN uint16_t writeLength, IN const uint8_t *pWriteData,
+                           IN uint16_t readLength, OUT uint8_t *pReadData) = 0;
+    /**
+     * @brief 协商时钟频率
+     *
+     * @param linkTest 在当前频率下检查链路，全部成功时返回true
+     * @return uint32_t 协商后的时钟频率(Hz)，0表示未知或失败
+     */
+    virtual uint32_t
+    negotiateClockFrequency(IN const std::function<bool()> &linkTest) {
+        return getClockFrequency();
+    }
+    /**
+     * @brief 获取当前时钟频率
+     *
+     * @return uint32_t 时钟频率(Hz)，0表示未知
+     */
+    virtual uint32_t getClockFrequency() { return 0; }
+    /**
+     * @brief 获取所连接设备的标识，用于区分同一主机上的多台设备
+     * @note 标识在设备重新连接后保持不变；部分传输需在open()后才能确定
+     *
+     * @return std::string 标识，空字符串表示未知
+     */
+    virtual std::string getIdentity() { return ""; }
+};
+
+/**
+ * @brief 经由Cypress USB-Serial桥接芯片传输
+ * @note 依赖cyusbserial库，未随库构建时open()返回false；每个实例独立持有桥接芯片句柄，
+ *       同一进程中可连接多个桥接芯片
+ */
+class DEVICE_API CypressTransport : public Transport {
+  public:
+    /**
+     * @brief 构造
+     * @note 序列号非空时按序列号选择桥接芯片，否则按索引选择；都未指定时使用第一个可打开的桥接芯片
+     *
+     * @param serialNumber 桥接芯片的USB序列号
+     * @param bridgeIndex 桥接芯片I2C接口按枚举顺序的索引，-1表示不指定
+     */
+    explicit CypressTransport(IN const std::string &serialNumber = "",
+                              IN const int bridgeIndex = -1);
+    ~CypressTransport();
+    CypressTransport(const CypressTransport &) = delete;
+    CypressTransport &operator=(const CypressTransport &) = delete;
+    bool isPresent() override;
+    bool open() override;
+    void close() override;
+    bool write(IN uint16_t length, IN const uint8_t *pData) override;
+    bool writeRead(IN uint16_t writeLength, IN const uint8_t *pWriteData,
+                   IN uint16_t readLength, OUT uint8_t *pReadData) override;
+    uint32_t
+    negotiateClockFrequency(IN const std::function<bool()> &linkTest) override;
+    uint32_t getClockFrequency() override;
+    /**
+     * @brief 获取桥接芯片的标识
+     * @note 已连接时为桥接芯片的USB序列号；未连接时为构造时指定的序列号或索引，都未指定时为空
+     *
+     * @return std::string 标识
+     */
+    std::string getIdentity() override;
+
+  private:
+    //桥接芯片的USB序列号
+    const std::string serialNumber_;
+    //桥接芯片I2C接口的索引
+    const int bridgeIndex_;
+    //桥接芯片连接
+    CYPRESS_I2C_Device *device_;
+};
+
+/**
+ * @brief 经由Linux i2c-dev接口传输
+ * @note 读命令以一次I2C_RDWR完成写入与重复起始读取；时钟频率由内核设备树决定，
+ *       非Linux平台open()返回false
+ */
+class DEVICE_API LinuxI2cTransport : public Transport {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param devicePath i2c-dev设备路径
+     * @param address 控制器的7位I2C地址
+     */
+    explicit LinuxI2cTransport(IN const std::string &devicePath = "/dev/i2c-1",
+                               IN const uint16_t address = DLPC_I2C_ADDRESS);
+    ~LinuxI2cTransport();
+    bool isPresent() override;
+    bool open() override;
+    void close() override;
+    bool write(IN uint16_t length, IN const uint8_t *pData) override;
+    bool writeRead(IN uint16_t writeLength, IN const uint8_t *pWriteData,
+                   IN uint16_t readLength, OUT uint8_t *pReadData) override;
+    /**
+     * @brief 获取标识
+     *
+     * @return std::string i2c-dev设备路径与控制器地址
+     */
+    std::string getIdentity() override;
+
+  private:
+    //i2c-dev设备路径
+    const std::string devicePath_;
+    //控制器的7位I2C地址
+    const uint16_t address_;
+    //设备文件描述符，-1表示未打开
+    int fd_;
+};
+
+/**
+ * @brief 内存回环传输，不访问硬件
+ * @note 默认读取返回最近一次写入的数据，不足部分补0；可设置应答函数模拟控制器
+ */
+class DEVICE_API LoopbackTransport : public Transport {
+  public:
+    /**
+     * @brief 应答函数，readLength为0时表示只写入
+     */
+    using Responder = std::function<bool(
+        const uint8_t *pWriteData, uint16_t writeLength, uint8_t *pReadData,
+        uint16_t readLength)>;
+
+    LoopbackTransport();
+    bool open() override;
+    void close() override;
+    bool write(IN uint16_t length, IN const uint8_t *pData) override;
+    bool writeRead(IN uint16_t writeLength, IN const uint8_t *pWriteData,
+                   IN uint16_t readLength, OUT uint8_t *pReadData) override;
+    /**
+     * @brief 设置应答函数
+     *
+     * @param responder 应答函数，为空时恢复回环
+     */
+    void setResponder(IN const Responder &responder) { responder_ = responder; }
+    /**
+     * @brief 获取最近一次写入的数据
+     *
+     * @return const std::vector<uint8_t>& 数据
+     */
+    const std::vector<uint8_t> &getLastWrite() const { return lastWrite_; }
+    /**
+     * @brief 获取写入次数
+     *
+     * @return uint64_t 次数
+     */
+    uint64_t getNumOfWrites() const { return numOfWrites_; }
+    /**
+     * @brief 获取读取次数
+     *
+     * @return uint64_t 次数
+     */
+    uint64_t getNumOfReads() const { return numOfReads_; }
+
+  private:
+    //应答函数
+    Responder responder_;
+    //最近一次写入的数据
+    std::vector<uint8_t> lastWrite_;
+    //写入次数
+    uint64_t numOfWrites_;
+    //读取次数
+    uint64_t numOfReads_;
+    //是否已连接
+    bool isOpen_;
+};
+
+/**
+ * @brief DLPC命令库的实例状态：读写缓冲区、传输、寄存器影子与命令统计
+ * @note 每个控制器连接持有一个上下文，多个投影仪可在同一进程中并行收发命令；
+ *       命令库函数使用调用线程通过CommandContextScope选择的上下文
+ */
+class DEVICE_API CommandContext {
+  public:
+    CommandContext();
+    CommandContext(const CommandContext &) = delete;
+    CommandContext &operator=(const CommandContext &) = delete;
+    /**
+     * @brief 初始化，命令经由指定的传输收发；初始化后不使用寄存器影子
+     *
+     * @param transport 传输，需在上下文使用期间保持有效
+     * @param pWriteBuffer 命令写缓冲区
+     * @param writeBufferSize 命令写缓冲区大小
+     * @param pReadBuffer 命令读缓冲区
+     * @param readBufferSize 命令读缓冲区大小
+     */
+    void init(IN Transport *transport, IN uint8_t *pWriteBuffer,
+              IN uint16_t writeBufferSize, IN uint8_t *pReadBuffer,
+              IN uint16_t readBufferSize);
+    /**
+     * @brief 设置寄存器影子
+     * @note 链路检查等需要实际访问控制器的读取应在设置影子之前完成
+     *
+     * @param shadow 寄存器影子，为空时不使用影子，需在上下文使用期间保持有效
+     */
+    void setShadow(IN RegisterShadow *shadow) { shadow_ = shadow; }
+    /**
+     * @brief 获取传输
+     *
+     * @return Transport* 传输，未初始化时为空
+     */
+    Transport *getTransport() const { return transport_; }
+    /**
+     * @brief 获取寄存器影子
+     *
+     * @return RegisterShadow* 寄存器影子，未设置时为空
+     */
+    RegisterShadow *getShadow() const { return shadow_; }
+    /**
+     * @brief 获取命令统计，默认关闭
+     *
+     * @return CommandStats& 命令统计
+     */
+    CommandStats &getStats() { return stats_; }
+    /**
+     * @brief 获取命令库上下文
+     *
+     * @return DLPC_COMMON_Context_s* 命令库上下文
+     */
+    DLPC_COMMON_Context_s *get() { return &context_; }
+
+  private:
+    //命令库上下文
+    DLPC_COMMON_Context_s context_;
+    //传输
+    Transport *transport_;
+    //寄存器影子
+    RegisterShadow *shadow_;
+    //命令统计
+    CommandStats stats_;
+};
+
+/**
+ * @brief 在作用域内为调用线程选择命令库上下文，退出时恢复之前的选择
+ */
+class DEVICE_API CommandContextScope {
+  public:
+    /**
+     * @brief 构造
+     *
+     * @param context 上下文
+     */
+    explicit CommandContextScope(IN CommandContext &context);
+    /**
+     * @brief 构造
+     *
+     * @param context 命令库上下文，为空时选择进程级默认上下文
+     */
+    explicit CommandContextScope(IN DLPC_COMMON_Context_s *context);
+    ~CommandContextScope();
+    CommandContextScope(const CommandContextScope &) = delete;
+    CommandContextScope &operator=(const CommandContextScope &) = delete;
+
+  private:
+    //之前选择的命令库上下文
+    DLPC_COMMON_Context_s *previous_;
+};
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_TRANSPORT_H_
@@ -0,0 +1,144 @@
+/**
+ * @file waiter.h
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __PROJECTOR_WAITER_H_
+#define __PROJECTOR_WAITER_H_
+
+#include "typeDef.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <thread>
+#include <utility>
+
+/** @brief slmaster **/
+namespace slmaster {
+/** @brief 设备库 **/
+namespace device {
+/**
+ * @brief 轮询计划
+ * @note 每次轮询后间隔乘以backoff_，直到maxInterval_；backoff_为1时为固定间隔
+ */
+struct PollSchedule {
+    std::chrono::microseconds initialInterval_; //首次轮询前的间隔
+    std::chrono::microseconds maxInterval_;     //最大轮询间隔
+    double backoff_;                            //间隔增长倍数
+
+    /**
+     * @brief 固定间隔
+     *
+     * @param interval 轮询间隔
+     * @return PollSchedule 轮询计划
+     */
+    static PollSchedule fixed(IN const std::chrono::microseconds interval) {
+        return {interval, interval, 1.0};
+    }
+    /**
+     * @brief 指数退避
+     *
+     * @param initialInterval 首次轮询前的间隔
+     * @param maxInterval 最大轮询间隔
+     * @param backoff 间隔增长倍数
+     * @return PollSchedule 轮询计划
+     */
+    static PollSchedule
+    exponential(IN const std::chrono::microseconds initialInterval,
+                IN const std::chrono::microseconds maxInterval,
+                IN const double backoff = 2.0) {
+        return {initialInterval, maxInterval, backoff};
+    }
+};
+
+/** @brief 等待结果 */
+struct WaitResult {
+    bool isSatisfied_; //条件是否在超时前满足
+    double seconds_;   //等待耗时(s)
+    uint32_t polls_;   //条件检查次数
+};
+
+/**
+ * @brief 按轮询计划检查条件，满足或超时后返回
+ * @note 先立即检查一次，之后在两次检查之间休眠，不占用CPU，也不会连续访问总线；
+ *       最后一次休眠截止到超时时刻，超时时刻还会再检查一次
+ *
+ * @param condition 条件，返回true时结束等待
+ * @param timeout 超时时间
+ * @param schedule 轮询计划
+ * @param sleepUntil 两次检查之间的休眠，参数为唤醒时刻，休眠期间可做其它工作
+ * @return WaitResult 等待结果
+ */
+template <typename Condition, typename Rep, typename Period, typename Sleep>
+WaitResult waitUntil(IN Condition &&condition,
+                     IN const std::chrono::duration<Rep, Period> timeout,
+                     IN const PollSchedule &schedule, IN Sleep &&sleepUntil) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline =
+        start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    timeout);
+
+    WaitResult result{false, 0, 0};
+    std::chrono::microseconds interval =
+        std::max(schedule.initialInterval_, std::chrono::microseconds(1));
+
+    while (true) {
+        ++result.polls_;
+        if (condition()) {
+            result.isSatisfied_ = true;
+            break;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+
+        const auto wake =
+            now +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                interval);
+        sleepUntil(wake < deadline ? wake : deadline);
+
+        interval = std::min(
+            std::chrono::microseconds(
+                (int64_t)(interval.count() * std::max(schedule.backoff_, 1.0))),
+            std::max(schedule.maxInterval_, interval));
+    }
+
+    result.seconds_ = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+    return result;
+}
+
+/**
+ * @brief 按轮询计划检查条件，两次检查之间休眠调用线程
+ *
+ * @param condition 条件，返回true时结束等待
+ * @param timeout 超时时间
+ * @param schedule 轮询计划
+ * @return WaitResult 等待结果
+ */
+template <typename Condition, typename Rep, typename Period>
+WaitResult waitUntil(IN Condition &&condition,
+                     IN const std::chrono::duration<Rep, Period> timeout,
+                     IN const PollSchedule &schedule) {
+    return waitUntil(
+        std::forward<Condition>(condition), timeout, schedule,
+        [](const std::chrono::steady_clock::time_point wake) {
+            std::this_thread::sleep_until(wake);
+        });
+}
+} // namespace device
+} // namespace slmaster
+
+#endif // !__PROJECTOR_WAITER_H_
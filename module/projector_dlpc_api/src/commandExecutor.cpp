@@ -0,0 +1,133 @@
+#include "commandExecutor.h"
+
+#include <algorithm>
+
+namespace slmaster {
+namespace device {
+
+namespace {
+// 调用线程正在执行其命令的执行器
+thread_local const CommandExecutor *t_currentExecutor = nullptr;
+} // namespace
+
+CommandExecutor::CommandExecutor(CommandContext &context)
+    : context_(context), isExecuting_(false), numOfUrgentRuns_(0),
+      isExit_(false) {
+    thread_ = std::thread(&CommandExecutor::run, this);
+}
+
+CommandExecutor::~CommandExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isExit_ = true;
+    }
+    wakeUp_.notify_all();
+    urgentQueued_.notify_all();
+
+    thread_.join();
+}
+
+void CommandExecutor::enqueue(const CommandPriority priority,
+                              std::function<void()> &&task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queues_[(size_t)priority].push_back(std::move(task));
+    }
+    wakeUp_.notify_one();
+
+    if (priority == CommandPriority::Critical) {
+        urgentQueued_.notify_all();
+    }
+}
+
+void CommandExecutor::invoke(const std::function<void()> &task) {
+    const CommandExecutor *previous = t_currentExecutor;
+    t_currentExecutor = this;
+    task();
+    t_currentExecutor = previous;
+}
+
+void CommandExecutor::runUrgent() {
+    runUrgentUntil(std::chrono::steady_clock::time_point());
+}
+
+void CommandExecutor::runUrgentUntil(
+    const std::chrono::steady_clock::time_point deadline) {
+    auto &urgent = queues_[(size_t)CommandPriority::Critical];
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        while (!urgent.empty()) {
+            std::function<void()> task = std::move(urgent.front());
+            urgent.pop_front();
+            ++numOfUrgentRuns_;
+            lock.unlock();
+
+            invoke(task);
+
+            lock.lock();
+        }
+
+        if (isExit_ ||
+            !urgentQueued_.wait_until(lock, deadline, [&] {
+                return !urgent.empty() || isExit_;
+            })) {
+            break;
+        }
+    }
+}
+
+bool CommandExecutor::isInTask() const { return t_currentExecutor == this; }
+
+bool CommandExecutor::isBusy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (isExecuting_) {
+        return true;
+    }
+
+    for (const auto &queue : queues_) {
+        if (!queue.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t CommandExecutor::getNumOfUrgentRuns() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numOfUrgentRuns_;
+}
+
+void CommandExecutor::run() {
+    CommandContextScope scope(context_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        auto queue = std::find_if(queues_.begin(), queues_.end(),
+                                  [](const auto &q) { return !q.empty(); });
+        if (queue == queues_.end()) {
+            // 退出前执行完已提交的命令，等待结果的调用方不会悬空
+            if (isExit_) {
+                break;
+            }
+
+            wakeUp_.wait(lock);
+            continue;
+        }
+
+        std::function<void()> task = std::move(queue->front());
+        queue->pop_front();
+        isExecuting_ = true;
+        lock.unlock();
+
+        invoke(task);
+
+        lock.lock();
+        isExecuting_ = false;
+    }
+}
+
+} // namespace device
+} // namespace slmaster
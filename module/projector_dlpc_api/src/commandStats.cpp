@@ -0,0 +1,248 @@
+#include "commandStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+
+namespace slmaster {
+namespace device {
+
+namespace {
+//小于该值(us)的耗时每微秒一个桶
+constexpr uint64_t kLinearBuckets = 16;
+//每个2的幂区间的桶数为2^kSubBucketBits
+constexpr int kSubBucketBits = 3;
+constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+//最大的2的幂区间，更长的耗时计入最后一个桶
+constexpr int kMaxMagnitude = 31;
+//首个对数区间的幂次，2^4 == kLinearBuckets
+constexpr int kMinMagnitude = 4;
+constexpr size_t kNumOfBuckets =
+    kLinearBuckets + (kMaxMagnitude - kMinMagnitude + 1) * kSubBuckets;
+
+size_t getBucketIndex(const uint64_t microseconds) {
+    if (microseconds < kLinearBuckets) {
+        return (size_t)microseconds;
+    }
+
+    int magnitude = kMinMagnitude;
+    while (magnitude < 63 && (microseconds >> (magnitude + 1)) != 0) {
+        ++magnitude;
+    }
+
+    if (magnitude > kMaxMagnitude) {
+        return kNumOfBuckets - 1;
+    }
+
+    const uint64_t subBucket =
+        (microseconds >> (magnitude - kSubBucketBits)) - kSubBuckets;
+    return (size_t)(kLinearBuckets +
+                    (magnitude - kMinMagnitude) * kSubBuckets + subBucket);
+}
+
+uint64_t getBucketLowerBound(const size_t index) {
+    if (index < kLinearBuckets) {
+        return index;
+    }
+
+    const int magnitude =
+        kMinMagnitude + (int)((index - kLinearBuckets) / kSubBuckets);
+    const uint64_t subBucket =
+        kSubBuckets + (index - kLinearBuckets) % kSubBuckets;
+    return subBucket << (magnitude - kSubBucketBits);
+}
+
+/**
+ * @brief 按直方图估计分位数，取所在桶的上界，不超过最大值
+ */
+uint64_t getPercentile(const uint32_t *buckets, const uint64_t count,
+                       const double percentile, const uint64_t maxValue) {
+    if (count == 0) {
+        return 0;
+    }
+
+    const uint64_t rank =
+        std::max<uint64_t>(1, (uint64_t)(percentile * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumOfBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(getBucketLowerBound(i + 1) - 1, maxValue);
+        }
+    }
+
+    return maxValue;
+}
+
+} // namespace
+
+/** @brief 单个操作码的原子计数 */
+struct CommandStats::OpcodeCounters {
+    std::atomic<uint64_t> writes_;
+    std::atomic<uint64_t> reads_;
+    std::atomic<uint64_t> failures_;
+    std::atomic<uint64_t> retries_;
+    std::atomic<uint64_t> bytesSent_;
+    std::atomic<uint64_t> bytesReceived_;
+    std::atomic<uint64_t> totalMicroseconds_;
+    std::atomic<uint64_t> maxMicroseconds_;
+    std::atomic<uint32_t> buckets_[kNumOfBuckets];
+};
+
+CommandStats::CommandStats()
+    : isEnabled_(false), counters_(new OpcodeCounters[256]) {
+    reset();
+}
+
+CommandStats::~CommandStats() {}
+
+void CommandStats::enable(const bool isEnable) {
+    isEnabled_.store(isEnable, std::memory_order_relaxed);
+}
+
+bool CommandStats::isEnabled() const {
+    return isEnabled_.load(std::memory_order_relaxed);
+}
+
+void CommandStats::reset() {
+    for (int opcode = 0; opcode < 256; ++opcode) {
+        OpcodeCounters &counters = counters_[opcode];
+        counters.writes_.store(0, std::memory_order_relaxed);
+        counters.reads_.store(0, std::memory_order_relaxed);
+        counters.failures_.store(0, std::memory_order_relaxed);
+        counters.retries_.store(0, std::memory_order_relaxed);
+        counters.bytesSent_.store(0, std::memory_order_relaxed);
+        counters.bytesReceived_.store(0, std::memory_order_relaxed);
+        counters.totalMicroseconds_.store(0, std::memory_order_relaxed);
+        counters.maxMicroseconds_.store(0, std::memory_order_relaxed);
+        for (auto &bucket : counters.buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CommandStats::record(const uint8_t opcode, const uint32_t bytesSent,
+                          const uint32_t bytesReceived,
+                          const uint64_t microseconds, const bool isSucess) {
+    OpcodeCounters &counters = counters_[opcode];
+
+    (bytesReceived > 0 ? counters.reads_ : counters.writes_)
+        .fetch_add(1, std::memory_order_relaxed);
+    if (!isSucess) {
+        counters.failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+    counters.bytesSent_.fetch_add(bytesSent, std::memory_order_relaxed);
+    counters.bytesReceived_.fetch_add(bytesReceived,
+                                      std::memory_order_relaxed);
+    counters.totalMicroseconds_.fetch_add(microseconds,
+                                          std::memory_order_relaxed);
+    counters.buckets_[getBucketIndex(microseconds)].fetch_add(
+        1, std::memory_order_relaxed);
+
+    uint64_t maxMicroseconds =
+        counters.maxMicroseconds_.load(std::memory_order_relaxed);
+    while (microseconds > maxMicroseconds &&
+           !counters.maxMicroseconds_.compare_exchange_weak(
+               maxMicroseconds, microseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void CommandStats::recordRetry(const uint8_t opcode) {
+    counters_[opcode].retries_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CommandStats::takeSnapshot(const uint8_t opcode,
+                                CommandOpcodeStats &stats,
+                                uint32_t *buckets) const {
+    const OpcodeCounters &counters = counters_[opcode];
+
+    stats.opcode_ = opcode;
+    stats.writes_ = counters.writes_.load(std::memory_order_relaxed);
+    stats.reads_ = counters.reads_.load(std::memory_order_relaxed);
+    stats.failures_ = counters.failures_.load(std::memory_order_relaxed);
+    stats.retries_ = counters.retries_.load(std::memory_order_relaxed);
+    stats.bytesSent_ = counters.bytesSent_.load(std::memory_order_relaxed);
+    stats.bytesReceived_ =
+        counters.bytesReceived_.load(std::memory_order_relaxed);
+
+    const uint64_t maxMicroseconds =
+        counters.maxMicroseconds_.load(std::memory_order_relaxed);
+    stats.totalSeconds_ =
+        counters.totalMicroseconds_.load(std::memory_order_relaxed) * 1e-6;
+    stats.maxSeconds_ = maxMicroseconds * 1e-6;
+
+    uint64_t count = 0;
+    for (size_t i = 0; i < kNumOfBuckets; ++i) {
+        buckets[i] = counters.buckets_[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    stats.p50Seconds_ =
+        getPercentile(buckets, count, 0.50, maxMicroseconds) * 1e-6;
+    stats.p90Seconds_ =
+        getPercentile(buckets, count, 0.90, maxMicroseconds) * 1e-6;
+    stats.p99Seconds_ =
+        getPercentile(buckets, count, 0.99, maxMicroseconds) * 1e-6;
+
+    return stats.writes_ + stats.reads_ > 0;
+}
+
+bool CommandStats::getStats(const uint8_t opcode,
+                            CommandOpcodeStats &stats) const {
+    uint32_t buckets[kNumOfBuckets];
+    return takeSnapshot(opcode, stats, buckets);
+}
+
+std::string CommandStats::toJson() const {
+    std::ostringstream json;
+    json << "{\"enabled\":" << (isEnabled() ? "true" : "false")
+         << ",\"opcodes\":[";
+
+    bool isFirst = true;
+    for (int opcode = 0; opcode < 256; ++opcode) {
+        CommandOpcodeStats stats;
+        uint32_t buckets[kNumOfBuckets];
+        if (!takeSnapshot((uint8_t)opcode, stats, buckets)) {
+            continue;
+        }
+
+        char name[8];
+        snprintf(name, sizeof(name), "0x%02X", opcode);
+
+        json << (isFirst ? "" : ",") << "{\"opcode\":\"" << name
+             << "\",\"writes\":" << stats.writes_
+             << ",\"reads\":" << stats.reads_
+             << ",\"failures\":" << stats.failures_
+             << ",\"retries\":" << stats.retries_
+             << ",\"bytesSent\":" << stats.bytesSent_
+             << ",\"bytesReceived\":" << stats.bytesReceived_
+             << ",\"totalUs\":" << (uint64_t)(stats.totalSeconds_ * 1e6 + 0.5)
+             << ",\"maxUs\":" << (uint64_t)(stats.maxSeconds_ * 1e6 + 0.5)
+             << ",\"p50Us\":" << (uint64_t)(stats.p50Seconds_ * 1e6 + 0.5)
+             << ",\"p90Us\":" << (uint64_t)(stats.p90Seconds_ * 1e6 + 0.5)
+             << ",\"p99Us\":" << (uint64_t)(stats.p99Seconds_ * 1e6 + 0.5)
+             << ",\"histogram\":[";
+
+        bool isFirstBucket = true;
+        for (size_t i = 0; i < kNumOfBuckets; ++i) {
+            if (buckets[i] == 0) {
+                continue;
+            }
+
+            json << (isFirstBucket ? "" : ",") << "["
+                 << getBucketLowerBound(i) << "," << buckets[i] << "]";
+            isFirstBucket = false;
+        }
+
+        json << "]}";
+        isFirst = false;
+    }
+
+    json << "]}";
+
+    return json.str();
+}
+
+} // namespace device
+} // namespace slmaster
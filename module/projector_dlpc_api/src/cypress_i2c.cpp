@@ -40,28 +40,105 @@
 
 #include "cypress_i2c.h"
 #include "CyUSBSerial.h"
+#include "waiter.h"
 
 #include <chrono>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
 
 #define REQUEST_I2C_ACCESS_GPIO    5
 #define I2C_ACCESS_GRANTED_GPIO    6
 #define START_I2C_TRANSACTION_GPIO 9
 #define I2C_CLOCK_FREQUENCY_HZ     100000
+#define I2C_FALLBACK_ERROR_COUNT   3
 #define DLP_I2C_SLAVE_ADDRESS      (0X36 >> 1)
 #define I2C_TIMEOUT_MILLISECONDS   500   
+#define I2C_ACCESS_POLL_INITIAL_MICROSECONDS 200
+#define I2C_ACCESS_POLL_MAX_MICROSECONDS     10000
 
-static CY_HANDLE          s_Handle;
-static CY_I2C_DATA_CONFIG s_DataConfig;
+/* Fast-mode Plus first; the bridge rejects rates it does not support */
+static const uint32_t     s_ClockFrequencies[] = { 1000000, 400000, I2C_CLOCK_FREQUENCY_HZ };
+static const uint32_t     s_NumClockFrequencies = sizeof(s_ClockFrequencies) / sizeof(s_ClockFrequencies[0]);
 
+/* Device enumeration and opening are not safe to run on several threads at once */
+static std::mutex         s_EnumerationMutex;
 
-/* Gets the handle of the connected Cypress USB-Serial bridge controller */
-bool GetCyI2CHandle(CY_HANDLE* Handle)
+struct CYPRESS_I2C_Device
+{
+    CY_HANDLE          Handle;
+    CY_I2C_DATA_CONFIG DataConfig;
+    uint32_t           ClockFrequencyIdx;
+    uint32_t           ConsecutiveErrors;
+    char               SerialNumber[CY_STRING_DESCRIPTOR_SIZE + 1];
+};
+
+static bool SetClockFrequency(CYPRESS_I2C_Device_s* Device, uint32_t FrequencyIdx)
+{
+    CY_I2C_CONFIG I2CConfig;
+
+    I2CConfig.frequency      = s_ClockFrequencies[FrequencyIdx];
+    I2CConfig.slaveAddress   = 0x30;
+    I2CConfig.isMaster       = true;
+    I2CConfig.isClockStretch = false;
+
+    if (CySetI2cConfig(Device->Handle, &I2CConfig) != CY_SUCCESS)
+    {
+        return false;
+    }
+
+    Device->ClockFrequencyIdx = FrequencyIdx;
+    Device->ConsecutiveErrors = 0;
+    return true;
+}
+
+/* Steps the clock down after repeated NAK/timeout errors on the current rate */
+static void RecordTransferStatus(CYPRESS_I2C_Device_s* Device, bool IsSuccess)
+{
+    if (IsSuccess)
+    {
+        Device->ConsecutiveErrors = 0;
+        return;
+    }
+
+    if (++Device->ConsecutiveErrors >= I2C_FALLBACK_ERROR_COUNT)
+    {
+        Device->ConsecutiveErrors = 0;
+
+        for (uint32_t Idx = Device->ClockFrequencyIdx + 1; Idx < s_NumClockFrequencies; Idx++)
+        {
+            if (SetClockFrequency(Device, Idx))
+            {
+                break;
+            }
+        }
+    }
+}
+
+static void ResetI2C(CYPRESS_I2C_Device_s* Device)
+{
+    CyI2cReset(Device->Handle, false);
+    CyI2cReset(Device->Handle, true);
+}
+
+/*
+ * Finds the selected I2C interface, see CYPRESS_I2C_IsPresent(). Opens it when
+ * Handle is not NULL and then copies the bridge serial number to
+ * OpenedSerialNumber when it is not NULL; without a selection, interfaces that
+ * fail to open (such as those held by another connection) are skipped.
+ */
+static bool FindCyI2CInterface(const char* SerialNumber, int32_t BridgeIndex, CY_HANDLE* Handle,
+                               char* OpenedSerialNumber)
 {
     CY_RETURN_STATUS Status;
     CY_DEVICE_INFO   DeviceInfo;
     uint8_t          NumDevices = 0;
     uint8_t          DeviceIdx;
     uint8_t          InterfaceIdx;
+    int32_t          I2CIdx = 0;
+    bool             IsBySerial = SerialNumber != NULL && SerialNumber[0] != '\0';
+
+    std::lock_guard<std::mutex> Lock(s_EnumerationMutex);
 
     Status = CyGetListofDevices(&NumDevices);
     if ((Status != CY_SUCCESS) || (NumDevices == 0))
@@ -79,13 +156,48 @@ bool GetCyI2CHandle(CY_HANDLE* Handle)
 
         for (InterfaceIdx = 0; InterfaceIdx < DeviceInfo.numInterfaces; InterfaceIdx++)
         {
-            if (DeviceInfo.deviceType[InterfaceIdx] == CY_TYPE_I2C)
+            if (DeviceInfo.deviceType[InterfaceIdx] != CY_TYPE_I2C
+                || DeviceInfo.deviceClass[InterfaceIdx] != CY_CLASS_VENDOR)
+            {
+                continue;
+            }
+
+            bool IsSelected = true;
+            if (IsBySerial)
+            {
+                IsSelected = strncmp((const char*)DeviceInfo.serialNum, SerialNumber,
+                                     CY_STRING_DESCRIPTOR_SIZE) == 0;
+            }
+            else if (BridgeIndex >= 0)
+            {
+                IsSelected = I2CIdx == BridgeIndex;
+            }
+            I2CIdx++;
+
+            if (!IsSelected)
+            {
+                continue;
+            }
+
+            if (Handle == NULL)
+            {
+                return true;
+            }
+
+            if (CyOpen(DeviceIdx, InterfaceIdx, Handle) == CY_SUCCESS)
             {
-                Status = CyOpen(DeviceIdx, InterfaceIdx, Handle);
-                if (Status == CY_SUCCESS)
+                if (OpenedSerialNumber != NULL)
                 {
-                    return true;
+                    memcpy(OpenedSerialNumber, DeviceInfo.serialNum, CY_STRING_DESCRIPTOR_SIZE);
+                    OpenedSerialNumber[CY_STRING_DESCRIPTOR_SIZE] = '\0';
                 }
+                return true;
+            }
+
+            /* An explicitly selected bridge that fails to open is not replaced */
+            if (IsBySerial || BridgeIndex >= 0)
+            {
+                return false;
             }
         }
     }
@@ -94,44 +206,70 @@ bool GetCyI2CHandle(CY_HANDLE* Handle)
 	return false;
 }
 
-bool CYPRESS_I2C_GetCyGpio(uint8_t GpioNum, uint8_t* Value) 
+CYPRESS_I2C_Device_s* CYPRESS_I2C_CreateDevice()
+{
+    CYPRESS_I2C_Device_s* Device = (CYPRESS_I2C_Device_s*)calloc(1, sizeof(CYPRESS_I2C_Device_s));
+    if (Device != NULL)
+    {
+        Device->ClockFrequencyIdx = s_NumClockFrequencies - 1;
+    }
+
+    return Device;
+}
+
+void CYPRESS_I2C_DestroyDevice(CYPRESS_I2C_Device_s* Device)
+{
+    free(Device);
+}
+
+bool CYPRESS_I2C_IsPresent(const char* SerialNumber, int32_t BridgeIndex)
+{
+    return FindCyI2CInterface(SerialNumber, BridgeIndex, NULL, NULL);
+}
+
+const char* CYPRESS_I2C_GetSerialNumber(CYPRESS_I2C_Device_s* Device)
 {
-    return CyGetGpioValue(s_Handle, GpioNum, Value) == CY_SUCCESS;
+    return Device->SerialNumber;
 }
 
-bool CYPRESS_I2C_SetCyGpio(uint8_t GpioNum, uint8_t Value)
+bool CYPRESS_I2C_GetCyGpio(CYPRESS_I2C_Device_s* Device, uint8_t GpioNum, uint8_t* Value) 
 {
-    return CySetGpioValue(s_Handle, GpioNum, Value) == CY_SUCCESS;
+    return CyGetGpioValue(Device->Handle, GpioNum, Value) == CY_SUCCESS;
 }
 
+bool CYPRESS_I2C_SetCyGpio(CYPRESS_I2C_Device_s* Device, uint8_t GpioNum, uint8_t Value)
+{
+    return CySetGpioValue(Device->Handle, GpioNum, Value) == CY_SUCCESS;
+}
 
-bool CYPRESS_I2C_RequestI2CBusAccess()
+
+bool CYPRESS_I2C_RequestI2CBusAccess(CYPRESS_I2C_Device_s* Device)
 {
-    uint8_t Value     = 0;
-    //time_t  StartTime = time(NULL);
-    auto StartTime = std::chrono::steady_clock::now();
-    if (!CYPRESS_I2C_SetCyGpio(REQUEST_I2C_ACCESS_GPIO, 1))
+    uint8_t Value       = 0;
+    bool    IsGpioError = false;
+
+    if (!CYPRESS_I2C_SetCyGpio(Device, REQUEST_I2C_ACCESS_GPIO, 1))
     {
 		//printf("Request I2C Start Error \n");
 		return false;
     }
 
-    while (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - StartTime).count() * (double)std::chrono::milliseconds::period::num / std::chrono::milliseconds::period::den < I2C_TIMEOUT_MILLISECONDS)
-    {
-        if (!CYPRESS_I2C_GetCyGpio(I2C_ACCESS_GRANTED_GPIO, &Value))
-        {
-            break;
-        }
+    /* Each GPIO read is a USB round trip, so back off instead of spinning */
+    const slmaster::device::WaitResult Result = slmaster::device::waitUntil(
+        [&]() {
+            IsGpioError = !CYPRESS_I2C_GetCyGpio(Device, I2C_ACCESS_GRANTED_GPIO, &Value);
+            return IsGpioError || Value == 1;
+        },
+        std::chrono::milliseconds(I2C_TIMEOUT_MILLISECONDS),
+        slmaster::device::PollSchedule::exponential(
+            std::chrono::microseconds(I2C_ACCESS_POLL_INITIAL_MICROSECONDS),
+            std::chrono::microseconds(I2C_ACCESS_POLL_MAX_MICROSECONDS)));
 
-        if (Value == 1)
+    if (Result.isSatisfied_ && !IsGpioError)
+    {
+        if (CYPRESS_I2C_SetCyGpio(Device, START_I2C_TRANSACTION_GPIO, 1))
         {
-            if (!CYPRESS_I2C_SetCyGpio(START_I2C_TRANSACTION_GPIO, 1))
-            {
-                break;
-            }
-
-            CyI2cReset(s_Handle, false);
-            CyI2cReset(s_Handle, true);
+            ResetI2C(Device);
 
             return true;
         }
@@ -141,13 +279,13 @@ bool CYPRESS_I2C_RequestI2CBusAccess()
 	return false;
 }
 
-bool CYPRESS_I2C_RelinquishI2CBusAccess()
+bool CYPRESS_I2C_RelinquishI2CBusAccess(CYPRESS_I2C_Device_s* Device)
 {    
-    return CYPRESS_I2C_SetCyGpio(REQUEST_I2C_ACCESS_GPIO, 0) 
-        && CYPRESS_I2C_SetCyGpio(START_I2C_TRANSACTION_GPIO, 0) && CY_SUCCESS == CyClose(s_Handle);
+    return CYPRESS_I2C_SetCyGpio(Device, REQUEST_I2C_ACCESS_GPIO, 0) 
+        && CYPRESS_I2C_SetCyGpio(Device, START_I2C_TRANSACTION_GPIO, 0) && CY_SUCCESS == CyClose(Device->Handle);
 }
 
-bool CYPRESS_I2C_WriteI2C(uint32_t WriteDataLength, uint8_t* WriteData)
+bool CYPRESS_I2C_WriteI2C(CYPRESS_I2C_Device_s* Device, uint32_t WriteDataLength, uint8_t* WriteData)
 {
     CY_DATA_BUFFER   WriteBuffer;
     CY_RETURN_STATUS Status;
@@ -156,22 +294,23 @@ bool CYPRESS_I2C_WriteI2C(uint32_t WriteDataLength, uint8_t* WriteData)
     WriteBuffer.length        = WriteDataLength;
     WriteBuffer.transferCount = 0;
     
-    Status = CyI2cWrite(s_Handle, 
-                        &s_DataConfig,
+    Status = CyI2cWrite(Device->Handle, 
+                        &Device->DataConfig,
                         &WriteBuffer,
                         I2C_TIMEOUT_MILLISECONDS);
     if (Status != CY_SUCCESS)
     {
 		//printf("Write I2C Error %d!!! \n", Status);
-		CyI2cReset(s_Handle, false);
-        CyI2cReset(s_Handle, true);
+        ResetI2C(Device);
+        RecordTransferStatus(Device, false);
 		return false;
     }
     
+    RecordTransferStatus(Device, true);
     return true;
 }
 
-bool CYPRESS_I2C_ReadI2C(uint32_t ReadDataLength, uint8_t* ReadData)
+bool CYPRESS_I2C_ReadI2C(CYPRESS_I2C_Device_s* Device, uint32_t ReadDataLength, uint8_t* ReadData)
 {
     CY_DATA_BUFFER   ReadBuffer;
     CY_RETURN_STATUS Status;
@@ -180,46 +319,116 @@ bool CYPRESS_I2C_ReadI2C(uint32_t ReadDataLength, uint8_t* ReadData)
     ReadBuffer.length        = ReadDataLength;
     ReadBuffer.transferCount = 0;
 
-    Status = CyI2cRead(s_Handle,
-                       &s_DataConfig,
+    Status = CyI2cRead(Device->Handle,
+                       &Device->DataConfig,
                        &ReadBuffer,
                        I2C_TIMEOUT_MILLISECONDS);
     if ((Status != CY_SUCCESS) && (Status != CY_ERROR_IO_TIMEOUT))
     {
 		//printf("Read I2C Error %d!!! \n", Status);
-        CyI2cReset(s_Handle, false);
-		CyI2cReset(s_Handle, true);
+        ResetI2C(Device);
+        RecordTransferStatus(Device, false);
 		return false;
     }
 
+    RecordTransferStatus(Device, true);
     return true;
 }
 
-bool CYPRESS_I2C_ConnectToCyI2C()
+bool CYPRESS_I2C_WriteReadI2C(CYPRESS_I2C_Device_s* Device,
+                              uint32_t WriteDataLength, uint8_t* WriteData,
+                              uint32_t ReadDataLength, uint8_t* ReadData)
 {
-    CY_RETURN_STATUS Status;	
-    CY_I2C_CONFIG I2CConfig;
-        
-    if (!GetCyI2CHandle(&s_Handle))
+    CY_I2C_DATA_CONFIG DataConfig = Device->DataConfig;
+    CY_DATA_BUFFER     WriteBuffer;
+    CY_DATA_BUFFER     ReadBuffer;
+    CY_RETURN_STATUS   Status;
+
+    WriteBuffer.buffer        = WriteData;
+    WriteBuffer.length        = WriteDataLength;
+    WriteBuffer.transferCount = 0;
+
+    ReadBuffer.buffer         = ReadData;
+    ReadBuffer.length         = ReadDataLength;
+    ReadBuffer.transferCount  = 0;
+
+    /* No stop after the command, the read then starts with a repeated start */
+    DataConfig.isStopBit = false;
+    Status = CyI2cWrite(Device->Handle,
+                        &DataConfig,
+                        &WriteBuffer,
+                        I2C_TIMEOUT_MILLISECONDS);
+    if (Status == CY_SUCCESS)
     {
-        return false;
+        Status = CyI2cRead(Device->Handle,
+                           &Device->DataConfig,
+                           &ReadBuffer,
+                           I2C_TIMEOUT_MILLISECONDS);
+        /* Same as CYPRESS_I2C_ReadI2C(), a read timeout is not an error */
+        if (Status == CY_ERROR_IO_TIMEOUT)
+        {
+            Status = CY_SUCCESS;
+        }
     }
 
-    I2CConfig.frequency      = I2C_CLOCK_FREQUENCY_HZ;
-    I2CConfig.slaveAddress   = 0x30;
-    I2CConfig.isMaster       = true;
-    I2CConfig.isClockStretch = false;
-    
-    Status = CySetI2cConfig(s_Handle, &I2CConfig);
     if (Status != CY_SUCCESS)
     {
-		//printf("Connect to I2C Error %d!!! \n", Status);
+        ResetI2C(Device);
+        RecordTransferStatus(Device, false);
         return false;
     }
 
-    s_DataConfig.isNakBit     = true;
-    s_DataConfig.isStopBit    = true;
-    s_DataConfig.slaveAddress = DLP_I2C_SLAVE_ADDRESS;
+    RecordTransferStatus(Device, true);
+    return true;
+}
+
+bool CYPRESS_I2C_ConnectToCyI2C(CYPRESS_I2C_Device_s* Device,
+                                const char* SerialNumber, int32_t BridgeIndex)
+{
+    if (!FindCyI2CInterface(SerialNumber, BridgeIndex, &Device->Handle, Device->SerialNumber))
+    {
+        return false;
+    }
+
+    /* Connect at the standard rate; CYPRESS_I2C_NegotiateClockFrequency() speeds it up */
+    if (!SetClockFrequency(Device, s_NumClockFrequencies - 1))
+    {
+		//printf("Connect to I2C Error!!! \n");
+        return false;
+    }
+
+    Device->DataConfig.isNakBit     = true;
+    Device->DataConfig.isStopBit    = true;
+    Device->DataConfig.slaveAddress = DLP_I2C_SLAVE_ADDRESS;
 
     return true;
 }
+
+uint32_t CYPRESS_I2C_NegotiateClockFrequency(CYPRESS_I2C_Device_s* Device,
+                                             CYPRESS_I2C_LinkTestCallback LinkTest,
+                                             void* UserData)
+{
+    uint32_t FrequencyIdx;
+
+    for (FrequencyIdx = 0; FrequencyIdx < s_NumClockFrequencies; FrequencyIdx++)
+    {
+        if (!SetClockFrequency(Device, FrequencyIdx))
+        {
+            continue;
+        }
+
+        /* A test that failed often enough to step the clock down does not count */
+        if (LinkTest(UserData) && Device->ClockFrequencyIdx == FrequencyIdx)
+        {
+            return s_ClockFrequencies[FrequencyIdx];
+        }
+    }
+
+    SetClockFrequency(Device, s_NumClockFrequencies - 1);
+    return 0;
+}
+
+uint32_t CYPRESS_I2C_GetClockFrequency(CYPRESS_I2C_Device_s* Device)
+{
+    return s_ClockFrequencies[Device->ClockFrequencyIdx];
+}
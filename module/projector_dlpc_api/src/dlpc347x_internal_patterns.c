@@ -38,6 +38,7 @@
  */
 
 #include "dlpc347x_internal_patterns.h"
+#include "dlpc347x_pattern_packer.h"
 #include "dlpc_common.h"
 #include "math.h"
 #include "stdio.h"
@@ -80,56 +81,42 @@ typedef struct {
   uint32_t Count;
 } PatternSetBlockHeader_s;
 
-typedef struct {
-  DLPC34XX_INT_PAT_DMD_e DMD;
-  uint32_t Width;
-  uint32_t Height;
-  uint8_t MirrorTopOffset;
-  uint8_t MirrorBottomOffset;
-  uint8_t MirrorLeftOffset;
-  uint8_t MirrorRightOffset;
-  bool RequiresDualController;
-} DMDInfo_s;
-
-static DMDInfo_s s_DMDInfo;
-static uint32_t s_PatternSetCount;
-static DLPC34XX_INT_PAT_PatternSet_s *s_PatternSetArray;
-static uint32_t s_PatternOrderTableCount;
-static DLPC34XX_INT_PAT_PatternOrderTableEntry_s *s_PatternOrderTable;
-static DLPC34XX_INT_PAT_WritePatternDataCallback s_WritePatternDataCallback;
-
-uint32_t SetDMDInfo(DLPC34XX_INT_PAT_DMD_e DMD) {
-  s_DMDInfo.DMD = DMD;
+/* Largest packed line of a supported DMD (DLP4710 width) in bytes */
+#define MAX_PACKED_LINE_BYTES 256
+
+uint32_t SetDMDInfo(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                    DLPC34XX_INT_PAT_DMD_e DMD) {
+  Encoder->DMDInfo.DMD = DMD;
 
   switch (DMD) {
   case DLPC34XX_INT_PAT_DMD_DLP2010:
-    s_DMDInfo.Width = DLP2010_WIDTH;
-    s_DMDInfo.Height = DLP2010_HEIGHT;
-    s_DMDInfo.MirrorTopOffset = 32;
-    s_DMDInfo.MirrorBottomOffset = 0;
-    s_DMDInfo.MirrorRightOffset = 10;
-    s_DMDInfo.MirrorLeftOffset = 0;
-    s_DMDInfo.RequiresDualController = false;
+    Encoder->DMDInfo.Width = DLP2010_WIDTH;
+    Encoder->DMDInfo.Height = DLP2010_HEIGHT;
+    Encoder->DMDInfo.MirrorTopOffset = 32;
+    Encoder->DMDInfo.MirrorBottomOffset = 0;
+    Encoder->DMDInfo.MirrorRightOffset = 10;
+    Encoder->DMDInfo.MirrorLeftOffset = 0;
+    Encoder->DMDInfo.RequiresDualController = false;
     break;
 
   case DLPC34XX_INT_PAT_DMD_DLP3010:
-    s_DMDInfo.Width = DLP3010_WIDTH;
-    s_DMDInfo.Height = DLP3010_HEIGHT;
-    s_DMDInfo.MirrorTopOffset = 48;
-    s_DMDInfo.MirrorBottomOffset = 0;
-    s_DMDInfo.MirrorRightOffset = 0;
-    s_DMDInfo.MirrorLeftOffset = 0;
-    s_DMDInfo.RequiresDualController = false;
+    Encoder->DMDInfo.Width = DLP3010_WIDTH;
+    Encoder->DMDInfo.Height = DLP3010_HEIGHT;
+    Encoder->DMDInfo.MirrorTopOffset = 48;
+    Encoder->DMDInfo.MirrorBottomOffset = 0;
+    Encoder->DMDInfo.MirrorRightOffset = 0;
+    Encoder->DMDInfo.MirrorLeftOffset = 0;
+    Encoder->DMDInfo.RequiresDualController = false;
     break;
 
   case DLPC34XX_INT_PAT_DMD_DLP4710:
-    s_DMDInfo.Width = DLP4710_WIDTH;
-    s_DMDInfo.Height = DLP4710_HEIGHT;
-    s_DMDInfo.MirrorTopOffset = 8;
-    s_DMDInfo.MirrorBottomOffset = 0;
-    s_DMDInfo.MirrorRightOffset = 0;
-    s_DMDInfo.MirrorLeftOffset = 0;
-    s_DMDInfo.RequiresDualController = true;
+    Encoder->DMDInfo.Width = DLP4710_WIDTH;
+    Encoder->DMDInfo.Height = DLP4710_HEIGHT;
+    Encoder->DMDInfo.MirrorTopOffset = 8;
+    Encoder->DMDInfo.MirrorBottomOffset = 0;
+    Encoder->DMDInfo.MirrorRightOffset = 0;
+    Encoder->DMDInfo.MirrorLeftOffset = 0;
+    Encoder->DMDInfo.RequiresDualController = true;
     break;
 
   default:
@@ -139,18 +126,67 @@ uint32_t SetDMDInfo(DLPC34XX_INT_PAT_DMD_e DMD) {
   return DLPC_SUCCESS;
 }
 
-void WriteZeroBytes(uint32_t Count) {
-  static uint8_t s_ZeroByte = 0;
-  uint32_t Index;
+void WriteBytes(DLPC34XX_INT_PAT_Encoder_s *Encoder, uint32_t Count,
+                uint8_t *Data) {
+  if (Count > 0) {
+    Encoder->WritePatternDataBlockCallback(Count, Data, Encoder->UserData);
+  }
+}
+
+void WriteZeroBytes(DLPC34XX_INT_PAT_Encoder_s *Encoder, uint32_t Count) {
+  static uint8_t s_ZeroBytes[64] = {0};
+  uint32_t Length;
 
-  for (Index = 0; Index < Count; Index++) {
-    s_WritePatternDataCallback(1, &s_ZeroByte);
+  while (Count > 0) {
+    Length = Count > sizeof(s_ZeroBytes) ? sizeof(s_ZeroBytes) : Count;
+    WriteBytes(Encoder, Length, s_ZeroBytes);
+    Count -= Length;
   }
 }
 
-void WritePixelDataRange(DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
-                         DLPC34XX_INT_PAT_PatternData_s *PatternData,
-                         uint32_t StartPixel, uint32_t EndPixel) {
+/* Flipped pattern lines are described by at most four runs, see
+   GetPixelSegments */
+#define MAX_PIXEL_SEGMENTS 4
+
+uint8_t GetSegmentPixel(DLPC34XX_INT_PAT_PatternData_s *PatternData,
+                        const DLPC34XX_INT_PAT_PixelSegment_s *Segments,
+                        uint32_t SegmentCount, uint32_t Pixel) {
+  uint32_t Seg;
+  int64_t Source;
+
+  for (Seg = 0; Seg < SegmentCount; Seg++) {
+    if (Pixel < Segments[Seg].Count) {
+      Source = Segments[Seg].Reverse ? (int64_t)Segments[Seg].Start - Pixel
+                                     : (int64_t)Segments[Seg].Start + Pixel;
+      if (PatternData->PixelArray && Source >= 0 &&
+          Source < PatternData->PixelArrayCount) {
+        return PatternData->PixelArray[Source];
+      }
+      return 0;
+    }
+    Pixel -= Segments[Seg].Count;
+  }
+
+  return 0;
+}
+
+uint32_t GetSegmentsPixelCount(const DLPC34XX_INT_PAT_PixelSegment_s *Segments,
+                               uint32_t SegmentCount) {
+  uint32_t Count = 0;
+  uint32_t Seg;
+
+  for (Seg = 0; Seg < SegmentCount; Seg++) {
+    Count += Segments[Seg].Count;
+  }
+
+  return Count;
+}
+
+void WritePixelDataRangeBitwise(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                                DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
+                                DLPC34XX_INT_PAT_PatternData_s *PatternData,
+                                const DLPC34XX_INT_PAT_PixelSegment_s *Segments,
+                                uint32_t SegmentCount) {
   uint8_t PixelData;
   uint8_t PatternDataByte;
   uint32_t PatternIndex;
@@ -164,13 +200,16 @@ void WritePixelDataRange(DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
   uint32_t EndBitOffset;
   uint32_t StartOffset;
   uint32_t EndOffset;
+  uint32_t NumPixels = GetSegmentsPixelCount(Segments, SegmentCount);
+  bool Threshold = PatternSet->ThresholdPixels &&
+                   PatternSet->BitDepth == DLPC34XX_INT_PAT_BITDEPTH_ONE;
 
   if (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-    StartOffset = s_DMDInfo.MirrorTopOffset;
-    EndOffset = s_DMDInfo.MirrorBottomOffset;
+    StartOffset = Encoder->DMDInfo.MirrorTopOffset;
+    EndOffset = Encoder->DMDInfo.MirrorBottomOffset;
   } else {
-    StartOffset = s_DMDInfo.MirrorLeftOffset;
-    EndOffset = s_DMDInfo.MirrorRightOffset;
+    StartOffset = Encoder->DMDInfo.MirrorLeftOffset;
+    EndOffset = Encoder->DMDInfo.MirrorRightOffset;
   }
 
   StartByteOffset = StartOffset / 8;
@@ -184,20 +223,22 @@ void WritePixelDataRange(DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
     BitIndex = StartBitOffset;
 
     ByteIndex += StartByteOffset;
-    WriteZeroBytes(StartByteOffset);
+    WriteZeroBytes(Encoder, StartByteOffset);
 
     PatternDataByte = 0;
-    for (Pixel = StartPixel; Pixel < EndPixel; Pixel++) {
-      if (PatternData->PixelArrayCount > Pixel) {
-        PixelData = (uint8_t)((PatternData->PixelArray[Pixel] & BitMask) >>
-                              PatternIndex);
-        PatternDataByte |= (uint8_t)(PixelData << BitIndex);
+    for (Pixel = 0; Pixel < NumPixels; Pixel++) {
+      PixelData = GetSegmentPixel(PatternData, Segments, SegmentCount, Pixel);
+      if (Threshold) {
+        PixelData = (uint8_t)(PixelData >> 7);
+      } else {
+        PixelData = (uint8_t)((PixelData & BitMask) >> PatternIndex);
       }
+      PatternDataByte |= (uint8_t)(PixelData << BitIndex);
 
       BitIndex++;
       if (BitIndex >= 8) {
         ByteIndex++;
-        s_WritePatternDataCallback(1, (uint8_t *)&PatternDataByte);
+        WriteBytes(Encoder, 1, (uint8_t *)&PatternDataByte);
         PatternDataByte = 0;
         BitIndex = 0;
       }
@@ -206,121 +247,326 @@ void WritePixelDataRange(DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
     BitIndex += StartBitOffset;
     if (BitIndex > 0) {
       ByteIndex++;
-      s_WritePatternDataCallback(1, (uint8_t *)&PatternDataByte);
+      WriteBytes(Encoder, 1, (uint8_t *)&PatternDataByte);
     }
 
     ByteIndex += EndByteOffset;
-    WriteZeroBytes(EndByteOffset);
+    WriteZeroBytes(Encoder, EndByteOffset);
 
     // Align to 4-byte word boundary for the next pattern
     if (ByteIndex % 4 != 0) {
       ByteIndex += (4 - (ByteIndex % 4));
-      WriteZeroBytes((4 - (ByteIndex % 4)));
+      WriteZeroBytes(Encoder, (4 - (ByteIndex % 4)));
     }
   }
 }
 
-void WritePatternData(DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
-                      DLPC34XX_INT_PAT_PatternData_s *PatternData,
-                      bool MasterASIC) {
-  uint32_t StartPixel = 0;
-  uint32_t EndPixel;
+void WritePixelDataRange(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                         DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
+                         DLPC34XX_INT_PAT_PatternData_s *PatternData,
+                         const DLPC34XX_INT_PAT_PixelSegment_s *Segments,
+                         uint32_t SegmentCount) {
+  uint8_t PlaneBuffer[DLPC34XX_INT_PAT_BITDEPTH_EIGHT][MAX_PACKED_LINE_BYTES];
+  uint32_t PatternIndex;
+  uint32_t ByteIndex = 0;
+  uint32_t RowLength;
+  uint32_t NumDataBytes;
+  uint32_t StartByteOffset;
+  uint32_t EndByteOffset;
+  uint32_t StartOffset;
+  uint32_t EndOffset;
+
+  if (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
+    StartOffset = Encoder->DMDInfo.MirrorTopOffset;
+    EndOffset = Encoder->DMDInfo.MirrorBottomOffset;
+  } else {
+    StartOffset = Encoder->DMDInfo.MirrorLeftOffset;
+    EndOffset = Encoder->DMDInfo.MirrorRightOffset;
+  }
 
-  if (s_DMDInfo.RequiresDualController) {
+  StartByteOffset = StartOffset / 8;
+  EndByteOffset = EndOffset / 8;
+  NumDataBytes = (GetSegmentsPixelCount(Segments, SegmentCount) + 7) / 8;
+
+  // The packer emits byte-aligned planes, so leave odd layouts to the
+  // bit-by-bit path. The row also needs room for up to 4 bytes of padding.
+  if ((StartOffset % 8) != 0 ||
+      StartByteOffset + NumDataBytes + EndByteOffset + 4 >
+          MAX_PACKED_LINE_BYTES ||
+      (uint32_t)PatternSet->BitDepth > DLPC34XX_INT_PAT_BITDEPTH_EIGHT) {
+    WritePixelDataRangeBitwise(Encoder, PatternSet, PatternData, Segments,
+                               SegmentCount);
+    return;
+  }
+
+  // Split every pixel into its bit planes in one pass over the line. Gray
+  // 1-bit lines are thresholded while packing, without a 0/1 copy.
+  if (PatternSet->ThresholdPixels &&
+      PatternSet->BitDepth == DLPC34XX_INT_PAT_BITDEPTH_ONE) {
+    DLPC34XX_INT_PAT_PackThresholdSegments(
+        PatternData->PixelArray, PatternData->PixelArrayCount, Segments,
+        SegmentCount, &PlaneBuffer[0][StartByteOffset]);
+  } else {
+    DLPC34XX_INT_PAT_PackBitPlanesSegments(
+        PatternData->PixelArray, PatternData->PixelArrayCount, Segments,
+        SegmentCount, (uint32_t)PatternSet->BitDepth,
+        &PlaneBuffer[0][StartByteOffset], MAX_PACKED_LINE_BYTES);
+  }
+
+  // Each plane row is written as one run: mirror offsets, data, padding
+  for (PatternIndex = 0; PatternIndex < (uint32_t)PatternSet->BitDepth;
+       PatternIndex++) {
+    memset(PlaneBuffer[PatternIndex], 0, StartByteOffset);
+    memset(&PlaneBuffer[PatternIndex][StartByteOffset + NumDataBytes], 0,
+           EndByteOffset + 4);
+
+    RowLength = StartByteOffset + NumDataBytes + EndByteOffset;
+    ByteIndex += RowLength;
+
+    // Align to 4-byte word boundary for the next pattern
+    if (ByteIndex % 4 != 0) {
+      ByteIndex += (4 - (ByteIndex % 4));
+      RowLength += (4 - (ByteIndex % 4));
+    }
+
+    WriteBytes(Encoder, RowLength, PlaneBuffer[PatternIndex]);
+  }
+}
+
+/* Appends the part of [Begin, End) that lies in [StartPixel, EndPixel),
+   where output pixel Begin reads source pixel Source */
+void AddPixelSegment(DLPC34XX_INT_PAT_PixelSegment_s *Segments,
+                     uint32_t *SegmentCount, uint32_t Begin, uint32_t End,
+                     uint32_t Source, bool Reverse, uint32_t StartPixel,
+                     uint32_t EndPixel) {
+  DLPC34XX_INT_PAT_PixelSegment_s *Segment;
+
+  if (Begin < StartPixel) {
+    Source = Reverse ? Source - (StartPixel - Begin)
+                     : Source + (StartPixel - Begin);
+    Begin = StartPixel;
+  }
+  if (End > EndPixel) {
+    End = EndPixel;
+  }
+  if (Begin >= End) {
+    return;
+  }
+
+  Segment = &Segments[(*SegmentCount)++];
+  Segment->Count = End - Begin;
+  Segment->Start = Source;
+  Segment->Reverse = Reverse;
+}
+
+/*
+ * Describes the pixels [StartPixel, EndPixel) of a flipped pattern line as
+ * runs over the unmodified pixel array. The flips are the ones the encoder
+ * used to apply in place: the long axis flip reverses the whole line, then
+ * the East/West flip of a dual controller DMD reverses the half of the line
+ * that belongs to the controller. For example, [1,2,3,4,5,6] is read as
+ * [3,2,1,4,5,6] for the master and [1,2,3,6,5,4] for the slave.
+ */
+uint32_t GetPixelSegments(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                          DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
+                          DLPC34XX_INT_PAT_PatternData_s *PatternData,
+                          bool MasterASIC, bool EastWestFlip,
+                          bool LongAxisFlip, uint32_t StartPixel,
+                          uint32_t EndPixel,
+                          DLPC34XX_INT_PAT_PixelSegment_s *Segments) {
+  uint32_t Count = PatternData->PixelArrayCount;
+  uint32_t Half = Count / 2;
+  uint32_t Bounds[4];
+  uint32_t Sources[3];
+  bool Reverses[3];
+  uint32_t NumRuns;
+  uint32_t Run;
+  uint32_t SegmentCount = 0;
+  bool FullReverse = LongAxisFlip;
+  bool HalfReverse = false;
+
+  if (Encoder->DMDInfo.RequiresDualController) {
+    FullReverse = LongAxisFlip ||
+                  PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL;
+    HalfReverse = EastWestFlip ||
+                  PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL;
+  }
+
+  // Runs over the line after the half flip, as indices into the line after
+  // the full flip
+  Bounds[0] = 0;
+  if (!HalfReverse) {
+    NumRuns = 1;
+    Bounds[1] = Count;
+    Sources[0] = 0;
+    Reverses[0] = false;
+  } else if (MasterASIC) {
+    NumRuns = 2;
+    Bounds[1] = Half;
+    Bounds[2] = Count;
+    Sources[0] = Half - 1;
+    Reverses[0] = true;
+    Sources[1] = Half;
+    Reverses[1] = false;
+  } else {
+    NumRuns = 3;
+    Bounds[1] = Half;
+    Bounds[2] = 2 * Half;
+    Bounds[3] = Count;
+    Sources[0] = 0;
+    Reverses[0] = false;
+    Sources[1] = 2 * Half - 1;
+    Reverses[1] = true;
+    Sources[2] = 2 * Half;
+    Reverses[2] = false;
+  }
+
+  for (Run = 0; Run < NumRuns; Run++) {
+    if (Bounds[Run] >= Bounds[Run + 1]) {
+      continue;
+    }
+
+    // Index i of the fully flipped line is pixel Count - 1 - i
+    AddPixelSegment(Segments, &SegmentCount, Bounds[Run], Bounds[Run + 1],
+                    FullReverse ? Count - 1 - Sources[Run] : Sources[Run],
+                    FullReverse ? !Reverses[Run] : Reverses[Run], StartPixel,
+                    EndPixel);
+  }
+
+  // Pixels beyond the array are packed as zeros
+  if (EndPixel > Count) {
+    AddPixelSegment(Segments, &SegmentCount, Count, EndPixel, Count, false,
+                    StartPixel, EndPixel);
+  }
+
+  return SegmentCount;
+}
+
+/* The pixels [StartPixel, EndPixel) of a pattern line that the given
+   controller displays */
+void GetControllerPixelRange(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                             DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
+                             bool MasterASIC, uint32_t *StartPixel,
+                             uint32_t *EndPixel) {
+  *StartPixel = 0;
+
+  if (Encoder->DMDInfo.RequiresDualController) {
     if (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-      EndPixel = s_DMDInfo.Height;
+      *EndPixel = Encoder->DMDInfo.Height;
     } else {
       if (MasterASIC) {
         // Data for master controller (left half)
-        EndPixel = s_DMDInfo.Width / 2;
+        *EndPixel = Encoder->DMDInfo.Width / 2;
 
       } else {
         // Data for slave controller (right half)
-        StartPixel = s_DMDInfo.Width / 2;
-        EndPixel = s_DMDInfo.Width;
+        *StartPixel = Encoder->DMDInfo.Width / 2;
+        *EndPixel = Encoder->DMDInfo.Width;
       }
     }
-    WritePixelDataRange(PatternSet, PatternData, StartPixel, EndPixel);
   } else {
-    EndPixel = (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL)
-                   ? s_DMDInfo.Height
-                   : s_DMDInfo.Width;
-    WritePixelDataRange(PatternSet, PatternData, StartPixel, EndPixel);
+    *EndPixel = (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL)
+                    ? Encoder->DMDInfo.Height
+                    : Encoder->DMDInfo.Width;
   }
 }
 
+void WritePatternData(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                      DLPC34XX_INT_PAT_PatternSet_s *PatternSet,
+                      DLPC34XX_INT_PAT_PatternData_s *PatternData,
+                      bool MasterASIC, bool EastWestFlip, bool LongAxisFlip) {
+  DLPC34XX_INT_PAT_PixelSegment_s Segments[MAX_PIXEL_SEGMENTS];
+  uint32_t SegmentCount;
+  uint32_t StartPixel;
+  uint32_t EndPixel;
+
+  GetControllerPixelRange(Encoder, PatternSet, MasterASIC, &StartPixel,
+                          &EndPixel);
+
+  SegmentCount = GetPixelSegments(Encoder, PatternSet, PatternData,
+                                  MasterASIC, EastWestFlip, LongAxisFlip,
+                                  StartPixel, EndPixel, Segments);
+  WritePixelDataRange(Encoder, PatternSet, PatternData, Segments,
+                      SegmentCount);
+}
+
 uint32_t GetNumOfBytesPerPatternPerController(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder,
     DLPC34XX_INT_PAT_PatternSet_s *PatternSet) {
   uint32_t NumPixels;
   uint32_t NumBytesPerPattern;
   uint32_t Width;
 
   if (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-    NumPixels = s_DMDInfo.Height + s_DMDInfo.MirrorTopOffset +
-                s_DMDInfo.MirrorBottomOffset;
+    NumPixels = Encoder->DMDInfo.Height + Encoder->DMDInfo.MirrorTopOffset +
+                Encoder->DMDInfo.MirrorBottomOffset;
   } else {
-    Width = s_DMDInfo.Width / (s_DMDInfo.RequiresDualController ? 2 : 1);
-    NumPixels =
-        Width + s_DMDInfo.MirrorLeftOffset + s_DMDInfo.MirrorRightOffset;
+    Width = Encoder->DMDInfo.Width /
+            (Encoder->DMDInfo.RequiresDualController ? 2 : 1);
+    NumPixels = Width + Encoder->DMDInfo.MirrorLeftOffset +
+                Encoder->DMDInfo.MirrorRightOffset;
   }
 
   NumBytesPerPattern = (uint32_t)(ceil(NumPixels / 32.0) * 4);
   return NumBytesPerPattern * (uint32_t)PatternSet->BitDepth;
 }
 
-uint32_t GetPatternDataSize(DLPC34XX_INT_PAT_PatternSet_s *PatternSet) {
+uint32_t GetPatternDataSize(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                            DLPC34XX_INT_PAT_PatternSet_s *PatternSet) {
   uint32_t PatternSetsDataSize =
       (PatternSet->PatternCount *
-       GetNumOfBytesPerPatternPerController(PatternSet) *
-       (s_DMDInfo.RequiresDualController ? 2 : 1));
+       GetNumOfBytesPerPatternPerController(Encoder, PatternSet) *
+       (Encoder->DMDInfo.RequiresDualController ? 2 : 1));
   return PatternSetsDataSize;
 }
 
-uint32_t GetPatternSetsSize() {
+uint32_t GetPatternSetsSize(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
   uint32_t PatternSetsDataSize;
   uint32_t PatternSetIdx;
   DLPC34XX_INT_PAT_PatternSet_s *PatternSet;
 
   PatternSetsDataSize =
-      sizeof(PatternSetBlockHeader_s) + (sizeof(uint32_t) * s_PatternSetCount);
+      sizeof(PatternSetBlockHeader_s) +
+      (sizeof(uint32_t) * Encoder->PatternSetCount);
 
-  for (PatternSetIdx = 0; PatternSetIdx < s_PatternSetCount; PatternSetIdx++) {
-    PatternSet = &s_PatternSetArray[PatternSetIdx];
+  for (PatternSetIdx = 0; PatternSetIdx < Encoder->PatternSetCount;
+       PatternSetIdx++) {
+    PatternSet = &Encoder->PatternSetArray[PatternSetIdx];
     PatternSetsDataSize += sizeof(PatternSetHeader_s);
-    PatternSetsDataSize += GetPatternDataSize(PatternSet);
+    PatternSetsDataSize += GetPatternDataSize(Encoder, PatternSet);
   }
 
   return PatternSetsDataSize;
 }
 
-uint32_t GetPatternOrderTableSize() {
+uint32_t GetPatternOrderTableSize(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
   return sizeof(PatternOrderTableHeader_s) +
-         (s_PatternOrderTableCount * sizeof(PatternOrderTableEntry_s));
+         (Encoder->PatternOrderTableCount * sizeof(PatternOrderTableEntry_s));
 }
 
-uint32_t GetPatternSetStart() {
-  return sizeof(PatternBlockHeader_s) + GetPatternOrderTableSize();
+uint32_t GetPatternSetStart(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
+  return sizeof(PatternBlockHeader_s) + GetPatternOrderTableSize(Encoder);
 }
 
-uint32_t GetPatternDataBlockSize() {
-  return sizeof(PatternBlockHeader_s) + GetPatternOrderTableSize() +
-         GetPatternSetsSize();
+uint32_t GetPatternDataBlockSize(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
+  return sizeof(PatternBlockHeader_s) + GetPatternOrderTableSize(Encoder) +
+         GetPatternSetsSize(Encoder);
 }
 
-void WritePatternBlockHeader() {
+void WritePatternBlockHeader(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
   PatternBlockHeader_s Header;
 
   memcpy(Header.Id, "PATN", 4);
 
   Header.PatternOrderTableStart = sizeof(PatternBlockHeader_s);
-  Header.PatternOrderTableSize = GetPatternOrderTableSize();
-  Header.PatternSetsStart = GetPatternSetStart();
-  Header.PatternSetsSize = GetPatternSetsSize();
+  Header.PatternOrderTableSize = GetPatternOrderTableSize(Encoder);
+  Header.PatternSetsStart = GetPatternSetStart(Encoder);
+  Header.PatternSetsSize = GetPatternSetsSize(Encoder);
 
-  s_WritePatternDataCallback(sizeof(Header), (uint8_t *)&Header);
+  WriteBytes(Encoder, sizeof(Header), (uint8_t *)&Header);
 }
 
-void WritePatternOrderTable() {
+void WritePatternOrderTable(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
 
   uint32_t PatternSetIdx;
   PatternOrderTableHeader_s Header;
@@ -328,13 +574,13 @@ void WritePatternOrderTable() {
   DLPC34XX_INT_PAT_PatternOrderTableEntry_s *Input;
 
   // Write pattern order table header
-  Header.Count = s_PatternOrderTableCount;
-  s_WritePatternDataCallback(sizeof(Header), (uint8_t *)&Header);
+  Header.Count = Encoder->PatternOrderTableCount;
+  WriteBytes(Encoder, sizeof(Header), (uint8_t *)&Header);
 
   // Write pattern order table entries
-  for (PatternSetIdx = 0; PatternSetIdx < s_PatternOrderTableCount;
+  for (PatternSetIdx = 0; PatternSetIdx < Encoder->PatternOrderTableCount;
        PatternSetIdx++) {
-    Input = &s_PatternOrderTable[PatternSetIdx];
+    Input = &Encoder->PatternOrderTable[PatternSetIdx];
 
     Entry.PatternSetIndex = Input->PatternSetIndex;
     Entry.NumDisplayPatterns = Input->NumDisplayPatterns;
@@ -349,139 +595,343 @@ void WritePatternOrderTable() {
     Entry.PostIlluminationDarkTimeInMicroseconds =
         Input->PostIlluminationDarkTimeInMicroseconds;
 
-    s_WritePatternDataCallback(sizeof(PatternOrderTableEntry_s),
+    WriteBytes(Encoder, sizeof(PatternOrderTableEntry_s),
                                (uint8_t *)&Entry);
   }
 }
 
-void Reverse(uint8_t *Data, uint32_t Index, uint32_t Length) {
-  int i = Index;
-  int j = Index + Length - 1;
-  if (Data) {
-    while (i < j) {
-      uint8_t Temp = Data[i];
-      Data[i] = Data[j];
-      Data[j] = Temp;
-      i++;
-      j--;
-    }
+uint32_t GetPatternSetDataStart(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                                uint32_t PatternSetIndex) {
+  uint32_t PatternSetDataStart;
+  uint32_t PatternSetIdx;
+
+  PatternSetDataStart = GetPatternSetStart(Encoder) +
+                        sizeof(PatternSetBlockHeader_s) +
+                        (sizeof(uint32_t) * Encoder->PatternSetCount);
+  for (PatternSetIdx = 0; PatternSetIdx < PatternSetIndex; PatternSetIdx++) {
+    PatternSetDataStart += sizeof(PatternSetHeader_s);
+    PatternSetDataStart +=
+        GetPatternDataSize(Encoder, &Encoder->PatternSetArray[PatternSetIdx]);
   }
+
+  return PatternSetDataStart;
 }
 
-void WritePatternSets(bool EastWestFlip, bool LongAxisFlip) {
-  DLPC34XX_INT_PAT_PatternSet_s *PatternSet;
-  DLPC34XX_INT_PAT_PatternData_s *PatternData;
+void WritePatternSetsHeader(DLPC34XX_INT_PAT_Encoder_s *Encoder) {
   PatternSetBlockHeader_s BlockHeader;
-  PatternSetHeader_s SetHeader;
   uint32_t PatternSetIdx;
-  uint32_t PatternIdx;
   uint32_t PatternSetDataStart;
 
-  BlockHeader.Count = s_PatternSetCount;
-  s_WritePatternDataCallback(sizeof(PatternSetBlockHeader_s),
-                             (uint8_t *)&BlockHeader);
+  BlockHeader.Count = Encoder->PatternSetCount;
+  WriteBytes(Encoder, sizeof(PatternSetBlockHeader_s),
+             (uint8_t *)&BlockHeader);
 
   // Write the array of start addresses of the pattern sets
-  PatternSetDataStart = GetPatternSetStart() + sizeof(PatternSetBlockHeader_s) +
-                        (sizeof(uint32_t) * s_PatternSetCount);
-  for (PatternSetIdx = 0; PatternSetIdx < s_PatternSetCount; PatternSetIdx++) {
-    s_WritePatternDataCallback(sizeof(uint32_t),
-                               (uint8_t *)&PatternSetDataStart);
+  for (PatternSetIdx = 0; PatternSetIdx < Encoder->PatternSetCount;
+       PatternSetIdx++) {
+    PatternSetDataStart = GetPatternSetDataStart(Encoder, PatternSetIdx);
+    WriteBytes(Encoder, sizeof(uint32_t), (uint8_t *)&PatternSetDataStart);
+  }
+}
 
-    PatternSet = &s_PatternSetArray[PatternSetIdx];
-    PatternSetDataStart += sizeof(PatternSetHeader_s);
-    PatternSetDataStart += GetPatternDataSize(PatternSet);
+void WritePatternSetHeader(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                           DLPC34XX_INT_PAT_PatternSet_s *PatternSet) {
+  PatternSetHeader_s SetHeader;
+
+  SetHeader.BitDepth = (uint8_t)PatternSet->BitDepth;
+  SetHeader.NumberOfPatterns = PatternSet->PatternCount;
+  SetHeader.PatternDirection = (uint8_t)PatternSet->Direction;
+  SetHeader.Reserved = 0;
+  SetHeader.PatternDataSize = GetPatternDataSize(Encoder, PatternSet);
+  WriteBytes(Encoder, sizeof(PatternSetHeader_s), (uint8_t *)&SetHeader);
+}
+
+/* The pixels of a pattern, from the caller's source when one is set */
+uint32_t GetPatternData(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                        uint32_t PatternSetIdx, uint32_t PatternIdx,
+                        DLPC34XX_INT_PAT_PatternData_s *Fetched,
+                        DLPC34XX_INT_PAT_PatternData_s **PatternData) {
+  DLPC34XX_INT_PAT_PatternSet_s *PatternSet =
+      &Encoder->PatternSetArray[PatternSetIdx];
+
+  if (Encoder->ReadPatternDataCallback == NULL) {
+    *PatternData = &PatternSet->PatternArray[PatternIdx];
+    return DLPC_SUCCESS;
   }
 
-  for (PatternSetIdx = 0; PatternSetIdx < s_PatternSetCount; PatternSetIdx++) {
-    PatternSet = &s_PatternSetArray[PatternSetIdx];
+  *PatternData = Fetched;
+  Fetched->PixelArray = NULL;
+  Fetched->PixelArrayCount = 0;
+  return Encoder->ReadPatternDataCallback(PatternSetIdx, PatternIdx, Fetched,
+                                          Encoder->ReadPatternDataUserData);
+}
+
+uint32_t WritePatternSets(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                          bool EastWestFlip, bool LongAxisFlip) {
+  DLPC34XX_INT_PAT_PatternSet_s *PatternSet;
+  DLPC34XX_INT_PAT_PatternData_s *PatternData;
+  DLPC34XX_INT_PAT_PatternData_s Fetched;
+  uint32_t PatternSetIdx;
+  uint32_t PatternIdx;
+  uint32_t Status;
+
+  WritePatternSetsHeader(Encoder);
+
+  for (PatternSetIdx = 0; PatternSetIdx < Encoder->PatternSetCount;
+       PatternSetIdx++) {
+    PatternSet = &Encoder->PatternSetArray[PatternSetIdx];
 
     // Write pattern set header
-    SetHeader.BitDepth = (uint8_t)PatternSet->BitDepth;
-    SetHeader.NumberOfPatterns = PatternSet->PatternCount;
-    SetHeader.PatternDirection = (uint8_t)PatternSet->Direction;
-    SetHeader.Reserved = 0;
-    SetHeader.PatternDataSize = GetPatternDataSize(PatternSet);
-    s_WritePatternDataCallback(sizeof(PatternSetHeader_s),
-                               (uint8_t *)&SetHeader);
-
-    // Write pattern data
-    if (s_DMDInfo.RequiresDualController) {
-      // Write primary data
+    WritePatternSetHeader(Encoder, PatternSet);
+
+    // Write pattern data. The flips are applied while reading the pixels,
+    // the caller's data is never modified.
+    for (PatternIdx = 0; PatternIdx < PatternSet->PatternCount; PatternIdx++) {
+      Status = GetPatternData(Encoder, PatternSetIdx, PatternIdx, &Fetched,
+                              &PatternData);
+      if (Status != DLPC_SUCCESS) {
+        return Status;
+      }
+      WritePatternData(Encoder, PatternSet, PatternData, true, EastWestFlip,
+                       LongAxisFlip);
+    }
+
+    // A dual controller set continues with the slave halves of all patterns
+    if (Encoder->DMDInfo.RequiresDualController) {
       for (PatternIdx = 0; PatternIdx < PatternSet->PatternCount;
            PatternIdx++) {
-        PatternData = &PatternSet->PatternArray[PatternIdx];
-
-        if (LongAxisFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-          Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount);
+        Status = GetPatternData(Encoder, PatternSetIdx, PatternIdx, &Fetched,
+                                &PatternData);
+        if (Status != DLPC_SUCCESS) {
+          return Status;
         }
+        WritePatternData(Encoder, PatternSet, PatternData, false, EastWestFlip,
+                         LongAxisFlip);
+      }
+    }
+  }
 
-        /* When East/West flipping on a dual controller system, we reverse the
-           primary/secondary halves of the data independently. For example, if
-           the original pattern data was: [1,2,3,4,5,6], it gets written to
-           flash as: [3,2,1,6,5,4]*/
-        if (EastWestFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL) {
-          // Reverse primary/master half of the data
-          // i.e.: [1,2,3,4,5,6] -> [3,2,1,4,5,6]
-          Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount / 2);
-        }
+  return DLPC_SUCCESS;
+}
 
-        WritePatternData(PatternSet, PatternData, true);
+/* Adapts block writes to the legacy callback, which takes at most 255 bytes */
+void WriteLegacyCallback(uint32_t Length, uint8_t *Data, void *UserData) {
+  DLPC34XX_INT_PAT_Encoder_s *Encoder = (DLPC34XX_INT_PAT_Encoder_s *)UserData;
+  uint8_t Count;
 
-        // We don't own this data, so make sure to put it back
-        if (EastWestFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL) {
-          Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount / 2);
-        }
+  while (Length > 0) {
+    Count = Length > UINT8_MAX ? UINT8_MAX : (uint8_t)Length;
+    Encoder->WritePatternDataCallback(Count, Data);
+    Data += Count;
+    Length -= Count;
+  }
+}
 
-        if (LongAxisFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-          Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount);
-        }
-      }
+/* Output cursor of an encoder writing into a caller-owned buffer */
+typedef struct {
+  uint8_t *Data;
+  uint32_t Remaining;
+  bool Overflow;
+} MemoryWriter_s;
 
-      // Write secondary data
-      for (PatternIdx = 0; PatternIdx < PatternSet->PatternCount;
-           PatternIdx++) {
-        PatternData = &PatternSet->PatternArray[PatternIdx];
+void WriteMemoryCallback(uint32_t Length, uint8_t *Data, void *UserData) {
+  MemoryWriter_s *Writer = (MemoryWriter_s *)UserData;
 
-        if (LongAxisFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-          Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount);
-        }
+  if (Writer->Overflow || Length > Writer->Remaining) {
+    Writer->Overflow = true;
+    return;
+  }
 
-        if (EastWestFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL) {
-          // Reverse secondary half of the data
-          // i.e.: [1,2,3,4,5,6] -> [1,2,3,6,5,4]
-          Reverse(PatternData->PixelArray, PatternData->PixelArrayCount / 2,
-                  PatternData->PixelArrayCount / 2);
-        }
+  memcpy(Writer->Data, Data, Length);
+  Writer->Data += Length;
+  Writer->Remaining -= Length;
+}
 
-        WritePatternData(PatternSet, PatternData, false);
+uint32_t DLPC34XX_INT_PAT_InitEncoder(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder, DLPC34XX_INT_PAT_DMD_e DMD,
+    uint32_t PatternSetCount, DLPC34XX_INT_PAT_PatternSet_s *PatternSetArray,
+    uint32_t PatternOrderTableCount,
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s *PatternOrderTable,
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback WritePatternDataBlockCallback,
+    void *UserData) {
+  memset(Encoder, 0, sizeof(DLPC34XX_INT_PAT_Encoder_s));
+
+  Encoder->PatternSetCount = PatternSetCount;
+  Encoder->PatternSetArray = PatternSetArray;
+  Encoder->PatternOrderTableCount = PatternOrderTableCount;
+  Encoder->PatternOrderTable = PatternOrderTable;
+  Encoder->WritePatternDataBlockCallback = WritePatternDataBlockCallback;
+  Encoder->UserData = UserData;
+
+  return SetDMDInfo(Encoder, DMD);
+}
 
-        // We don't own this data, so make sure to put it back
-        if (EastWestFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL) {
-          Reverse(PatternData->PixelArray, PatternData->PixelArrayCount / 2,
-                  PatternData->PixelArrayCount / 2);
-        }
+uint32_t DLPC34XX_INT_PAT_SetPatternDataSource(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder,
+    DLPC34XX_INT_PAT_ReadPatternDataCallback ReadPatternDataCallback,
+    void *UserData) {
+  Encoder->ReadPatternDataCallback = ReadPatternDataCallback;
+  Encoder->ReadPatternDataUserData = UserData;
 
-        if (LongAxisFlip || PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL) {
-          Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount);
-        }
-      }
-    } else // single controller
-    {
-      PatternData = &PatternSet->PatternArray[PatternIdx];
+  return DLPC_SUCCESS;
+}
 
-      if (LongAxisFlip) {
-        Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount);
-      }
+uint32_t DLPC34XX_INT_PAT_EncodePatternDataBlock(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder, bool EastWestFlip,
+    bool LongAxisFlip) {
+  WritePatternBlockHeader(Encoder);
+  WritePatternOrderTable(Encoder);
 
-      WritePatternData(PatternSet, PatternData, true);
+  return WritePatternSets(Encoder, EastWestFlip, LongAxisFlip);
+}
+
+uint32_t DLPC34XX_INT_PAT_GetEncodedBlockSize(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder) {
+  return GetPatternDataBlockSize(Encoder);
+}
+
+uint32_t DLPC34XX_INT_PAT_GetPatternSlotOffset(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder, uint32_t PatternSetIndex,
+    uint32_t PatternIndex, bool MasterASIC) {
+  DLPC34XX_INT_PAT_PatternSet_s *PatternSet =
+      &Encoder->PatternSetArray[PatternSetIndex];
+  uint32_t SlotSize = GetNumOfBytesPerPatternPerController(Encoder, PatternSet);
+  uint32_t Offset = GetPatternSetDataStart(Encoder, PatternSetIndex) +
+                    sizeof(PatternSetHeader_s);
+
+  // Dual controller sets store all master halves before all slave halves
+  if (Encoder->DMDInfo.RequiresDualController && !MasterASIC) {
+    Offset += PatternSet->PatternCount * SlotSize;
+  }
+
+  return Offset + PatternIndex * SlotSize;
+}
+
+uint32_t DLPC34XX_INT_PAT_GetPatternSlotSize(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder, uint32_t PatternSetIndex) {
+  return GetNumOfBytesPerPatternPerController(
+      Encoder, &Encoder->PatternSetArray[PatternSetIndex]);
+}
 
-      // We don't own this data, so make sure to put it back
-      if (LongAxisFlip) {
-        Reverse(PatternData->PixelArray, 0, PatternData->PixelArrayCount);
+uint32_t DLPC34XX_INT_PAT_EncodeBlockLayout(DLPC34XX_INT_PAT_Encoder_s *Encoder,
+                                           uint8_t *Block,
+                                           uint32_t BlockSize) {
+  DLPC34XX_INT_PAT_Encoder_s Layout = *Encoder;
+  MemoryWriter_s Writer;
+  uint32_t PatternSetIdx;
+  uint32_t Offset;
+
+  if (BlockSize < GetPatternDataBlockSize(Encoder)) {
+    return ERR_BUFFER_TOO_SMALL;
+  }
+
+  Writer.Data = Block;
+  Writer.Remaining = BlockSize;
+  Writer.Overflow = false;
+  Layout.WritePatternDataBlockCallback = WriteMemoryCallback;
+  Layout.UserData = &Writer;
+
+  WritePatternBlockHeader(&Layout);
+  WritePatternOrderTable(&Layout);
+  WritePatternSetsHeader(&Layout);
+
+  for (PatternSetIdx = 0; PatternSetIdx < Encoder->PatternSetCount;
+       PatternSetIdx++) {
+    Offset = GetPatternSetDataStart(Encoder, PatternSetIdx);
+    Writer.Data = Block + Offset;
+    Writer.Remaining = BlockSize - Offset;
+    WritePatternSetHeader(&Layout, &Encoder->PatternSetArray[PatternSetIdx]);
+  }
+
+  return Writer.Overflow ? ERR_BUFFER_TOO_SMALL : DLPC_SUCCESS;
+}
+
+uint32_t DLPC34XX_INT_PAT_EncodePatternSlot(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder, uint32_t PatternSetIndex,
+    uint32_t PatternIndex, bool MasterASIC, bool EastWestFlip,
+    bool LongAxisFlip, uint8_t *Slot) {
+  DLPC34XX_INT_PAT_PatternSet_s *PatternSet =
+      &Encoder->PatternSetArray[PatternSetIndex];
+  DLPC34XX_INT_PAT_PatternData_s *PatternData =
+      &PatternSet->PatternArray[PatternIndex];
+  DLPC34XX_INT_PAT_Encoder_s SlotEncoder = *Encoder;
+  MemoryWriter_s Writer;
+  uint32_t SlotSize = GetNumOfBytesPerPatternPerController(Encoder, PatternSet);
+
+  Writer.Data = Slot;
+  Writer.Remaining = SlotSize;
+  Writer.Overflow = false;
+  SlotEncoder.WritePatternDataBlockCallback = WriteMemoryCallback;
+  SlotEncoder.UserData = &Writer;
+
+  WritePatternData(&SlotEncoder, PatternSet, PatternData, MasterASIC,
+                   EastWestFlip, LongAxisFlip);
+
+  // The sequential encoder would have written a different number of bytes
+  // than the layout reserves, so the slot cannot be used as is
+  if (Writer.Overflow || Writer.Remaining != 0) {
+    return ERR_PATTERN_SLOT_MISMATCH;
+  }
+
+  return DLPC_SUCCESS;
+}
+
+uint32_t DLPC34XX_INT_PAT_DecodePatternSlot(
+    DLPC34XX_INT_PAT_Encoder_s *Encoder, uint32_t PatternSetIndex,
+    uint32_t PatternIndex, bool MasterASIC, bool EastWestFlip,
+    bool LongAxisFlip, const uint8_t *Slot, uint8_t *PixelArray) {
+  DLPC34XX_INT_PAT_PatternSet_s *PatternSet =
+      &Encoder->PatternSetArray[PatternSetIndex];
+  DLPC34XX_INT_PAT_PatternData_s *PatternData =
+      &PatternSet->PatternArray[PatternIndex];
+  DLPC34XX_INT_PAT_PixelSegment_s Segments[MAX_PIXEL_SEGMENTS];
+  uint32_t SegmentCount;
+  uint32_t Seg;
+  uint32_t StartPixel;
+  uint32_t EndPixel;
+  uint32_t StartOffset;
+  uint32_t RowSize;
+  uint32_t PatternIdx;
+  uint32_t Pixel = 0;
+  uint32_t Bit;
+  uint32_t Idx;
+  int64_t Source;
+  uint8_t Value;
+
+  GetControllerPixelRange(Encoder, PatternSet, MasterASIC, &StartPixel,
+                          &EndPixel);
+  SegmentCount = GetPixelSegments(Encoder, PatternSet, PatternData,
+                                  MasterASIC, EastWestFlip, LongAxisFlip,
+                                  StartPixel, EndPixel, Segments);
+
+  StartOffset = (PatternSet->Direction == DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL)
+                    ? Encoder->DMDInfo.MirrorTopOffset
+                    : Encoder->DMDInfo.MirrorLeftOffset;
+  RowSize = GetNumOfBytesPerPatternPerController(Encoder, PatternSet) /
+            (uint32_t)PatternSet->BitDepth;
+
+  // Walk the segments in the order the encoder packed them and scatter each
+  // packed pixel back to the position it was read from
+  for (Seg = 0; Seg < SegmentCount; Seg++) {
+    for (Idx = 0; Idx < Segments[Seg].Count; Idx++, Pixel++) {
+      Source = Segments[Seg].Reverse ? (int64_t)Segments[Seg].Start - Idx
+                                     : (int64_t)Segments[Seg].Start + Idx;
+      if (Source < 0 || Source >= PatternData->PixelArrayCount) {
+        continue;
       }
+
+      Bit = StartOffset + Pixel;
+      Value = 0;
+      for (PatternIdx = 0; PatternIdx < (uint32_t)PatternSet->BitDepth;
+           PatternIdx++) {
+        Value |= (uint8_t)(((Slot[PatternIdx * RowSize + Bit / 8] >>
+                             (Bit % 8)) & 1) << PatternIdx);
+      }
+      PixelArray[Source] = Value;
     }
   }
+
+  return DLPC_SUCCESS;
 }
 
 uint32_t DLPC34XX_INT_PAT_GeneratePatternDataBlock(
@@ -491,22 +941,37 @@ uint32_t DLPC34XX_INT_PAT_GeneratePatternDataBlock(
     DLPC34XX_INT_PAT_PatternOrderTableEntry_s *PatternOrderTable,
     DLPC34XX_INT_PAT_WritePatternDataCallback WritePatternDataCallback,
     bool EastWestFlip, bool LongAxisFlip) {
-  uint32_t Status = SetDMDInfo(DMD);
+  DLPC34XX_INT_PAT_Encoder_s Encoder;
+  uint32_t Status = DLPC34XX_INT_PAT_InitEncoder(
+      &Encoder, DMD, PatternSetCount, PatternSetArray, PatternOrderTableCount,
+      PatternOrderTable, WriteLegacyCallback, &Encoder);
   if (Status != DLPC_SUCCESS) {
     return Status;
   }
 
-  s_PatternSetCount = PatternSetCount;
-  s_PatternSetArray = PatternSetArray;
-  s_PatternOrderTableCount = PatternOrderTableCount;
-  s_PatternOrderTable = PatternOrderTable;
-  s_WritePatternDataCallback = WritePatternDataCallback;
+  Encoder.WritePatternDataCallback = WritePatternDataCallback;
+
+  return DLPC34XX_INT_PAT_EncodePatternDataBlock(&Encoder, EastWestFlip,
+                                                 LongAxisFlip);
+}
 
-  WritePatternBlockHeader();
-  WritePatternOrderTable();
-  WritePatternSets(EastWestFlip, LongAxisFlip);
+uint32_t DLPC34XX_INT_PAT_GeneratePatternDataBlockEx(
+    DLPC34XX_INT_PAT_DMD_e DMD, uint32_t PatternSetCount,
+    DLPC34XX_INT_PAT_PatternSet_s *PatternSetArray,
+    uint32_t PatternOrderTableCount,
+    DLPC34XX_INT_PAT_PatternOrderTableEntry_s *PatternOrderTable,
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback WritePatternDataBlockCallback,
+    void *UserData, bool EastWestFlip, bool LongAxisFlip) {
+  DLPC34XX_INT_PAT_Encoder_s Encoder;
+  uint32_t Status = DLPC34XX_INT_PAT_InitEncoder(
+      &Encoder, DMD, PatternSetCount, PatternSetArray, PatternOrderTableCount,
+      PatternOrderTable, WritePatternDataBlockCallback, UserData);
+  if (Status != DLPC_SUCCESS) {
+    return Status;
+  }
 
-  return DLPC_SUCCESS;
+  return DLPC34XX_INT_PAT_EncodePatternDataBlock(&Encoder, EastWestFlip,
+                                                 LongAxisFlip);
 }
 
 uint32_t DLPC34XX_INT_PAT_GetPatternDataBlockSize(
@@ -514,15 +979,13 @@ uint32_t DLPC34XX_INT_PAT_GetPatternDataBlockSize(
     DLPC34XX_INT_PAT_PatternSet_s *PatternSetArray,
     uint32_t PatternOrderTableCount,
     DLPC34XX_INT_PAT_PatternOrderTableEntry_s *PatternOrderTable) {
-  uint32_t Status = SetDMDInfo(DMD);
+  DLPC34XX_INT_PAT_Encoder_s Encoder;
+  uint32_t Status = DLPC34XX_INT_PAT_InitEncoder(
+      &Encoder, DMD, PatternSetCount, PatternSetArray, PatternOrderTableCount,
+      PatternOrderTable, NULL, NULL);
   if (Status != DLPC_SUCCESS) {
     return UINT32_MAX;
   }
 
-  s_PatternSetCount = PatternSetCount;
-  s_PatternSetArray = PatternSetArray;
-  s_PatternOrderTableCount = PatternOrderTableCount;
-  s_PatternOrderTable = PatternOrderTable;
-
-  return GetPatternDataBlockSize();
-}
\ No newline at end of file
+  return GetPatternDataBlockSize(&Encoder);
+}
@@ -0,0 +1,335 @@
+/**
+ * @file dlpc347x_pattern_packer.c
+ * @author Evans Liu (1369215984@qq.com)
+ * @brief  Bit-plane packer used by the 347x internal pattern encoder.
+ * @version 0.1
+ * @date 2024-03-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "dlpc347x_pattern_packer.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PACKER_USE_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PACKER_USE_SSE2
+#endif
+
+#define PACKER_MAX_BIT_DEPTH 8
+
+void DLPC34XX_INT_PAT_PackBitPlanesScalar(const uint8_t* PixelArray,
+                                          uint32_t       PixelArrayCount,
+                                          uint32_t       StartPixel,
+                                          uint32_t       EndPixel,
+                                          uint32_t       BitDepth,
+                                          uint8_t*       PlaneArray,
+                                          uint32_t       PlaneStride) {
+  uint8_t PlaneBytes[PACKER_MAX_BIT_DEPTH];
+  uint32_t NumBytes = (EndPixel - StartPixel + 7) / 8;
+  uint32_t ByteIdx;
+  uint32_t BitIdx;
+  uint32_t Plane;
+  uint32_t Pixel;
+  uint8_t PixelData;
+
+  for (ByteIdx = 0; ByteIdx < NumBytes; ByteIdx++) {
+    for (Plane = 0; Plane < BitDepth; Plane++) {
+      PlaneBytes[Plane] = 0;
+    }
+
+    for (BitIdx = 0; BitIdx < 8; BitIdx++) {
+      Pixel = StartPixel + ByteIdx * 8 + BitIdx;
+      if (Pixel >= EndPixel) {
+        break;
+      }
+      if (Pixel >= PixelArrayCount) {
+        continue;
+      }
+
+      PixelData = PixelArray[Pixel];
+      for (Plane = 0; Plane < BitDepth; Plane++) {
+        PlaneBytes[Plane] |= (uint8_t)(((PixelData >> Plane) & 1) << BitIdx);
+      }
+    }
+
+    for (Plane = 0; Plane < BitDepth; Plane++) {
+      PlaneArray[Plane * PlaneStride + ByteIdx] = PlaneBytes[Plane];
+    }
+  }
+}
+
+/*
+ * Packs the sign bits of 8 consecutive pixels into one byte: the masked sign
+ * bits are moved to bit 0 of their byte and the multiply gathers byte i into
+ * bit i of the top byte. Used for thresholded 1-bit lines without SSE2.
+ */
+static uint8_t PackSignBits8(const uint8_t* Pixels) {
+  uint64_t Data = 0;
+  uint32_t Idx;
+
+  for (Idx = 0; Idx < 8; Idx++) {
+    Data |= (uint64_t)Pixels[Idx] << (8 * Idx);
+  }
+
+  Data = (Data & 0x8080808080808080ULL) >> 7;
+  return (uint8_t)((Data * 0x0102040810204080ULL) >> 56);
+}
+
+/*
+ * Writes the low NumBytes bytes of Mask to every plane at ByteIdx. Bit i of
+ * the mask belongs to the i-th pixel of the group, so storing it little
+ * endian gives the flash layout directly.
+ */
+static void StorePlaneMask(uint8_t* PlaneArray, uint32_t PlaneStride,
+                           uint32_t Plane, uint32_t ByteIdx, uint32_t Mask,
+                           uint32_t NumBytes) {
+  uint8_t* Out = &PlaneArray[Plane * PlaneStride + ByteIdx];
+  uint32_t Idx;
+
+  for (Idx = 0; Idx < NumBytes; Idx++) {
+    Out[Idx] = (uint8_t)(Mask >> (8 * Idx));
+  }
+}
+
+/*
+ * The vector paths move bit (BitDepth - 1) of every pixel into the sign bit
+ * with (8 - BitDepth) byte-wise doublings, then peel one plane per movemask,
+ * doubling again between planes. Adding a byte to itself never carries into
+ * the neighbouring byte, so no per-plane shift masks are needed. A
+ * thresholded 1-bit line already has its bit in the sign bit, so it is packed
+ * with a single movemask.
+ *
+ * Reversed runs are loaded forward and byte-reversed in the register, so a
+ * flipped line costs one extra shuffle per vector instead of a pass over the
+ * source.
+ */
+#if defined(PACKER_USE_AVX2)
+#define PACKER_LANES 32
+
+static __m256i LoadForward(const uint8_t* Pixels) {
+  return _mm256_loadu_si256((const __m256i*)Pixels);
+}
+
+/* Loads Pixels[0], Pixels[-1], ..., Pixels[-31] */
+static __m256i LoadReverse(const uint8_t* Pixels) {
+  const __m256i Index = _mm256_setr_epi8(
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  __m256i Data = _mm256_loadu_si256((const __m256i*)(Pixels - 31));
+
+  Data = _mm256_shuffle_epi8(Data, Index);
+  return _mm256_permute2x128_si256(Data, Data, 1);
+}
+
+static void PackVector(__m256i Data, uint32_t BitDepth, bool Threshold,
+                       uint8_t* PlaneArray, uint32_t PlaneStride,
+                       uint32_t ByteIdx, uint32_t NumBytes) {
+  uint32_t Shift;
+  int32_t Plane;
+
+  for (Shift = Threshold ? 8 : BitDepth; Shift < 8; Shift++) {
+    Data = _mm256_add_epi8(Data, Data);
+  }
+
+  for (Plane = (int32_t)BitDepth - 1; Plane >= 0; Plane--) {
+    StorePlaneMask(PlaneArray, PlaneStride, (uint32_t)Plane, ByteIdx,
+                   (uint32_t)_mm256_movemask_epi8(Data), NumBytes);
+    Data = _mm256_add_epi8(Data, Data);
+  }
+}
+#elif defined(PACKER_USE_SSE2)
+#define PACKER_LANES 16
+
+static __m128i LoadForward(const uint8_t* Pixels) {
+  return _mm_loadu_si128((const __m128i*)Pixels);
+}
+
+/* Loads Pixels[0], Pixels[-1], ..., Pixels[-15] using SSE2 only */
+static __m128i LoadReverse(const uint8_t* Pixels) {
+  __m128i Data = _mm_loadu_si128((const __m128i*)(Pixels - 15));
+
+  Data = _mm_shuffle_epi32(Data, _MM_SHUFFLE(0, 1, 2, 3));
+  Data = _mm_shufflelo_epi16(Data, _MM_SHUFFLE(2, 3, 0, 1));
+  Data = _mm_shufflehi_epi16(Data, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm_or_si128(_mm_slli_epi16(Data, 8), _mm_srli_epi16(Data, 8));
+}
+
+static void PackVector(__m128i Data, uint32_t BitDepth, bool Threshold,
+                       uint8_t* PlaneArray, uint32_t PlaneStride,
+                       uint32_t ByteIdx, uint32_t NumBytes) {
+  uint32_t Shift;
+  int32_t Plane;
+
+  for (Shift = Threshold ? 8 : BitDepth; Shift < 8; Shift++) {
+    Data = _mm_add_epi8(Data, Data);
+  }
+
+  for (Plane = (int32_t)BitDepth - 1; Plane >= 0; Plane--) {
+    StorePlaneMask(PlaneArray, PlaneStride, (uint32_t)Plane, ByteIdx,
+                   (uint32_t)_mm_movemask_epi8(Data), NumBytes);
+    Data = _mm_add_epi8(Data, Data);
+  }
+}
+#else
+#define PACKER_LANES 8
+#endif
+
+/* Packs PACKER_LANES contiguous pixels, of which the first NumBytes * 8 are
+   stored */
+static void PackLanes(const uint8_t* Pixels, uint32_t BitDepth,
+                      bool Threshold, uint8_t* PlaneArray,
+                      uint32_t PlaneStride, uint32_t ByteIdx,
+                      uint32_t NumBytes) {
+#if defined(PACKER_USE_AVX2) || defined(PACKER_USE_SSE2)
+  PackVector(LoadForward(Pixels), BitDepth, Threshold, PlaneArray,
+             PlaneStride, ByteIdx, NumBytes);
+#else
+  if (Threshold) {
+    PlaneArray[ByteIdx] = PackSignBits8(Pixels);
+    return;
+  }
+
+  DLPC34XX_INT_PAT_PackBitPlanesScalar(Pixels, PACKER_LANES, 0,
+                                       NumBytes * 8, BitDepth,
+                                       PlaneArray + ByteIdx, PlaneStride);
+#endif
+}
+
+/* Copies Count output pixels starting Offset pixels into Segments[0] */
+static void GatherPixels(const uint8_t* PixelArray, uint32_t PixelArrayCount,
+                         const DLPC34XX_INT_PAT_PixelSegment_s* Segments,
+                         uint32_t SegmentCount, uint32_t Offset,
+                         uint32_t Count, uint8_t* Pixels) {
+  uint32_t Seg = 0;
+  uint32_t Idx;
+  int64_t Source;
+
+  for (Idx = 0; Idx < Count; Idx++, Offset++) {
+    while (Seg < SegmentCount && Offset >= Segments[Seg].Count) {
+      Offset -= Segments[Seg].Count;
+      Seg++;
+    }
+    if (Seg >= SegmentCount) {
+      Pixels[Idx] = 0;
+      continue;
+    }
+
+    Source = Segments[Seg].Reverse
+                 ? (int64_t)Segments[Seg].Start - Offset
+                 : (int64_t)Segments[Seg].Start + Offset;
+    Pixels[Idx] = (PixelArray && Source >= 0 && Source < PixelArrayCount)
+                      ? PixelArray[Source]
+                      : 0;
+  }
+}
+
+static void PackSegments(const uint8_t* PixelArray, uint32_t PixelArrayCount,
+                         const DLPC34XX_INT_PAT_PixelSegment_s* Segments,
+                         uint32_t SegmentCount, uint32_t BitDepth,
+                         bool Threshold, uint8_t* PlaneArray,
+                         uint32_t PlaneStride) {
+  uint8_t Gathered[PACKER_LANES];
+  uint32_t Total = 0;
+  uint32_t Seg = 0;
+  uint32_t SegStart = 0;
+  uint32_t Pixel;
+  uint32_t Count;
+  uint32_t Offset;
+  int64_t Low;
+  int64_t High;
+
+  for (Seg = 0; Seg < SegmentCount; Seg++) {
+    Total += Segments[Seg].Count;
+  }
+
+  Seg = 0;
+  for (Pixel = 0; Pixel < Total; Pixel += PACKER_LANES) {
+    Count = Total - Pixel < PACKER_LANES ? Total - Pixel : PACKER_LANES;
+    while (Pixel >= SegStart + Segments[Seg].Count) {
+      SegStart += Segments[Seg].Count;
+      Seg++;
+    }
+    Offset = Pixel - SegStart;
+
+#if defined(PACKER_USE_AVX2) || defined(PACKER_USE_SSE2)
+    // Full vectors inside one run and inside the source are loaded directly
+    if (PixelArray && Count == PACKER_LANES &&
+        Offset + PACKER_LANES <= Segments[Seg].Count) {
+      if (Segments[Seg].Reverse) {
+        High = (int64_t)Segments[Seg].Start - Offset;
+        Low = High - (PACKER_LANES - 1);
+      } else {
+        Low = (int64_t)Segments[Seg].Start + Offset;
+        High = Low + (PACKER_LANES - 1);
+      }
+
+      if (Low >= 0 && High < PixelArrayCount) {
+        PackVector(Segments[Seg].Reverse ? LoadReverse(PixelArray + High)
+                                         : LoadForward(PixelArray + Low),
+                   BitDepth, Threshold, PlaneArray, PlaneStride, Pixel / 8,
+                   PACKER_LANES / 8);
+        continue;
+      }
+    }
+#endif
+
+    // Run boundaries, missing source pixels and the tail go through a copy
+    GatherPixels(PixelArray, PixelArrayCount, &Segments[Seg],
+                 SegmentCount - Seg, Offset, Count, Gathered);
+    for (Offset = Count; Offset < PACKER_LANES; Offset++) {
+      Gathered[Offset] = 0;
+    }
+    PackLanes(Gathered, BitDepth, Threshold, PlaneArray, PlaneStride,
+              Pixel / 8, (Count + 7) / 8);
+  }
+}
+
+void DLPC34XX_INT_PAT_PackBitPlanesSegments(
+    const uint8_t* PixelArray, uint32_t PixelArrayCount,
+    const DLPC34XX_INT_PAT_PixelSegment_s* Segments, uint32_t SegmentCount,
+    uint32_t BitDepth, uint8_t* PlaneArray, uint32_t PlaneStride) {
+  PackSegments(PixelArray, PixelArrayCount, Segments, SegmentCount, BitDepth,
+               false, PlaneArray, PlaneStride);
+}
+
+void DLPC34XX_INT_PAT_PackThresholdSegments(
+    const uint8_t* PixelArray, uint32_t PixelArrayCount,
+    const DLPC34XX_INT_PAT_PixelSegment_s* Segments, uint32_t SegmentCount,
+    uint8_t* PlaneArray) {
+  PackSegments(PixelArray, PixelArrayCount, Segments, SegmentCount, 1, true,
+               PlaneArray, 0);
+}
+
+void DLPC34XX_INT_PAT_PackBitPlanes(const uint8_t* PixelArray,
+                                    uint32_t       PixelArrayCount,
+                                    uint32_t       StartPixel,
+                                    uint32_t       EndPixel,
+                                    uint32_t       BitDepth,
+                                    uint8_t*       PlaneArray,
+                                    uint32_t       PlaneStride) {
+  DLPC34XX_INT_PAT_PixelSegment_s Segment;
+
+  Segment.Count = EndPixel - StartPixel;
+  Segment.Start = StartPixel;
+  Segment.Reverse = false;
+
+  DLPC34XX_INT_PAT_PackBitPlanesSegments(PixelArray, PixelArrayCount, &Segment,
+                                         1, BitDepth, PlaneArray, PlaneStride);
+}
+
+const char* DLPC34XX_INT_PAT_GetPackerName() {
+#if defined(PACKER_USE_AVX2)
+  return "AVX2";
+#elif defined(PACKER_USE_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
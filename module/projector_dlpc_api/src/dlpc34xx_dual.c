@@ -46,8 +46,6 @@
 #include "dlpc34xx_dual.h"
 #include "dlpc_common_private.h"
 
-static uint32_t s_Index;
-
 uint32_t DLPC34XX_DUAL_WriteOperatingModeSelect(DLPC34XX_DUAL_OperatingMode_e OperatingMode)
 {
     uint32_t Status = 0;
@@ -1369,6 +1367,7 @@ uint32_t DLPC34XX_DUAL_WriteFlashStart(uint16_t DataLength, uint8_t* Data)
 uint32_t DLPC34XX_DUAL_ReadFlashStart(uint16_t Length, uint8_t *Data)
 {
     uint32_t Status = 0;
+    uint32_t Index;
 
     DLPC_COMMON_ClearWriteBuffer();
     DLPC_COMMON_ClearReadBuffer();
@@ -1380,9 +1379,9 @@ uint32_t DLPC34XX_DUAL_ReadFlashStart(uint16_t Length, uint8_t *Data)
     Status = DLPC_COMMON_SendRead(Length);
     if (Status == 0)
     {
-        for (s_Index = 0; s_Index < Length; s_Index++)
+        for (Index = 0; Index < Length; Index++)
         {
-            Data[s_Index] = *(DLPC_COMMON_UnpackBytes(1));
+            Data[Index] = *(DLPC_COMMON_UnpackBytes(1));
         }
     }
     return Status;
@@ -1405,6 +1404,7 @@ uint32_t DLPC34XX_DUAL_WriteFlashContinue(uint16_t DataLength, uint8_t* Data)
 uint32_t DLPC34XX_DUAL_ReadFlashContinue(uint16_t Length, uint8_t *Data)
 {
     uint32_t Status = 0;
+    uint32_t Index;
 
     DLPC_COMMON_ClearWriteBuffer();
     DLPC_COMMON_ClearReadBuffer();
@@ -1416,9 +1416,9 @@ uint32_t DLPC34XX_DUAL_ReadFlashContinue(uint16_t Length, uint8_t *Data)
     Status = DLPC_COMMON_SendRead(Length);
     if (Status == 0)
     {
-        for (s_Index = 0; s_Index < Length; s_Index++)
+        for (Index = 0; Index < Length; Index++)
         {
-            Data[s_Index] = *(DLPC_COMMON_UnpackBytes(1));
+            Data[Index] = *(DLPC_COMMON_UnpackBytes(1));
         }
     }
     return Status;
@@ -40,15 +40,20 @@
 #include "stdbool.h"
 #include "string.h"
 
-static uint8_t*                          s_WriteBuffer;
-static uint16_t                          s_WriteBufferSize;
-static uint16_t                          s_WriteBufferIndex;
-static uint8_t*                          s_ReadBuffer;
-static uint16_t                          s_ReadBufferSize;
-static uint16_t                          s_ReadBufferIndex;
-static DLPC_COMMON_WriteCommandCallback  s_WriteCommandCallback;
-static DLPC_COMMON_ReadCommandCallback   s_ReadCommandCallback;
-static DLPC_COMMON_CommandProtocolData_s s_ProtocolData;
+#if defined(_MSC_VER)
+#define DLPC_COMMON_THREAD_LOCAL __declspec(thread)
+#else
+#define DLPC_COMMON_THREAD_LOCAL _Thread_local
+#endif
+
+static DLPC_COMMON_Context_s                           s_DefaultContext;
+static DLPC_COMMON_THREAD_LOCAL DLPC_COMMON_Context_s* s_SelectedContext;
+
+/* The context selected on the calling thread, or the default context */
+static DLPC_COMMON_Context_s* GetContext()
+{
+    return s_SelectedContext != NULL ? s_SelectedContext : &s_DefaultContext;
+}
 
 void DLPC_COMMON_InitCommandLibrary(
     uint8_t*                         WriteBuffer,
@@ -58,38 +63,87 @@ void DLPC_COMMON_InitCommandLibrary(
     DLPC_COMMON_WriteCommandCallback WriteCommandCallback,
     DLPC_COMMON_ReadCommandCallback  ReadCommandCallback)
 {
-    s_WriteBuffer          = WriteBuffer;
-    s_WriteBufferSize      = WriteBufferSize;
-    s_ReadBuffer           = ReadBuffer;
-    s_ReadBufferSize       = ReadBufferSize;
-    s_WriteCommandCallback = WriteCommandCallback;
-    s_ReadCommandCallback  = ReadCommandCallback;
+    DLPC_COMMON_InitContext(&s_DefaultContext,
+                            WriteBuffer,
+                            WriteBufferSize,
+                            ReadBuffer,
+                            ReadBufferSize,
+                            WriteCommandCallback,
+                            ReadCommandCallback,
+                            NULL);
+}
+
+void DLPC_COMMON_InitContext(
+    DLPC_COMMON_Context_s*           Context,
+    uint8_t*                         WriteBuffer,
+    uint16_t                         WriteBufferSize,
+    uint8_t*                         ReadBuffer,
+    uint16_t                         ReadBufferSize,
+    DLPC_COMMON_WriteCommandCallback WriteCommandCallback,
+    DLPC_COMMON_ReadCommandCallback  ReadCommandCallback,
+    void*                            UserData)
+{
+    memset(Context, 0, sizeof(*Context));
+    Context->WriteBuffer          = WriteBuffer;
+    Context->WriteBufferSize      = WriteBufferSize;
+    Context->ReadBuffer           = ReadBuffer;
+    Context->ReadBufferSize       = ReadBufferSize;
+    Context->WriteCommandCallback = WriteCommandCallback;
+    Context->ReadCommandCallback  = ReadCommandCallback;
+    Context->UserData             = UserData;
+}
+
+DLPC_COMMON_Context_s* DLPC_COMMON_SelectContext(DLPC_COMMON_Context_s* Context)
+{
+    DLPC_COMMON_Context_s* Previous = s_SelectedContext;
+    s_SelectedContext = Context;
+    return Previous;
+}
+
+DLPC_COMMON_Context_s* DLPC_COMMON_GetSelectedContext()
+{
+    return s_SelectedContext;
+}
+
+void* DLPC_COMMON_GetUserData()
+{
+    return GetContext()->UserData;
 }
 
 uint32_t DLPC_COMMON_SendWrite()
 {
-    return s_WriteCommandCallback(s_WriteBufferIndex, s_WriteBuffer, &s_ProtocolData);
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    return Context->WriteCommandCallback(Context->WriteBufferIndex,
+                                         Context->WriteBuffer,
+                                         &Context->ProtocolData);
 }
 
 uint32_t DLPC_COMMON_SendRead(uint16_t ReadLength)
 {
-    return s_ReadCommandCallback(s_WriteBufferIndex,
-                                 s_WriteBuffer,
-                                 ReadLength,
-                                 s_ReadBuffer,
-                                 &s_ProtocolData);
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    return Context->ReadCommandCallback(Context->WriteBufferIndex,
+                                        Context->WriteBuffer,
+                                        ReadLength,
+                                        Context->ReadBuffer,
+                                        &Context->ProtocolData);
 }
 
 void DLPC_COMMON_ClearWriteBuffer()
 {
-    memset(s_WriteBuffer, 0, s_WriteBufferSize);
-    s_WriteBufferIndex = 0;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    memset(Context->WriteBuffer, 0, Context->WriteBufferSize);
+    Context->WriteBufferIndex = 0;
 }
 
 void DLPC_COMMON_ClearReadBuffer()
 {
-    memset(s_ReadBuffer, 0, s_ReadBufferSize);
-    s_ReadBufferIndex = 0;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    memset(Context->ReadBuffer, 0, Context->ReadBufferSize);
+    Context->ReadBufferIndex = 0;
 }
 
 int64_t ConvertFloatToFixed(double Value, uint32_t Scale)
@@ -114,25 +168,33 @@ bool IsSignedBitSet(int64_t Value, int32_t NumBits)
 
 void DLPC_COMMON_PackOpcode(int32_t Length, uint16_t Opcode)
 {
-    memcpy(&s_WriteBuffer[s_WriteBufferIndex], &Opcode, Length);
-    s_WriteBufferIndex += Length;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    memcpy(&Context->WriteBuffer[Context->WriteBufferIndex], &Opcode, Length);
+    Context->WriteBufferIndex += Length;
 }
 
 void DLPC_COMMON_MoveWriteBufferPointer(int32_t Offset)
 {
-    s_WriteBufferIndex += Offset;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    Context->WriteBufferIndex += Offset;
 }
 
 void DLPC_COMMON_PackByte(uint8_t Data)
 {
-    s_WriteBuffer[s_WriteBufferIndex] = Data;
-    s_WriteBufferIndex++;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    Context->WriteBuffer[Context->WriteBufferIndex] = Data;
+    Context->WriteBufferIndex++;
 }
 
 void DLPC_COMMON_PackBytes(uint8_t* Data, int32_t Length)
 {
-    memcpy(&s_WriteBuffer[s_WriteBufferIndex], Data, Length);
-    s_WriteBufferIndex += Length;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    memcpy(&Context->WriteBuffer[Context->WriteBufferIndex], Data, Length);
+    Context->WriteBufferIndex += Length;
 }
 
 void DLPC_COMMON_PackFloat(double Value, int32_t Length, uint32_t Scale)
@@ -143,8 +205,9 @@ void DLPC_COMMON_PackFloat(double Value, int32_t Length, uint32_t Scale)
 
 void DLPC_COMMON_SetBits(int32_t Value, int32_t NumBits, int32_t BitOffset)
 {
+    DLPC_COMMON_Context_s* Context = GetContext();
     uint32_t StartBit  = BitOffset % 8;
-    uint32_t StartByte = s_WriteBufferIndex + (BitOffset / 8);
+    uint32_t StartByte = Context->WriteBufferIndex + (BitOffset / 8);
     uint32_t EndByte   = StartByte + ((NumBits + 7) / 8);
     uint32_t Index;
     uint64_t BitMask;
@@ -153,8 +216,8 @@ void DLPC_COMMON_SetBits(int32_t Value, int32_t NumBits, int32_t BitOffset)
     {
         BitMask = GetBitMask(NumBits > 8 ? 8 : NumBits);
         
-        s_WriteBuffer[Index] &= (uint8_t)(~(BitMask << StartBit));
-        s_WriteBuffer[Index] |= (uint8_t)((Value & BitMask) << StartBit);
+        Context->WriteBuffer[Index] &= (uint8_t)(~(BitMask << StartBit));
+        Context->WriteBuffer[Index] |= (uint8_t)((Value & BitMask) << StartBit);
         
         Value    = Value >> (8 - StartBit);
         NumBits  = NumBits - (8 - StartBit);
@@ -164,15 +227,18 @@ void DLPC_COMMON_SetBits(int32_t Value, int32_t NumBits, int32_t BitOffset)
 
 void DLPC_COMMON_MoveReadBufferPointer(int32_t Length)
 {
-    s_ReadBufferIndex += Length;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    Context->ReadBufferIndex += Length;
 }
 
 uint8_t* DLPC_COMMON_UnpackBytes(int32_t Length)
 {
-    uint16_t CurReadBufferIndex = s_ReadBufferIndex;
-    s_ReadBufferIndex += Length;
+    DLPC_COMMON_Context_s* Context            = GetContext();
+    uint16_t               CurReadBufferIndex = Context->ReadBufferIndex;
+    Context->ReadBufferIndex += Length;
 
-    return &s_ReadBuffer[CurReadBufferIndex];
+    return &Context->ReadBuffer[CurReadBufferIndex];
 }
 
 double DLPC_COMMON_UnpackFloat(int32_t Length, uint32_t Scale, bool Signed)
@@ -191,8 +257,9 @@ double DLPC_COMMON_UnpackFloat(int32_t Length, uint32_t Scale, bool Signed)
 
 uint64_t DLPC_COMMON_GetBits(uint8_t NumBits, uint8_t BitOffset, bool Signed)
 {
+    DLPC_COMMON_Context_s* Context = GetContext();
     uint32_t StartBit  = BitOffset % 8;
-    uint32_t StartByte = s_ReadBufferIndex + (BitOffset / 8);
+    uint32_t StartByte = Context->ReadBufferIndex + (BitOffset / 8);
     uint32_t EndByte   = StartByte + ((NumBits + 7) / 8);
     uint64_t Value     = 0;
     uint32_t Index;
@@ -204,7 +271,7 @@ uint64_t DLPC_COMMON_GetBits(uint8_t NumBits, uint8_t BitOffset, bool Signed)
         BitMask = GetBitMask(NumBits > 8 ? 8 : NumBits);
 
         Shift = 8 * (Index - StartByte);
-        Value |= (((s_ReadBuffer[Index] >> StartBit) & BitMask) << Shift);
+        Value |= (((Context->ReadBuffer[Index] >> StartBit) & BitMask) << Shift);
 
         NumBits  = NumBits - (8 - StartBit);
         StartBit = 0;
@@ -215,10 +282,12 @@ uint64_t DLPC_COMMON_GetBits(uint8_t NumBits, uint8_t BitOffset, bool Signed)
 
 void DLPC_COMMON_SetCommandDestination(uint16_t CommandDestination)
 {
-    s_ProtocolData.CommandDestination = CommandDestination;
+    DLPC_COMMON_Context_s* Context = GetContext();
+
+    Context->ProtocolData.CommandDestination = CommandDestination;
 }
 
 uint16_t DLPC_COMMON_GetBytesRead()
 {
-    return s_ProtocolData.BytesRead;
+    return GetContext()->ProtocolData.BytesRead;
 }
\ No newline at end of file
@@ -0,0 +1,523 @@
+#include "flashProgrammer.h"
+
+#include "common.hpp"
+#include "fnvHash.h"
+#include "transport.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace slmaster {
+namespace device {
+
+namespace {
+/** @brief 控制器单条Write Flash Start/Continue命令可携带的最大数据长度 */
+struct ControllerChunkLimit {
+    bool isDualController_; //是否为DLPC34xx dual控制器
+    uint16_t maxChunkSize_; //最大数据长度
+};
+
+// DLPC3470/3478/3479的Flash Data Length以1024字节为上限；DLPC654x不经由本类烧录
+const ControllerChunkLimit kChunkLimits[] = {{false, 1024}, {true, 1024}};
+
+// Write Flash Start/Continue的操作码，两种控制器相同
+constexpr uint8_t kWriteFlashStartOpcode = 0xE1;
+constexpr uint8_t kWriteFlashContinueOpcode = 0xE2;
+
+uint16_t getControllerMaxChunkSize(const bool isDualController) {
+#ifdef FLASH_MAX_CHUNK_SIZE
+    // 固件放宽了限制时可在编译时覆盖
+    return FLASH_MAX_CHUNK_SIZE;
+#else
+    for (const auto &limit : kChunkLimits) {
+        if (limit.isDualController_ == isDualController) {
+            return limit.maxChunkSize_;
+        }
+    }
+
+    return FLASH_MIN_CHUNK_SIZE;
+#endif
+}
+
+double toThroughput(const uint64_t writtenBytes, const double writtenSeconds) {
+    // 样本太少时计时误差大
+    if (writtenBytes < FLASH_THROUGHPUT_MIN_BYTES || writtenSeconds <= 0) {
+        return DEFAULT_FLASH_WRITE_THROUGHPUT;
+    }
+
+    return writtenBytes / writtenSeconds;
+}
+} // namespace
+
+FlashProgrammer::FlashProgrammer(const bool isDualController)
+    : isDualController_(isDualController), startProgramming_(false),
+      maxChunkSize_(getControllerMaxChunkSize(isDualController)),
+      chunkSizeIndex_(0), numOfChunkFailures_(0), dataLength_(0),
+      buffers_(std::max(FLASH_PROGRAM_QUEUE_DEPTH, 2),
+               std::vector<uint8_t>(maxChunkSize_)),
+      lengths_(buffers_.size(), 0), fillIndex_(0), bufferPtr_(0),
+      writeHash_(kFnvOffsetBasis), numOfHashedBytes_(0), numOfQueued_(0),
+      isFinishing_(false), isFailed_(false),
+      commandContext_(nullptr), stats_(),
+      fingerprint_(0), verifyHash_(0), verifyLength_(0),
+      eraseSeconds_(DEFAULT_FLASH_ERASE_SECONDS),
+      eraseWait_{false, 0, 0}, writtenBytes_(0), writtenSeconds_(0) {
+    // 候选长度从上限逐次减半，最长的吞吐量最高
+    for (uint32_t size = maxChunkSize_; size >= FLASH_MIN_CHUNK_SIZE;
+         size /= 2) {
+        chunkSizes_.push_back((uint16_t)size);
+    }
+
+    if (chunkSizes_.empty()) {
+        chunkSizes_.push_back(maxChunkSize_);
+    }
+}
+
+FlashProgrammer::~FlashProgrammer() { finish(); }
+
+bool FlashProgrammer::erase() {
+    // 擦除需要数秒，状态查询逐渐放慢，不持续占用总线
+    const PollSchedule schedule = PollSchedule::exponential(
+        std::chrono::milliseconds(10), std::chrono::milliseconds(200));
+    // 两次查询之间交给空闲回调，排队的关键命令随到随执行，不必等到下次查询
+    auto idle = [&](const std::chrono::steady_clock::time_point wake) {
+        runIdleHook(wake);
+        std::this_thread::sleep_until(wake);
+    };
+    WaitResult result;
+
+    if (isDualController_) {
+        DLPC34XX_DUAL_WriteFlashDataTypeSelect(
+            DLPC34XX_DUAL_FDTS_ENTIRE_SENS_PATTERN_DATA);
+        DLPC34XX_DUAL_WriteFlashErase();
+        result = waitUntil(
+            [&] {
+                DLPC34XX_DUAL_ShortStatus_s ShortStatus;
+                return DLPC34XX_DUAL_ReadShortStatus(&ShortStatus) ==
+                           SUCCESS &&
+                       ShortStatus.FlashEraseComplete !=
+                           DLPC34XX_DUAL_FE_NOT_COMPLETE;
+            },
+            std::chrono::seconds(FLASH_ERASE_TIMEOUT_SECONDS), schedule, idle);
+    } else {
+        DLPC34XX_WriteFlashDataTypeSelect(
+            DLPC34XX_FDTS_ENTIRE_SENS_PATTERN_DATA);
+        DLPC34XX_WriteFlashErase();
+        result = waitUntil(
+            [&] {
+                DLPC34XX_ShortStatus_s ShortStatus;
+                return DLPC34XX_ReadShortStatus(&ShortStatus) == SUCCESS &&
+                       ShortStatus.FlashEraseComplete !=
+                           DLPC34XX_FE_NOT_COMPLETE;
+            },
+            std::chrono::seconds(FLASH_ERASE_TIMEOUT_SECONDS), schedule, idle);
+    }
+
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    eraseWait_ = result;
+    if (result.isSatisfied_) {
+        eraseSeconds_ = result.seconds_;
+    }
+
+    return result.isSatisfied_;
+}
+
+WaitResult FlashProgrammer::getEraseWait() const {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    return eraseWait_;
+}
+
+void FlashProgrammer::begin() {
+    // 上一次烧录未结束时先等待其写完
+    finish();
+
+    startProgramming_ = true;
+    fillIndex_ = 0;
+    bufferPtr_ = 0;
+    writeHash_ = kFnvOffsetBasis;
+    numOfHashedBytes_ = 0;
+    numOfQueued_ = 0;
+    isFinishing_ = false;
+    isFailed_ = false;
+    chunkSizeIndex_ = 0;
+    numOfChunkFailures_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = FlashProgramStats();
+    }
+    dataLength_ = (uint16_t)buffers_[0].size();
+
+    if (isDualController_) {
+        DLPC34XX_DUAL_WriteFlashDataLength(dataLength_);
+    } else {
+        DLPC34XX_WriteFlashDataLength(dataLength_);
+    }
+
+    programStart_ = std::chrono::steady_clock::now();
+    commandContext_ = DLPC_COMMON_GetSelectedContext();
+    ioThread_ = std::thread(&FlashProgrammer::ioLoop, this);
+}
+
+bool FlashProgrammer::program(const uint16_t length, uint8_t *pData) {
+    uint32_t status = SUCCESS;
+
+    if (length != dataLength_) {
+        status = isDualController_
+                     ? DLPC34XX_DUAL_WriteFlashDataLength(length)
+                     : DLPC34XX_WriteFlashDataLength(length);
+        if (status != SUCCESS) {
+            return false;
+        }
+
+        dataLength_ = length;
+    }
+
+    if (isDualController_) {
+        status = startProgramming_
+                     ? DLPC34XX_DUAL_WriteFlashStart(length, pData)
+                     : DLPC34XX_DUAL_WriteFlashContinue(length, pData);
+    } else {
+        status = startProgramming_
+                     ? DLPC34XX_WriteFlashStart(length, pData)
+                     : DLPC34XX_WriteFlashContinue(length, pData);
+    }
+
+    if (status != SUCCESS) {
+        return false;
+    }
+
+    startProgramming_ = false;
+
+    return true;
+}
+
+bool FlashProgrammer::sendBlock(uint32_t length, uint8_t *pData) {
+    while (length > 0) {
+        if (chunkSizeIndex_ >= chunkSizes_.size()) {
+            return false;
+        }
+
+        const uint16_t chunkSize = chunkSizes_[chunkSizeIndex_];
+        const uint16_t count =
+            (uint16_t)(length > chunkSize ? chunkSize : length);
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool isSucess = program(count, pData);
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+
+        if (!isSucess) {
+            // 整条命令被丢弃，先按相同长度重发；连续失败才视为控制器或桥接芯片不接受该长度
+            dataLength_ = 0;
+            if (++numOfChunkFailures_ >= FLASH_CHUNK_RETRIES) {
+                ++chunkSizeIndex_;
+                numOfChunkFailures_ = 0;
+            }
+
+            auto context =
+                static_cast<CommandContext *>(DLPC_COMMON_GetUserData());
+            if (context && chunkSizeIndex_ < chunkSizes_.size()) {
+                context->getStats().recordRetry(startProgramming_
+                                                    ? kWriteFlashStartOpcode
+                                                    : kWriteFlashContinueOpcode);
+            }
+            continue;
+        }
+
+        numOfChunkFailures_ = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.bytes_ += count;
+            ++stats_.chunks_;
+            stats_.chunkSize_ = chunkSize;
+            // 烧录结束时再除以命令数
+            stats_.meanChunkSeconds_ += seconds;
+            stats_.maxChunkSeconds_ =
+                std::max(stats_.maxChunkSeconds_, seconds);
+        }
+
+        pData += count;
+        length -= count;
+
+        runIdleHook();
+    }
+
+    return true;
+}
+
+void FlashProgrammer::ioLoop() {
+    CommandContextScope scope(commandContext_);
+    size_t sendIndex = 0;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (numOfQueued_ == 0) {
+            if (isFinishing_) {
+                break;
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            queueChanged_.wait(
+                lock, [&] { return numOfQueued_ > 0 || isFinishing_; });
+            stats_.linkIdleSeconds_ += std::chrono::duration<double>(
+                                           std::chrono::steady_clock::now() -
+                                           start)
+                                           .count();
+            continue;
+        }
+
+        // 已提交的写入块在烧录完成前不会被填充，发送时无需持锁；
+        // 失败后继续取走写入块，避免编码器一直等待
+        const uint32_t length = lengths_[sendIndex];
+        const bool isSkipped = isFailed_;
+        lock.unlock();
+
+        const bool isSucess =
+            isSkipped || sendBlock(length, buffers_[sendIndex].data());
+
+        lock.lock();
+        isFailed_ = isFailed_ || !isSucess;
+        sendIndex = (sendIndex + 1) % buffers_.size();
+        --numOfQueued_;
+        queueChanged_.notify_all();
+    }
+}
+
+void FlashProgrammer::submit() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    lengths_[fillIndex_] = bufferPtr_;
+    ++numOfQueued_;
+    fillIndex_ = (fillIndex_ + 1) % buffers_.size();
+    bufferPtr_ = 0;
+    queueChanged_.notify_all();
+
+    // 所有写入块都在等待发送，编码器被链路阻塞
+    if (numOfQueued_ == buffers_.size()) {
+        const auto start = std::chrono::steady_clock::now();
+        queueChanged_.wait(lock,
+                           [&] { return numOfQueued_ < buffers_.size(); });
+        stats_.encoderStallSeconds_ += std::chrono::duration<double>(
+                                           std::chrono::steady_clock::now() -
+                                           start)
+                                           .count();
+    }
+}
+
+void FlashProgrammer::write(uint32_t length, uint8_t *pData) {
+    const uint32_t blockSize = (uint32_t)buffers_[0].size();
+
+    const uint32_t numOfHashed =
+        std::min<uint32_t>(length, FLASH_VERIFY_BYTES - numOfHashedBytes_);
+    writeHash_ = fnvHash(pData, numOfHashed, writeHash_);
+    numOfHashedBytes_ += numOfHashed;
+
+    while (length > 0) {
+        uint32_t count = blockSize - bufferPtr_;
+        if (count > length) {
+            count = length;
+        }
+
+        memcpy(&buffers_[fillIndex_][bufferPtr_], pData, count);
+        bufferPtr_ += count;
+        pData += count;
+        length -= count;
+
+        if (bufferPtr_ >= blockSize) {
+            submit();
+        }
+    }
+}
+
+bool FlashProgrammer::finish() {
+    if (!ioThread_.joinable()) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (bufferPtr_ > 0) {
+            lengths_[fillIndex_] = bufferPtr_;
+            ++numOfQueued_;
+            bufferPtr_ = 0;
+        }
+
+        isFinishing_ = true;
+    }
+    queueChanged_.notify_all();
+    ioThread_.join();
+
+    startProgramming_ = false;
+
+    uint64_t bytes = 0;
+    double chunkSeconds = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bytes = stats_.bytes_;
+        chunkSeconds = stats_.meanChunkSeconds_;
+        stats_.seconds_ =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          programStart_)
+                .count();
+        stats_.bytesPerSecond_ =
+            stats_.seconds_ > 0 ? stats_.bytes_ / stats_.seconds_ : 0;
+        stats_.meanChunkSeconds_ =
+            stats_.chunks_ > 0 ? chunkSeconds / stats_.chunks_ : 0;
+    }
+
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    writtenBytes_ += bytes;
+    writtenSeconds_ += chunkSeconds;
+
+    return !isFailed_;
+}
+
+FlashProgramStats FlashProgrammer::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool FlashProgrammer::read(uint32_t length, uint8_t *pData) {
+    bool isStart = true;
+
+    if (isDualController_) {
+        DLPC34XX_DUAL_WriteFlashDataTypeSelect(
+            DLPC34XX_DUAL_FDTS_ENTIRE_SENS_PATTERN_DATA);
+    } else {
+        DLPC34XX_WriteFlashDataTypeSelect(
+            DLPC34XX_FDTS_ENTIRE_SENS_PATTERN_DATA);
+    }
+
+    while (length > 0) {
+        const uint16_t count =
+            (uint16_t)(length > FLASH_READ_BLOCK_SIZE ? FLASH_READ_BLOCK_SIZE
+                                                      : length);
+        uint32_t status;
+
+        if (isDualController_) {
+            DLPC34XX_DUAL_WriteFlashDataLength(count);
+            status = isStart ? DLPC34XX_DUAL_ReadFlashStart(count, pData)
+                             : DLPC34XX_DUAL_ReadFlashContinue(count, pData);
+        } else {
+            DLPC34XX_WriteFlashDataLength(count);
+            status = isStart ? DLPC34XX_ReadFlashStart(count, pData)
+                             : DLPC34XX_ReadFlashContinue(count, pData);
+        }
+
+        if (status != SUCCESS) {
+            return false;
+        }
+
+        isStart = false;
+        pData += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+bool FlashProgrammer::isProgrammed(const uint64_t fingerprint,
+                                   const uint8_t *pHeader,
+                                   const uint32_t headerLength) {
+    uint64_t verifyHash = 0;
+    uint32_t verifyLength = 0;
+    {
+        std::lock_guard<std::mutex> lock(recordMutex_);
+        if (fingerprint == 0 || fingerprint != fingerprint_ ||
+            verifyLength_ == 0) {
+            return false;
+        }
+
+        verifyHash = verifyHash_;
+        verifyLength = verifyLength_;
+    }
+
+    // 记录可能来自上一次运行，flash也可能被其它工具改写，以实际的头部与首个图案为准
+    std::vector<uint8_t> data(std::max(headerLength, verifyLength));
+    if (!read((uint32_t)data.size(), data.data())) {
+        return false;
+    }
+
+    return memcmp(data.data(), pHeader, headerLength) == 0 &&
+           fnvHash(data.data(), verifyLength) == verifyHash;
+}
+
+void FlashProgrammer::setProgrammed(const uint64_t fingerprint) {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    fingerprint_ = fingerprint;
+    verifyHash_ = fingerprint != 0 ? writeHash_ : 0;
+    verifyLength_ = fingerprint != 0 ? numOfHashedBytes_ : 0;
+
+    if (!fingerprintFile_.empty()) {
+        std::ofstream file(fingerprintFile_, std::ios::trunc);
+        file << std::hex << fingerprint_ << " " << verifyLength_ << " "
+             << verifyHash_;
+    }
+}
+
+uint64_t FlashProgrammer::getProgrammed() const {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    return fingerprint_;
+}
+
+double FlashProgrammer::getWriteThroughput() const {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    return toThroughput(writtenBytes_, writtenSeconds_);
+}
+
+double FlashProgrammer::estimateSeconds(const uint32_t blockSize) const {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    return eraseSeconds_ +
+           blockSize / toThroughput(writtenBytes_, writtenSeconds_);
+}
+
+void FlashProgrammer::setFingerprintFile(const std::string &path) {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    fingerprintFile_ = path;
+
+    if (!fingerprintFile_.empty()) {
+        std::ifstream file(fingerprintFile_);
+        uint64_t fingerprint = 0, verifyHash = 0;
+        uint32_t verifyLength = 0;
+        if (file >> std::hex >> fingerprint >> verifyLength >> verifyHash) {
+            fingerprint_ = fingerprint;
+            verifyHash_ = verifyHash;
+            verifyLength_ = std::min<uint32_t>(verifyLength, FLASH_VERIFY_BYTES);
+        }
+    }
+}
+
+std::string
+FlashProgrammer::getFingerprintFilePath(const std::string &directory,
+                                        const std::string &controller,
+                                        const std::string &identity) {
+    if (directory.empty() || identity.empty()) {
+        return "";
+    }
+
+    // 标识可能含有路径分隔符等字符
+    std::string name = controller + "-" + identity;
+    std::replace_if(
+        name.begin() + controller.size() + 1, name.end(),
+        [](const char c) {
+            return !isalnum((unsigned char)c) && c != '-' && c != '_' &&
+                   c != '.';
+        },
+        '_');
+
+    return (std::filesystem::path(directory) / (name + ".programmed"))
+        .string();
+}
+
+void FlashProgrammer::writePatternData(uint32_t length, uint8_t *pData,
+                                       void *userData) {
+    static_cast<FlashProgrammer *>(userData)->write(length, pData);
+}
+
+} // namespace device
+} // namespace slmaster
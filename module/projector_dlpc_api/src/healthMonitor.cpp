@@ -0,0 +1,77 @@
+#include "healthMonitor.h"
+
+namespace slmaster {
+namespace device {
+
+HealthMonitor::HealthMonitor()
+    : state_(std::make_shared<State>()), isRunning_(false) {}
+
+HealthMonitor::~HealthMonitor() {
+    stop();
+
+    // 在故障回调中析构时无法等待自身退出，线程只持有共享状态，回调返回后即退出
+    if (thread_.joinable()) {
+        thread_.detach();
+    }
+}
+
+void HealthMonitor::start(const std::chrono::milliseconds interval,
+                          const Check &check,
+                          const ProjectorFaultCallback &onFault) {
+    stop();
+
+    // 在故障回调中停止的线程尚未回收
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    state_ = std::make_shared<State>();
+    state_->interval_ = interval;
+    state_->check_ = check;
+    state_->onFault_ = onFault;
+    state_->isExit_ = false;
+    isRunning_ = true;
+    thread_ = std::thread(&HealthMonitor::run, state_);
+}
+
+void HealthMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        state_->isExit_ = true;
+    }
+    state_->wakeUp_.notify_all();
+    isRunning_ = false;
+
+    if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+        thread_.join();
+    }
+}
+
+void HealthMonitor::run(std::shared_ptr<State> state) {
+    std::unique_lock<std::mutex> lock(state->mutex_);
+    while (!state->wakeUp_.wait_for(lock, state->interval_,
+                                    [&] { return state->isExit_; })) {
+        lock.unlock();
+
+        ProjectorFault fault = ProjectorFault();
+        if (state->check_(fault)) {
+            ++state->numOfChecks_;
+
+            const bool isFault = fault.isFault();
+            if (isFault && !state->isFaulted_.exchange(isFault) &&
+                state->onFault_) {
+                // 回调中可能停止甚至析构监视器，之后只访问共享状态
+                state->onFault_(fault);
+            } else if (!isFault) {
+                state->isFaulted_ = false;
+            }
+        } else {
+            ++state->numOfSkippedChecks_;
+        }
+
+        lock.lock();
+    }
+}
+
+} // namespace device
+} // namespace slmaster
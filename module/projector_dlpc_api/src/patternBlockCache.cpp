@@ -0,0 +1,89 @@
+#include "patternBlockCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace slmaster {
+namespace device {
+
+PatternBlockCache::PatternBlockCache(const std::string &directory)
+    : directory_(directory), isValid_(false), stats_() {
+    std::error_code errorCode;
+    std::filesystem::create_directories(directory_, errorCode);
+    isValid_ = std::filesystem::is_directory(directory_, errorCode);
+}
+
+std::string PatternBlockCache::getPath(const uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.patn", (unsigned long long)key);
+
+    return (std::filesystem::path(directory_) / name).string();
+}
+
+bool PatternBlockCache::load(const uint64_t key, const uint32_t blockSize,
+                             std::vector<uint8_t> &block) {
+    bool isHit = false;
+
+    if (isValid_) {
+        std::ifstream file(getPath(key), std::ios::binary | std::ios::ate);
+        if (file && (uint64_t)file.tellg() == blockSize) {
+            block.resize(blockSize);
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(block.data()), blockSize);
+            isHit = file.good() && blockSize >= 4 &&
+                    memcmp(block.data(), "PATN", 4) == 0;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (isHit) {
+        ++stats_.hits_;
+        stats_.bytesLoaded_ += blockSize;
+    } else {
+        ++stats_.misses_;
+    }
+
+    return isHit;
+}
+
+bool PatternBlockCache::store(const uint64_t key,
+                              const std::vector<uint8_t> &block) {
+    if (!isValid_) {
+        return false;
+    }
+
+    // 先写临时文件再改名，中断时不会留下不完整的数据块
+    const std::string path = getPath(key);
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(block.data()),
+                   block.size());
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::remove(path, errorCode);
+    std::filesystem::rename(tempPath, path, errorCode);
+    if (errorCode) {
+        std::filesystem::remove(tempPath, errorCode);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.stores_;
+
+    return true;
+}
+
+PatternCacheStats PatternBlockCache::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+} // namespace device
+} // namespace slmaster
@@ -0,0 +1,425 @@
+#include "patternBlockFile.h"
+
+#include "dlpc_common.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace slmaster {
+namespace device {
+
+namespace {
+constexpr char kFileId[4] = {'S', 'L', 'P', 'B'};
+constexpr uint32_t kFileVersion = 1;
+constexpr uint32_t kEastWestFlip = 0x1;
+constexpr uint32_t kLongAxisFlip = 0x2;
+
+/** @brief .patn文件头，其后依次为顺序表项和"PATN"数据块 */
+struct FileHeader {
+    char id_[4];
+    uint32_t version_;
+    uint32_t blockStart_;
+    uint32_t blockSize_;
+    uint64_t hash_;
+    uint32_t dmd_;
+    uint32_t flags_;
+    uint32_t numOfPatternSets_;
+    uint32_t numOfPatterns_;
+    uint32_t orderTableCount_;
+    uint32_t reserved_;
+};
+
+/** @brief 文件中的顺序表项 */
+struct FileOrderTableEntry {
+    uint8_t patternSetIndex_;
+    uint8_t numDisplayPatterns_;
+    uint8_t illumination_;
+    uint8_t invertPatterns_;
+    uint32_t illuminationTime_;
+    uint32_t preIlluminationDarkTime_;
+    uint32_t postIlluminationDarkTime_;
+};
+
+uint32_t readUint32(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+Illumination toIllumination(const DLPC34XX_INT_PAT_IlluminationSelect_e select) {
+    switch (select) {
+    case DLPC34XX_INT_PAT_ILLUMINATION_RED:
+        return Red;
+    case DLPC34XX_INT_PAT_ILLUMINATION_GREEN:
+        return Grren;
+    case DLPC34XX_INT_PAT_ILLUMINATION_BLUE:
+        return Blue;
+    default:
+        return RGB;
+    }
+}
+} // namespace
+
+PatternBlockFile::PatternBlockFile()
+    : data_(nullptr), size_(0), block_(nullptr), blockSize_(0),
+      headerSize_(0), hash_(0), isEastWestFlip_(false),
+      isLongAxisFlip_(false) {
+    DLPC34XX_INT_PAT_InitEncoder(&encoder_, DLPC34XX_INT_PAT_DMD_DLP4710, 0,
+                                 nullptr, 0, nullptr, nullptr, nullptr);
+}
+
+PatternBlockFile::~PatternBlockFile() { close(); }
+
+bool PatternBlockFile::save(const std::string &path, PatternEncoder &encoder,
+                            const bool eastWestFlip, const bool longAxisFlip) {
+    if (!encoder.encodeBlock(eastWestFlip, longAxisFlip)) {
+        return false;
+    }
+
+    const std::vector<uint8_t> &block = encoder.getBlock();
+    const std::vector<DLPC34XX_INT_PAT_PatternOrderTableEntry_s> &orderTable =
+        encoder.getPatternOrderTable();
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.id_, kFileId, sizeof(kFileId));
+    header.version_ = kFileVersion;
+    // 数据块按8字节对齐，映射后可直接按字读取
+    header.blockStart_ =
+        (uint32_t)((sizeof(FileHeader) +
+                    orderTable.size() * sizeof(FileOrderTableEntry) + 7) &
+                   ~(size_t)7);
+    header.blockSize_ = (uint32_t)block.size();
+    header.hash_ = encoder.getHash(eastWestFlip, longAxisFlip);
+    header.dmd_ = (uint32_t)encoder.getDMD();
+    header.flags_ = (eastWestFlip ? kEastWestFlip : 0) |
+                    (longAxisFlip ? kLongAxisFlip : 0);
+    header.numOfPatternSets_ = (uint32_t)encoder.getNumOfPatternSets();
+    header.numOfPatterns_ = (uint32_t)encoder.getNumOfPatterns();
+    header.orderTableCount_ = (uint32_t)orderTable.size();
+
+    std::vector<uint8_t> prefix(header.blockStart_, 0);
+    memcpy(prefix.data(), &header, sizeof(header));
+    for (size_t i = 0; i < orderTable.size(); ++i) {
+        FileOrderTableEntry entry;
+        entry.patternSetIndex_ = orderTable[i].PatternSetIndex;
+        entry.numDisplayPatterns_ = orderTable[i].NumDisplayPatterns;
+        entry.illumination_ = (uint8_t)orderTable[i].IlluminationSelect;
+        entry.invertPatterns_ = orderTable[i].InvertPatterns ? 1 : 0;
+        entry.illuminationTime_ = orderTable[i].IlluminationTimeInMicroseconds;
+        entry.preIlluminationDarkTime_ =
+            orderTable[i].PreIlluminationDarkTimeInMicroseconds;
+        entry.postIlluminationDarkTime_ =
+            orderTable[i].PostIlluminationDarkTimeInMicroseconds;
+        memcpy(&prefix[sizeof(header) + i * sizeof(entry)], &entry,
+               sizeof(entry));
+    }
+
+    // 先写临时文件再改名，中断时不会留下不完整的文件
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(prefix.data()),
+                   prefix.size());
+        file.write(reinterpret_cast<const char *>(block.data()),
+                   block.size());
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::remove(path, errorCode);
+    std::filesystem::rename(tempPath, path, errorCode);
+    if (errorCode) {
+        std::filesystem::remove(tempPath, errorCode);
+        return false;
+    }
+
+    return true;
+}
+
+bool PatternBlockFile::open(const std::string &path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping =
+            CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+
+    // 映射视图会保持映射对象有效
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t *>(view);
+    size_ = (size_t)fileSize.QuadPart;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    void *view = MAP_FAILED;
+    if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+        view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE,
+                    file, 0);
+    }
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t *>(view);
+    size_ = (size_t)fileStat.st_size;
+#endif
+
+    FileHeader header;
+    bool isValid = size_ >= sizeof(header);
+    if (isValid) {
+        memcpy(&header, data_, sizeof(header));
+        isValid = memcmp(header.id_, kFileId, sizeof(kFileId)) == 0 &&
+                  header.version_ == kFileVersion &&
+                  header.blockStart_ >=
+                      sizeof(header) + (uint64_t)header.orderTableCount_ *
+                                           sizeof(FileOrderTableEntry) &&
+                  (uint64_t)header.blockStart_ + header.blockSize_ <= size_;
+    }
+
+    if (isValid) {
+        block_ = data_ + header.blockStart_;
+        blockSize_ = header.blockSize_;
+        hash_ = header.hash_;
+        isEastWestFlip_ = (header.flags_ & kEastWestFlip) != 0;
+        isLongAxisFlip_ = (header.flags_ & kLongAxisFlip) != 0;
+
+        patternOrderTable_.resize(header.orderTableCount_);
+        for (uint32_t i = 0; i < header.orderTableCount_; ++i) {
+            FileOrderTableEntry entry;
+            memcpy(&entry, data_ + sizeof(header) + i * sizeof(entry),
+                   sizeof(entry));
+            patternOrderTable_[i].PatternSetIndex = entry.patternSetIndex_;
+            patternOrderTable_[i].NumDisplayPatterns =
+                entry.numDisplayPatterns_;
+            patternOrderTable_[i].IlluminationSelect =
+                (DLPC34XX_INT_PAT_IlluminationSelect_e)entry.illumination_;
+            patternOrderTable_[i].InvertPatterns = entry.invertPatterns_ != 0;
+            patternOrderTable_[i].IlluminationTimeInMicroseconds =
+                entry.illuminationTime_;
+            patternOrderTable_[i].PreIlluminationDarkTimeInMicroseconds =
+                entry.preIlluminationDarkTime_;
+            patternOrderTable_[i].PostIlluminationDarkTimeInMicroseconds =
+                entry.postIlluminationDarkTime_;
+        }
+
+        isValid = DLPC34XX_INT_PAT_InitEncoder(
+                      &encoder_, (DLPC34XX_INT_PAT_DMD_e)header.dmd_, 0,
+                      nullptr, 0, nullptr, nullptr,
+                      nullptr) == DLPC_SUCCESS &&
+                  parseBlock() &&
+                  patternSets_.size() == header.numOfPatternSets_ &&
+                  patterns_.size() == header.numOfPatterns_;
+    }
+
+    if (!isValid) {
+        close();
+    }
+
+    return isValid;
+}
+
+bool PatternBlockFile::parseBlock() {
+    // "PATN"块头：Id、图案集合起始、图案集合大小、顺序表起始、顺序表大小
+    if (blockSize_ < 20 || memcmp(block_, "PATN", 4) != 0) {
+        return false;
+    }
+
+    const uint32_t setsStart = readUint32(block_ + 4);
+    if ((uint64_t)setsStart + 4 > blockSize_) {
+        return false;
+    }
+
+    const uint32_t numOfSets = readUint32(block_ + setsStart);
+    if ((uint64_t)setsStart + 4 + (uint64_t)numOfSets * 4 > blockSize_) {
+        return false;
+    }
+
+    // 先确定每个集合的图案数量，再让patternSets_引用patterns_
+    std::vector<uint32_t> setStarts(numOfSets);
+    size_t numOfPatterns = 0;
+    for (uint32_t i = 0; i < numOfSets; ++i) {
+        setStarts[i] = readUint32(block_ + setsStart + 4 + i * 4);
+        if ((uint64_t)setStarts[i] + 8 > blockSize_) {
+            return false;
+        }
+        numOfPatterns += block_[setStarts[i]];
+    }
+
+    patterns_.assign(numOfPatterns, DLPC34XX_INT_PAT_PatternData_s());
+    patternSets_.resize(numOfSets);
+
+    size_t indexOfPattern = 0;
+    for (uint32_t i = 0; i < numOfSets; ++i) {
+        // 集合头：图案数量、方向、位深、保留、数据大小
+        const uint8_t *setHeader = block_ + setStarts[i];
+        const uint8_t bitDepth = setHeader[2];
+        if (bitDepth != DLPC34XX_INT_PAT_BITDEPTH_ONE &&
+            bitDepth != DLPC34XX_INT_PAT_BITDEPTH_EIGHT) {
+            return false;
+        }
+
+        DLPC34XX_INT_PAT_PatternSet_s &patternSet = patternSets_[i];
+        patternSet.PatternCount = setHeader[0];
+        patternSet.Direction = (DLPC34XX_INT_PAT_Direction_e)setHeader[1];
+        patternSet.BitDepth = (DLPC34XX_INT_PAT_BitDepth_e)bitDepth;
+        patternSet.PatternArray = patterns_.data() + indexOfPattern;
+        patternSet.ThresholdPixels = false;
+
+        const uint32_t lineLength =
+            patternSet.Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL
+                ? encoder_.DMDInfo.Width
+                : encoder_.DMDInfo.Height;
+        for (uint32_t j = 0; j < patternSet.PatternCount; ++j) {
+            patterns_[indexOfPattern].PixelArrayCount = lineLength;
+            patterns_[indexOfPattern].PixelArray = nullptr;
+            ++indexOfPattern;
+        }
+    }
+
+    DLPC34XX_INT_PAT_InitEncoder(
+        &encoder_, encoder_.DMDInfo.DMD, (uint32_t)patternSets_.size(),
+        patternSets_.data(), (uint32_t)patternOrderTable_.size(),
+        patternOrderTable_.data(), nullptr, nullptr);
+
+    // 布局需与重新计算的一致，解码时才能按偏移定位每张图案
+    if (DLPC34XX_INT_PAT_GetEncodedBlockSize(&encoder_) != blockSize_) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numOfSets; ++i) {
+        if (setStarts[i] !=
+            DLPC34XX_INT_PAT_GetPatternSlotOffset(&encoder_, i, 0, true) - 8) {
+            return false;
+        }
+    }
+
+    headerSize_ = blockSize_;
+    for (uint32_t i = 0; i < numOfSets; ++i) {
+        if (patternSets_[i].PatternCount > 0) {
+            headerSize_ =
+                DLPC34XX_INT_PAT_GetPatternSlotOffset(&encoder_, i, 0, true);
+            break;
+        }
+    }
+
+    return true;
+}
+
+void PatternBlockFile::close() {
+    if (data_ != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+#else
+        munmap(const_cast<uint8_t *>(data_), size_);
+#endif
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    block_ = nullptr;
+    blockSize_ = 0;
+    headerSize_ = 0;
+    hash_ = 0;
+    patterns_.clear();
+    patternSets_.clear();
+    patternOrderTable_.clear();
+}
+
+bool PatternBlockFile::decode(std::vector<PatternProfileSet> &table) {
+    if (!isOpen()) {
+        return false;
+    }
+
+    const bool isDualController = encoder_.DMDInfo.RequiresDualController;
+
+    table.resize(patternSets_.size());
+    for (uint32_t i = 0; i < (uint32_t)patternSets_.size(); ++i) {
+        const DLPC34XX_INT_PAT_PatternSet_s &patternSet = patternSets_[i];
+        PatternProfileSet &profileSet = table[i];
+
+        profileSet.isOneBit_ =
+            patternSet.BitDepth == DLPC34XX_INT_PAT_BITDEPTH_ONE;
+        profileSet.isRawOneBit_ = false;
+        profileSet.illumination_ = RGB;
+        profileSet.invertPatterns_ = false;
+        profileSet.exposureTime_ = 0;
+        profileSet.preExposureTime_ = 0;
+        profileSet.postExposureTime_ = 0;
+        for (const auto &entry : patternOrderTable_) {
+            if (entry.PatternSetIndex == i) {
+                profileSet.illumination_ =
+                    toIllumination(entry.IlluminationSelect);
+                profileSet.invertPatterns_ = entry.InvertPatterns;
+                profileSet.exposureTime_ =
+                    (int)entry.IlluminationTimeInMicroseconds;
+                profileSet.preExposureTime_ =
+                    (int)entry.PreIlluminationDarkTimeInMicroseconds;
+                profileSet.postExposureTime_ =
+                    (int)entry.PostIlluminationDarkTimeInMicroseconds;
+                break;
+            }
+        }
+
+        profileSet.profiles_.resize(patternSet.PatternCount);
+        for (uint32_t j = 0; j < patternSet.PatternCount; ++j) {
+            PatternProfile &profile = profileSet.profiles_[j];
+            profile.isVertical_ =
+                patternSet.Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL;
+            profile.line_.assign(patternSet.PatternArray[j].PixelArrayCount,
+                                 0);
+
+            for (int half = 0; half < (isDualController ? 2 : 1); ++half) {
+                const bool isMaster = half == 0;
+                const uint32_t offset = DLPC34XX_INT_PAT_GetPatternSlotOffset(
+                    &encoder_, i, j, isMaster);
+                DLPC34XX_INT_PAT_DecodePatternSlot(
+                    &encoder_, i, j, isMaster, isEastWestFlip_,
+                    isLongAxisFlip_, block_ + offset, profile.line_.data());
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace device
+} // namespace slmaster
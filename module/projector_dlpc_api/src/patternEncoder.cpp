@@ -0,0 +1,413 @@
+#include "patternEncoder.h"
+
+#include "fnvHash.h"
+
+namespace slmaster {
+namespace device {
+
+PatternEncoder::PatternEncoder(const DLPC34XX_INT_PAT_DMD_e dmd)
+    : dmd_(dmd), numOfThreads_(0) {
+    DLPC34XX_INT_PAT_InitEncoder(&encoder_, dmd_, 0, nullptr, 0, nullptr,
+                                 nullptr, nullptr);
+}
+
+bool PatternEncoder::build(const std::vector<PatternProfileSet> &table) {
+    // 数据块中集合索引与每个集合的图案数量均为一个字节
+    if (table.empty() || table.size() > 256) {
+        return false;
+    }
+
+    size_t numOfPatterns = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        if (table[i].profiles_.empty() || table[i].profiles_.size() > 255 ||
+            table[i].exposureTime_ < 0 || table[i].preExposureTime_ < 0 ||
+            table[i].postExposureTime_ < 0) {
+            return false;
+        }
+        numOfPatterns += table[i].profiles_.size();
+    }
+
+    // resize不会释放已有容量，重复烧录时不再重新分配
+    patterns_.resize(numOfPatterns);
+    patternSets_.resize(table.size());
+    patternOrderTable_.resize(table.size());
+
+    int indexOfPattern = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        const std::vector<PatternProfile> &profiles = table[i].profiles_;
+        const bool isVertical = profiles.empty() || profiles[0].isVertical_;
+
+        patternSets_[i].BitDepth = table[i].isOneBit_ == true
+                                       ? DLPC34XX_INT_PAT_BITDEPTH_ONE
+                                       : DLPC34XX_INT_PAT_BITDEPTH_EIGHT;
+        patternSets_[i].Direction = isVertical
+                                        ? DLPC34XX_INT_PAT_DIRECTION_VERTICAL
+                                        : DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL;
+        patternSets_[i].PatternArray = patterns_.data() + indexOfPattern;
+        patternSets_[i].PatternCount = profiles.size();
+        // 原始灰度的一位深度图案在打包时二值化，无需先转换为0或1
+        patternSets_[i].ThresholdPixels =
+            table[i].isOneBit_ && table[i].isRawOneBit_;
+
+        for (size_t j = 0; j < profiles.size(); ++j) {
+            // 同一集合中的图案共用一个方向
+            if (profiles[j].isVertical_ != isVertical) {
+                return false;
+            }
+
+            patterns_[indexOfPattern].PixelArray = profiles[j].line_.data();
+            patterns_[indexOfPattern].PixelArrayCount =
+                (uint32_t)profiles[j].line_.size();
+            ++indexOfPattern;
+        }
+
+        patternOrderTable_[i].PatternSetIndex = i;
+        patternOrderTable_[i].NumDisplayPatterns = patternSets_[i].PatternCount;
+        patternOrderTable_[i].IlluminationSelect =
+            (table[i].illumination_ == Red ? DLPC34XX_INT_PAT_ILLUMINATION_RED
+             : table[i].illumination_ == Grren
+                 ? DLPC34XX_INT_PAT_ILLUMINATION_GREEN
+             : table[i].illumination_ == Blue
+                 ? DLPC34XX_INT_PAT_ILLUMINATION_BLUE
+                 : DLPC34XX_INT_PAT_ILLUMINATION_RGB);
+        patternOrderTable_[i].InvertPatterns = false;
+        patternOrderTable_[i].IlluminationTimeInMicroseconds =
+            table[i].exposureTime_;
+        patternOrderTable_[i].PreIlluminationDarkTimeInMicroseconds =
+            table[i].preExposureTime_;
+        patternOrderTable_[i].PostIlluminationDarkTimeInMicroseconds =
+            table[i].postExposureTime_;
+    }
+
+    DLPC34XX_INT_PAT_InitEncoder(
+        &encoder_, dmd_, (uint32_t)patternSets_.size(), patternSets_.data(),
+        (uint32_t)patternOrderTable_.size(), patternOrderTable_.data(), nullptr,
+        nullptr);
+
+    return true;
+}
+
+bool PatternEncoder::build(PatternSource &source) {
+    sourceTable_.resize(source.getNumOfPatternSets());
+    for (size_t i = 0; i < sourceTable_.size(); ++i) {
+        if (!source.getPatternSet(i, sourceTable_[i])) {
+            return false;
+        }
+
+        // 像素线由encodeStream按需读取，这里不保留
+        for (auto &profile : sourceTable_[i].profiles_) {
+            std::vector<uint8_t>().swap(profile.line_);
+        }
+    }
+
+    return build(sourceTable_);
+}
+
+uint32_t PatternEncoder::getBlockSize() {
+    return DLPC34XX_INT_PAT_GetEncodedBlockSize(&encoder_);
+}
+
+bool PatternEncoder::encode(
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback callback, void *userData,
+    const bool eastWestFlip, const bool longAxisFlip) {
+    if (callback == nullptr) {
+        return false;
+    }
+
+    encoder_.WritePatternDataBlockCallback = callback;
+    encoder_.UserData = userData;
+
+    return DLPC34XX_INT_PAT_EncodePatternDataBlock(
+               &encoder_, eastWestFlip, longAxisFlip) == DLPC_SUCCESS;
+}
+
+namespace {
+// 数据块格式或编码结果变化时递增，使旧缓存失效
+constexpr uint32_t kHashVersion = 2;
+
+void hashValue(uint64_t &hash, uint32_t value) {
+    hash = fnvHash(&value, sizeof(value), hash);
+}
+
+void appendBlockData(uint32_t length, uint8_t *data, void *userData) {
+    auto block = static_cast<std::vector<uint8_t> *>(userData);
+    block->insert(block->end(), data, data + length);
+}
+
+/**
+ * @brief 流式编码时从图案源读取像素线
+ * @note 双控制器先编码集合中所有图案的主控制器一半，再编码从控制器一半，
+ *       因此保留当前集合的像素线，每张图案只读取一次
+ */
+struct SourceReader {
+    PatternSource *source_;
+    const std::vector<DLPC34XX_INT_PAT_PatternSet_s> *patternSets_;
+    //当前集合的索引
+    uint32_t patternSetIndex_;
+    //当前集合的像素线，尚未读取的为空
+    std::vector<PatternProfile> profiles_;
+    //只编码头部，读取第一张图案时中止
+    bool isHeaderOnly_;
+};
+
+bool readProfile(SourceReader &reader, uint32_t patternSetIndex,
+                 uint32_t patternIndex, DLPC34XX_INT_PAT_PatternData_s &pattern) {
+    const DLPC34XX_INT_PAT_PatternSet_s &patternSet =
+        (*reader.patternSets_)[patternSetIndex];
+    if (reader.patternSetIndex_ != patternSetIndex) {
+        // 换到下一个集合时复用像素线内存
+        for (auto &profile : reader.profiles_) {
+            profile.line_.clear();
+        }
+        reader.profiles_.resize(patternSet.PatternCount);
+        reader.patternSetIndex_ = patternSetIndex;
+    }
+
+    PatternProfile &profile = reader.profiles_[patternIndex];
+    if (profile.line_.empty() &&
+        (!reader.source_->getProfile(patternSetIndex, patternIndex, profile) ||
+         profile.line_.empty() ||
+         profile.isVertical_ !=
+             (patternSet.Direction == DLPC34XX_INT_PAT_DIRECTION_VERTICAL))) {
+        profile.line_.clear();
+        return false;
+    }
+
+    pattern.PixelArray = profile.line_.data();
+    pattern.PixelArrayCount = (uint32_t)profile.line_.size();
+
+    return true;
+}
+
+uint32_t readSourcePattern(uint32_t patternSetIndex, uint32_t patternIndex,
+                           DLPC34XX_INT_PAT_PatternData_s *pattern,
+                           void *userData) {
+    auto reader = static_cast<SourceReader *>(userData);
+    if (reader->isHeaderOnly_ ||
+        !readProfile(*reader, patternSetIndex, patternIndex, *pattern)) {
+        return ERR_PATTERN_SOURCE;
+    }
+
+    return DLPC_SUCCESS;
+}
+} // namespace
+
+uint64_t PatternEncoder::getHash(const bool eastWestFlip,
+                                 const bool longAxisFlip) const {
+    return hashPatterns(eastWestFlip, longAxisFlip,
+                        [&](uint32_t i, uint32_t j,
+                            DLPC34XX_INT_PAT_PatternData_s &pattern) {
+                            pattern = patternSets_[i].PatternArray[j];
+                            return true;
+                        });
+}
+
+uint64_t PatternEncoder::getHash(PatternSource &source,
+                                 const bool eastWestFlip,
+                                 const bool longAxisFlip) const {
+    const uint64_t fingerprint = source.getFingerprint();
+    if (fingerprint == 0) {
+        return 0;
+    }
+
+    // 像素线由图案源的指纹代表，不读取图案
+    uint64_t hash = hashPatterns(eastWestFlip, longAxisFlip,
+                                 [](uint32_t, uint32_t,
+                                    DLPC34XX_INT_PAT_PatternData_s &pattern) {
+                                     pattern.PixelArray = nullptr;
+                                     pattern.PixelArrayCount = 0;
+                                     return true;
+                                 });
+    hash = fnvHash(&fingerprint, sizeof(fingerprint), hash);
+
+    return hash;
+}
+
+uint64_t PatternEncoder::hashPatterns(
+    const bool eastWestFlip, const bool longAxisFlip,
+    const std::function<bool(uint32_t, uint32_t,
+                             DLPC34XX_INT_PAT_PatternData_s &)> &fetch) const {
+    uint64_t hash = kFnvOffsetBasis;
+
+    hashValue(hash, kHashVersion);
+    hashValue(hash, (uint32_t)dmd_);
+    hashValue(hash, eastWestFlip ? 1 : 0);
+    hashValue(hash, longAxisFlip ? 1 : 0);
+
+    hashValue(hash, (uint32_t)patternSets_.size());
+    for (uint32_t i = 0; i < (uint32_t)patternSets_.size(); ++i) {
+        const DLPC34XX_INT_PAT_PatternSet_s &patternSet = patternSets_[i];
+        hashValue(hash, (uint32_t)patternSet.BitDepth);
+        hashValue(hash, (uint32_t)patternSet.Direction);
+        hashValue(hash, (uint32_t)patternSet.ThresholdPixels);
+        hashValue(hash, patternSet.PatternCount);
+        for (uint32_t j = 0; j < patternSet.PatternCount; ++j) {
+            DLPC34XX_INT_PAT_PatternData_s pattern;
+            if (!fetch(i, j, pattern)) {
+                return 0;
+            }
+
+            hashValue(hash, pattern.PixelArrayCount);
+            hash = fnvHash(pattern.PixelArray, pattern.PixelArrayCount, hash);
+        }
+    }
+
+    hashValue(hash, (uint32_t)patternOrderTable_.size());
+    for (const auto &entry : patternOrderTable_) {
+        hashValue(hash, entry.PatternSetIndex);
+        hashValue(hash, entry.NumDisplayPatterns);
+        hashValue(hash, (uint32_t)entry.IlluminationSelect);
+        hashValue(hash, entry.InvertPatterns ? 1 : 0);
+        hashValue(hash, entry.IlluminationTimeInMicroseconds);
+        hashValue(hash, entry.PreIlluminationDarkTimeInMicroseconds);
+        hashValue(hash, entry.PostIlluminationDarkTimeInMicroseconds);
+    }
+
+    return hash;
+}
+
+bool PatternEncoder::encodeSlots(const bool eastWestFlip,
+                                 const bool longAxisFlip) {
+    const uint32_t blockSize = getBlockSize();
+    if (blockSize == UINT32_MAX) {
+        return false;
+    }
+
+    block_.resize(blockSize);
+    if (DLPC34XX_INT_PAT_EncodeBlockLayout(&encoder_, block_.data(),
+                                           blockSize) != DLPC_SUCCESS) {
+        return false;
+    }
+
+    const bool isDualController = encoder_.DMDInfo.RequiresDualController;
+    slots_.clear();
+    for (uint32_t i = 0; i < (uint32_t)patternSets_.size(); ++i) {
+        for (uint32_t j = 0; j < patternSets_[i].PatternCount; ++j) {
+            slots_.push_back({i, j, true});
+            if (isDualController) {
+                slots_.push_back({i, j, false});
+            }
+        }
+    }
+
+    if (!threadPool_) {
+        threadPool_.reset(new ThreadPool(numOfThreads_));
+    }
+
+    std::atomic<bool> isSlotMismatch(false);
+    threadPool_->parallelFor(slots_.size(), [&](size_t index, size_t) {
+        const PatternSlot &slot = slots_[index];
+        const uint32_t offset = DLPC34XX_INT_PAT_GetPatternSlotOffset(
+            &encoder_, slot.patternSetIndex_, slot.patternIndex_,
+            slot.isMaster_);
+
+        if (DLPC34XX_INT_PAT_EncodePatternSlot(
+                &encoder_, slot.patternSetIndex_, slot.patternIndex_,
+                slot.isMaster_, eastWestFlip, longAxisFlip,
+                &block_[offset]) != DLPC_SUCCESS) {
+            isSlotMismatch = true;
+        }
+    });
+
+    // 图案数据与预留的位置大小不一致时，退回顺序编码以保证输出一致
+    if (isSlotMismatch) {
+        block_.clear();
+        return encode(appendBlockData, &block_, eastWestFlip, longAxisFlip);
+    }
+
+    return true;
+}
+
+bool PatternEncoder::encodeBlock(const bool eastWestFlip,
+                                 const bool longAxisFlip) {
+    uint64_t key = 0;
+    if (cache_) {
+        key = getHash(eastWestFlip, longAxisFlip);
+        if (cache_->load(key, getBlockSize(), block_)) {
+            return true;
+        }
+    }
+
+    if (!encodeSlots(eastWestFlip, longAxisFlip)) {
+        return false;
+    }
+
+    if (cache_) {
+        cache_->store(key, block_);
+    }
+
+    return true;
+}
+
+bool PatternEncoder::encodeParallel(
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback callback, void *userData,
+    const bool eastWestFlip, const bool longAxisFlip) {
+    if (callback == nullptr || !encodeBlock(eastWestFlip, longAxisFlip)) {
+        return false;
+    }
+
+    callback((uint32_t)block_.size(), block_.data(), userData);
+
+    return true;
+}
+
+bool PatternEncoder::encodeStream(
+    PatternSource &source,
+    DLPC34XX_INT_PAT_WritePatternDataBlockCallback callback, void *userData,
+    const bool eastWestFlip, const bool longAxisFlip) {
+    if (callback == nullptr) {
+        return false;
+    }
+
+    SourceReader reader = {&source, &patternSets_, UINT32_MAX, {}, false};
+    encoder_.WritePatternDataBlockCallback = callback;
+    encoder_.UserData = userData;
+    DLPC34XX_INT_PAT_SetPatternDataSource(&encoder_, readSourcePattern,
+                                          &reader);
+
+    const uint32_t status = DLPC34XX_INT_PAT_EncodePatternDataBlock(
+        &encoder_, eastWestFlip, longAxisFlip);
+
+    DLPC34XX_INT_PAT_SetPatternDataSource(&encoder_, nullptr, nullptr);
+
+    return status == DLPC_SUCCESS;
+}
+
+bool PatternEncoder::encodeHeader(std::vector<uint8_t> &header) {
+    header.clear();
+
+    // 块头、图案顺序表和集合头都在第一张图案之前输出，读取第一张图案时中止
+    SourceReader reader = {nullptr, &patternSets_, UINT32_MAX, {}, true};
+    encoder_.WritePatternDataBlockCallback = appendBlockData;
+    encoder_.UserData = &header;
+    DLPC34XX_INT_PAT_SetPatternDataSource(&encoder_, readSourcePattern,
+                                          &reader);
+
+    const uint32_t status =
+        DLPC34XX_INT_PAT_EncodePatternDataBlock(&encoder_, false, false);
+
+    DLPC34XX_INT_PAT_SetPatternDataSource(&encoder_, nullptr, nullptr);
+
+    return status == ERR_PATTERN_SOURCE && header.size() == getHeaderSize();
+}
+
+uint32_t PatternEncoder::getHeaderSize() {
+    for (uint32_t i = 0; i < (uint32_t)patternSets_.size(); ++i) {
+        if (patternSets_[i].PatternCount > 0) {
+            return DLPC34XX_INT_PAT_GetPatternSlotOffset(&encoder_, i, 0,
+                                                         true);
+        }
+    }
+
+    return getBlockSize();
+}
+
+void PatternEncoder::setNumOfThreads(const size_t numOfThreads) {
+    if (numOfThreads != numOfThreads_) {
+        numOfThreads_ = numOfThreads;
+        threadPool_.reset();
+    }
+}
+
+} // namespace device
+} // namespace slmaster
@@ -0,0 +1,166 @@
+#include "patternLoader.h"
+
+#include "patternBlockFile.h"
+
+#include <algorithm>
+#include <future>
+
+namespace slmaster {
+namespace device {
+
+PatternLoader::PatternLoader(PatternEncoder &encoder,
+                             FlashProgrammer &flashProgrammer,
+                             const std::function<void()> &prepare,
+                             const std::function<void()> &reload)
+    : encoder_(encoder), flashProgrammer_(flashProgrammer), prepare_(prepare),
+      reload_(reload), numOfPatterns_(0), numOfPatternSets_(0) {}
+
+bool PatternLoader::programBlock(const uint32_t blockSize,
+                                 const uint8_t *header,
+                                 const uint32_t headerSize,
+                                 const uint64_t fingerprint,
+                                 const std::function<bool()> &encodeBlock,
+                                 const std::function<bool()> &writeBlock) {
+    // 超出容量时在擦除前拒绝，flash中原有的图案保持可用
+    if (blockSize > flashProgrammer_.getCapacity()) {
+        return false;
+    }
+
+    if (prepare_) {
+        prepare_();
+    }
+
+    // flash中已是相同的数据块时跳过擦除与烧录
+    if (flashProgrammer_.isProgrammed(fingerprint, header, headerSize)) {
+        reload_();
+        return true;
+    }
+
+    // 烧录中断时flash内容未知
+    flashProgrammer_.setProgrammed(0);
+
+    // 擦除等待期间在后台线程编码，擦除完成后再烧录编码好的数据块
+    std::future<bool> encoding;
+    if (encodeBlock) {
+        encoding = std::async(std::launch::async, encodeBlock);
+    }
+
+    const bool isErased = flashProgrammer_.erase();
+    const bool isEncoded = !encoding.valid() || encoding.get();
+    if (!isErased || !isEncoded) {
+        return false;
+    }
+
+    flashProgrammer_.begin();
+    const bool isSucess = writeBlock();
+    const bool isWritten = flashProgrammer_.finish();
+    if (!isSucess || !isWritten) {
+        return false;
+    }
+
+    flashProgrammer_.setProgrammed(fingerprint);
+
+    reload_();
+
+    return true;
+}
+
+bool PatternLoader::populate(const std::vector<PatternProfileSet> &table) {
+    if (!encoder_.build(table)) {
+        return false;
+    }
+
+    numOfPatternSets_ = encoder_.getNumOfPatternSets();
+    numOfPatterns_ = encoder_.getNumOfPatterns();
+
+    // 头部与指纹不需要编码像素，数据块在擦除期间编码，已烧录时不编码
+    std::vector<uint8_t> header;
+    if (!encoder_.encodeHeader(header)) {
+        return false;
+    }
+
+    const std::vector<uint8_t> &block = encoder_.getBlock();
+    return programBlock(
+        encoder_.getBlockSize(), header.data(), (uint32_t)header.size(),
+        encoder_.getHash(), [&] { return encoder_.encodeBlock(); },
+        [&] {
+            flashProgrammer_.write((uint32_t)block.size(),
+                                   const_cast<uint8_t *>(block.data()));
+            return true;
+        });
+}
+
+bool PatternLoader::populate(PatternSource &source) {
+    if (!encoder_.build(source)) {
+        return false;
+    }
+
+    numOfPatternSets_ = encoder_.getNumOfPatternSets();
+    numOfPatterns_ = encoder_.getNumOfPatterns();
+
+    std::vector<uint8_t> header;
+    if (!encoder_.encodeHeader(header)) {
+        return false;
+    }
+
+    // 指纹不读取图案；图案源不提供指纹时为0，总是擦除并烧录
+    return programBlock(
+        encoder_.getBlockSize(), header.data(), (uint32_t)header.size(),
+        encoder_.getHash(source), nullptr, [&] {
+            return encoder_.encodeStream(
+                source, FlashProgrammer::writePatternData, &flashProgrammer_);
+        });
+}
+
+bool PatternLoader::loadFile(const std::string &path) {
+    PatternBlockFile file;
+    if (!file.open(path) || file.getDMD() != encoder_.getDMD()) {
+        return false;
+    }
+
+    numOfPatternSets_ = file.getNumOfPatternSets();
+    numOfPatterns_ = file.getNumOfPatterns();
+
+    return programBlock(
+        file.getBlockSize(), file.getBlock(), file.getHeaderSize(),
+        file.getHash(), nullptr, [&] {
+            flashProgrammer_.write(file.getBlockSize(),
+                                   const_cast<uint8_t *>(file.getBlock()));
+            return true;
+        });
+}
+
+bool PatternLoader::plan(const std::vector<PatternProfileSet> &table,
+                         PatternTablePlan &plan) const {
+    plan = PatternTablePlan();
+    plan.flashCapacity_ = flashProgrammer_.getCapacity();
+
+    // 使用独立的编码器，不影响正在投影的图案表
+    PatternEncoder encoder(encoder_.getDMD());
+    if (!encoder.build(table)) {
+        return false;
+    }
+
+    plan.blockSize_ = encoder.getBlockSize();
+    plan.isValid_ = plan.blockSize_ != UINT32_MAX;
+    plan.isFitFlash_ = plan.isValid_ && plan.blockSize_ <= plan.flashCapacity_;
+    if (!plan.isFitFlash_) {
+        return false;
+    }
+
+    plan.isProgrammed_ = flashProgrammer_.getProgrammed() != 0 &&
+                         flashProgrammer_.getProgrammed() == encoder.getHash();
+    // 已烧录时只读回整个头部与起始数据校验
+    plan.estimatedSeconds_ =
+        plan.isProgrammed_
+            ? std::max(encoder.getHeaderSize(),
+                       std::min<uint32_t>(plan.blockSize_,
+                                          FLASH_VERIFY_BYTES)) /
+                  flashProgrammer_.getWriteThroughput()
+            : flashProgrammer_.estimateSeconds(plan.blockSize_);
+
+    return true;
+}
+
+} // namespace device
+} // namespace slmaster
@@ -2,11 +2,26 @@
 
 #include "common.hpp"
 
-#include "CyUSBSerial.h"
-
 namespace slmaster {
 namespace device {
 
+namespace {
+// I2C时钟协商时每个速率连续读取控制器ID的次数
+constexpr int kLinkTestReads = 16;
+
+bool testI2CLink(const DLPC34XX_ControllerDeviceId_e expected) {
+    for (int i = 0; i < kLinkTestReads; ++i) {
+        DLPC34XX_ControllerDeviceId_e deviceId;
+        if (DLPC34XX_ReadControllerDeviceId(&deviceId) != SUCCESS ||
+            deviceId != expected) {
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace
+
 void ProjectorDlpc34xx::loadPatternOrderTableEntryFromFlash() {
     DLPC34XX_PatternOrderTableEntry_s PatternOrderTableEntry;
 
@@ -15,32 +30,63 @@ void ProjectorDlpc34xx::loadPatternOrderTableEntryFromFlash() {
 }
 
 bool ProjectorDlpc34xx::initConnectionAndCommandLayer() {
-    DLPC_COMMON_InitCommandLibrary(s_WriteBuffer, sizeof(s_WriteBuffer),
-                                   s_ReadBuffer, sizeof(s_ReadBuffer), writeI2C,
-                                   readI2C);
+    writeBuffer_.assign(flashProgrammer_.getMaxChunkSize() + CMD_HEADER_SIZE,
+                        0);
+    readBuffer_.assign(MAX_READ_CMD_PAYLOAD, 0);
+    commandContext_.init(transport_.get(), writeBuffer_.data(),
+                         (uint16_t)writeBuffer_.size(), readBuffer_.data(),
+                         (uint16_t)readBuffer_.size());
 
-    isInitial_ = CYPRESS_I2C_ConnectToCyI2C();
+    isInitial_ = transport_->open();
 
     return isInitial_;
 }
 
-ProjectorDlpc34xx::ProjectorDlpc34xx() : isInitial_(false) {
+ProjectorDlpc34xx::ProjectorDlpc34xx()
+    : isInitial_(false), patternEncoder_(DLPC34XX_INT_PAT_DMD_DLP4710),
+      flashProgrammer_(false),
+      patternLoader_(
+          patternEncoder_, flashProgrammer_,
+          [] { DLPC34XX_WriteInternalPatternControl(DLPC34XX_PC_STOP, 0); },
+          [this] { loadPatternOrderTableEntryFromFlash(); }),
+      transport_(std::make_shared<CypressTransport>()),
+      executor_(commandContext_) {
     cols_ = DLP3010_WIDTH;
     rows_ = DLP3010_HEIGHT;
+
+    // 擦除与烧录的间隙插入排队的步进等关键命令
+    flashProgrammer_.setIdleHook(
+        [this](const std::chrono::steady_clock::time_point until) {
+            executor_.runUrgentUntil(until);
+        });
 }
 
 bool ProjectorDlpc34xx::connect() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return connect(); });
+    }
+
     bool isInitSucess = initConnectionAndCommandLayer();
     if (!isInitSucess) {
         printf("init DLPC-USB connection error! \n");
         return false;
     }
 
-    if (!CYPRESS_I2C_RequestI2CBusAccess()) {
-        printf("Error request I2C bus access! \n");
-        return false;
+    // 桥接芯片未指定序列号时，连接后才能确定设备标识
+    updateFingerprintFile();
+
+    // 以标准速率读取的控制器ID为参照，尝试更高的I2C时钟
+    DLPC34XX_ControllerDeviceId_e DeviceId;
+    if (DLPC34XX_ReadControllerDeviceId(&DeviceId) == SUCCESS) {
+        transport_->negotiateClockFrequency(
+            [&] { return testI2CLink(DeviceId); });
     }
 
+    // 链路检查需要实际读取控制器，之后再使用寄存器影子
+    registerShadow_.invalidate();
+    commandContext_.setShadow(&registerShadow_);
+
     loadPatternOrderTableEntryFromFlash();
 
     //DLPC34XX_WriteInputImageSize(cols_, rows_);
@@ -62,131 +108,100 @@ bool ProjectorDlpc34xx::connect() {
 }
 
 bool ProjectorDlpc34xx::disConnect() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return disConnect(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
 
-    uint8_t numDevices;
-    CyGetListofDevices(&numDevices);
-    for (size_t i = 0; i < numDevices; ++i) {
-        CY_DEVICE_INFO deviceInfo;
-        CyGetDeviceInfo(i, &deviceInfo);
-        CY_HANDLE handle;
-        unsigned char sig[6];
-        if(deviceInfo.deviceType[i] == CY_DEVICE_TYPE::CY_TYPE_I2C && deviceInfo.deviceClass[i] == CY_CLASS_VENDOR) {
-            if (CY_SUCCESS == CyOpen(i, 0, &handle)) {
-                CyClose(handle);
-                break;
-            }
-        }
-    }
-    
+    commandContext_.setShadow(nullptr);
+    registerShadow_.invalidate();
+    transport_->close();
+    isInitial_ = false;
+
     return true;
 }
 
 bool ProjectorDlpc34xx::isConnect() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return isConnect(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
 
     DLPC34XX_ShortStatus_s shortStatus;
-    DLPC34XX_ReadShortStatus(&shortStatus);
-    return shortStatus.SystemError == DLPC34XX_E_NO_ERROR;
+    if (DLPC34XX_ReadShortStatus(&shortStatus) != SUCCESS ||
+        shortStatus.SystemError != DLPC34XX_E_NO_ERROR) {
+        return false;
+    }
+
+    return true;
 }
 
 bool ProjectorDlpc34xx::populatePatternTableData(
-    std::vector<PatternOrderSet> table) {
+    const std::vector<PatternProfileSet> &table) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Background,
+                                 [&] { return populatePatternTableData(table); });
+    }
+
     if (!isConnect()) {
         return false;
     }
 
-    numOfPatternSets_ = table.size();
-    numOfPatterns_ = 0;
-    for (size_t i = 0; i < table.size(); ++i) {
-        numOfPatterns_ += table[i].imgs_.size();
-    }
-
-    DLPC34XX_INT_PAT_PatternData_s *patterns =
-        new DLPC34XX_INT_PAT_PatternData_s[numOfPatterns_];
-    DLPC34XX_INT_PAT_PatternSet_s *patternSets =
-        new DLPC34XX_INT_PAT_PatternSet_s[numOfPatternSets_];
-    DLPC34XX_INT_PAT_PatternOrderTableEntry_s *patternOrderTableEntries =
-        new DLPC34XX_INT_PAT_PatternOrderTableEntry_s[numOfPatternSets_];
-
-    int indexOfPattern = 0;
-    for (size_t i = 0; i < table.size(); ++i) {
-        patternSets[i].BitDepth = table[i].isOneBit_ == true
-                                      ? DLPC34XX_INT_PAT_BITDEPTH_ONE
-                                      : DLPC34XX_INT_PAT_BITDEPTH_EIGHT;
-        patternSets[i].Direction = table[i].isVertical_ == true
-                                       ? DLPC34XX_INT_PAT_DIRECTION_VERTICAL
-                                       : DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL;
-        patternSets[i].PatternArray = &patterns[indexOfPattern];
-        patternSets[i].PatternCount = table[i].imgs_.size();
-
-        for (size_t j = 0; j < table[i].imgs_.size(); ++j) {
-            patterns[indexOfPattern].PixelArrayCount =
-                table[i].patternArrayCounts_;
-
-            table[i].imgs_[j] = table[i].isVertical_ ? table[i].imgs_[j] : table[i].imgs_[j].t();
-            patterns[indexOfPattern].PixelArray = table[i].imgs_[j].data;
-            ++indexOfPattern;
-        }
+    return patternLoader_.populate(table);
+}
 
-        patternOrderTableEntries[i].PatternSetIndex = i;
-        patternOrderTableEntries[i].NumDisplayPatterns =
-            patternSets[i].PatternCount;
-        patternOrderTableEntries[i].IlluminationSelect =
-            (table[i].illumination_ == Red ? DLPC34XX_INT_PAT_ILLUMINATION_RED
-             : table[i].illumination_ == Grren
-                 ? DLPC34XX_INT_PAT_ILLUMINATION_GREEN
-                 : table[i].illumination_ == Blue ? DLPC34XX_INT_PAT_ILLUMINATION_BLUE : DLPC34XX_INT_PAT_ILLUMINATION_RGB);
-        patternOrderTableEntries[i].InvertPatterns = false;
-        patternOrderTableEntries[i].IlluminationTimeInMicroseconds =
-            table[i].exposureTime_;
-        patternOrderTableEntries[i].PreIlluminationDarkTimeInMicroseconds =
-            table[i].preExposureTime_;
-        patternOrderTableEntries[i].PostIlluminationDarkTimeInMicroseconds =
-            table[i].postExposureTime_;
+bool ProjectorDlpc34xx::loadPatternBlockFile(const std::string &path) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Background,
+                                 [&] { return loadPatternBlockFile(path); });
     }
 
-    DLPC34XX_WriteInternalPatternControl(DLPC34XX_PC_STOP, 0);
-
-    s_StartProgramming = true;
-    s_FlashProgramBufferPtr = 0;
-
-    DLPC34XX_WriteFlashDataTypeSelect(
-        DLPC34XX_FDTS_ENTIRE_SENS_PATTERN_DATA);
-    DLPC34XX_WriteFlashErase();
-    DLPC34XX_ShortStatus_s ShortStatus;
-    do {
-        DLPC34XX_ReadShortStatus(&ShortStatus);
-    } while (ShortStatus.FlashEraseComplete == DLPC34XX_FE_NOT_COMPLETE);
-
-    DLPC34XX_WriteFlashDataLength(sizeof(s_FlashProgramBuffer));
+    if (!isConnect()) {
+        return false;
+    }
 
-    DLPC34XX_INT_PAT_GeneratePatternDataBlock(
-        DLPC34XX_INT_PAT_DMD_DLP4710, numOfPatternSets_, patternSets,
-        numOfPatternSets_, patternOrderTableEntries,
-        bufferPatternDataAndProgramToFlash, false, false);
-    if (s_FlashProgramBufferPtr > 0) {
-        DLPC34XX_WriteFlashDataLength(s_FlashProgramBufferPtr);
+    return patternLoader_.loadFile(path);
+}
 
-        programFlashWithDataInBuffer(s_FlashProgramBufferPtr);
+bool ProjectorDlpc34xx::populatePatternTableData(PatternSource &source) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Background,
+                                 [&] { return populatePatternTableData(source); });
     }
 
-    loadPatternOrderTableEntryFromFlash();
+    if (!isConnect()) {
+        return false;
+    }
 
-    s_StartProgramming = false;
+    return patternLoader_.populate(source);
+}
 
-    delete[] patternOrderTableEntries;
-    delete[] patternSets;
-    delete[] patterns;
+std::future<bool>
+ProjectorDlpc34xx::populatePatternTableDataAsync(PatternSource &source) {
+    return executor_.submit(CommandPriority::Background, [this, &source] {
+        return populatePatternTableData(source);
+    });
+}
 
-    return true;
+bool ProjectorDlpc34xx::planPatternTableData(
+    const std::vector<PatternProfileSet> &table, PatternTablePlan &plan) {
+    return patternLoader_.plan(table, plan);
 }
 
 bool ProjectorDlpc34xx::project(const bool isContinue) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return project(isContinue); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -205,6 +220,11 @@ bool ProjectorDlpc34xx::project(const bool isContinue) {
 }
 
 bool ProjectorDlpc34xx::stop() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return stop(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -213,6 +233,11 @@ bool ProjectorDlpc34xx::stop() {
 }
 
 bool ProjectorDlpc34xx::pause() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return pause(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -222,6 +247,11 @@ bool ProjectorDlpc34xx::pause() {
 }
 
 bool ProjectorDlpc34xx::resume() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return resume(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -231,6 +261,11 @@ bool ProjectorDlpc34xx::resume() {
 }
 
 bool ProjectorDlpc34xx::step() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return step(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -239,8 +274,28 @@ bool ProjectorDlpc34xx::step() {
            SUCCESS;
 }
 
+std::future<bool> ProjectorDlpc34xx::projectAsync(const bool isContinue) {
+    return executor_.submit(CommandPriority::Critical,
+                            [this, isContinue] { return project(isContinue); });
+}
+
+std::future<bool> ProjectorDlpc34xx::stopAsync() {
+    return executor_.submit(CommandPriority::Critical,
+                            [this] { return stop(); });
+}
+
+std::future<bool> ProjectorDlpc34xx::stepAsync() {
+    return executor_.submit(CommandPriority::Critical,
+                            [this] { return step(); });
+}
+
 bool ProjectorDlpc34xx::getLEDCurrent(OUT double &r, OUT double &g,
                                       OUT double &b) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return getLEDCurrent(r, g, b); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -257,6 +312,11 @@ bool ProjectorDlpc34xx::getLEDCurrent(OUT double &r, OUT double &g,
 
 bool ProjectorDlpc34xx::setLEDCurrent(IN const double r, IN const double g,
                                       IN const double b) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return setLEDCurrent(r, g, b); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -271,6 +331,11 @@ bool ProjectorDlpc34xx::setLEDCurrent(IN const double r, IN const double g,
 }
 
 int ProjectorDlpc34xx::getFlashImgsNum() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return getFlashImgsNum(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
@@ -281,28 +346,73 @@ int ProjectorDlpc34xx::getFlashImgsNum() {
     return status.NumPatDisplayedFromPatSet;
 }
 
+bool ProjectorDlpc34xx::setPatternCacheDirectory(
+    const std::string &directory) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal, [&] {
+            return setPatternCacheDirectory(directory);
+        });
+    }
+
+    if (directory.empty()) {
+        patternEncoder_.setCache(nullptr);
+        patternCacheDirectory_.clear();
+        updateFingerprintFile();
+        return true;
+    }
+
+    auto cache = std::make_shared<PatternBlockCache>(directory);
+    if (!cache->isValid()) {
+        return false;
+    }
+
+    patternEncoder_.setCache(cache);
+    patternCacheDirectory_ = directory;
+    updateFingerprintFile();
+
+    return true;
+}
+
+void ProjectorDlpc34xx::updateFingerprintFile() {
+    // 记录flash中数据块的指纹，重启后仍可跳过烧录；记录按设备标识区分，
+    // 共用缓存目录的投影仪互不影响，标识未知时只记录在内存中
+    flashProgrammer_.setFingerprintFile(FlashProgrammer::getFingerprintFilePath(
+        patternCacheDirectory_, "DLPC34xx", transport_->getIdentity()));
+}
+
+PatternCacheStats ProjectorDlpc34xx::getPatternCacheStats() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return getPatternCacheStats(); });
+    }
+
+    auto cache = patternEncoder_.getCache();
+
+    return cache ? cache->getStats() : PatternCacheStats();
+}
+
+FlashProgramStats ProjectorDlpc34xx::getFlashProgramStats() {
+    return flashProgrammer_.getStats();
+}
+
 ProjectorDlpc34xx::~ProjectorDlpc34xx() {
 }
 
+void ProjectorDlpc34xx::setTransport(
+    const std::shared_ptr<Transport> &transport) {
+    if (transport) {
+        transport_ = transport;
+    }
+}
+
 ProjectorInfo ProjectorDlpc34xx::getInfo() {
     ProjectorInfo projectorInfo;
     projectorInfo.dlpEvmType_ = "DLP4710";
     projectorInfo.width_ = cols_;
     projectorInfo.height_ = rows_;
-    projectorInfo.isFind_ = false;
-
-    uint8_t numDevices;
-    CyGetListofDevices(&numDevices);
-    for (size_t i = 0; i < numDevices; ++i) {
-        CY_DEVICE_INFO deviceInfo;
-        CyGetDeviceInfo(i, &deviceInfo);
-        CY_HANDLE handle;
-        unsigned char sig[6];
-        if(deviceInfo.deviceType[i] == CY_DEVICE_TYPE::CY_TYPE_I2C && deviceInfo.deviceClass[i] == CY_CLASS_VENDOR) {
-            projectorInfo.isFind_ = true;
-            break;
-        }
-    }
+    projectorInfo.isFind_ = transport_->isPresent();
+    projectorInfo.i2cClockFrequency_ =
+        isInitial_ ? transport_->getClockFrequency() : 0;
 
     return projectorInfo;
 }
@@ -1,12 +1,27 @@
 #include "projectorDlpc34xxDual.h"
 
-#include "CyUSBSerial.h"
-
 #include "common.hpp"
 
 namespace slmaster {
 namespace device {
 
+namespace {
+// I2C时钟协商时每个速率连续读取控制器ID的次数
+constexpr int kLinkTestReads = 16;
+
+bool testI2CLink(const DLPC34XX_DUAL_ControllerDeviceId_e expected) {
+    for (int i = 0; i < kLinkTestReads; ++i) {
+        DLPC34XX_DUAL_ControllerDeviceId_e deviceId;
+        if (DLPC34XX_DUAL_ReadControllerDeviceId(&deviceId) != SUCCESS ||
+            deviceId != expected) {
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace
+
 void ProjectorDlpc34xxDual::loadPatternOrderTableEntryFromFlash() {
     DLPC34XX_DUAL_PatternOrderTableEntry_s PatternOrderTableEntry;
 
@@ -15,34 +30,60 @@ void ProjectorDlpc34xxDual::loadPatternOrderTableEntryFromFlash() {
 }
 
 bool ProjectorDlpc34xxDual::initConnectionAndCommandLayer() {
-    DLPC_COMMON_InitCommandLibrary(s_WriteBuffer, sizeof(s_WriteBuffer),
-                                   s_ReadBuffer, sizeof(s_ReadBuffer), writeI2C,
-                                   readI2C);
+    writeBuffer_.assign(flashProgrammer_.getMaxChunkSize() + CMD_HEADER_SIZE,
+                        0);
+    readBuffer_.assign(MAX_READ_CMD_PAYLOAD, 0);
+    commandContext_.init(transport_.get(), writeBuffer_.data(),
+                         (uint16_t)writeBuffer_.size(), readBuffer_.data(),
+                         (uint16_t)readBuffer_.size());
 
-    isInitial_ = CYPRESS_I2C_ConnectToCyI2C();
+    isInitial_ = transport_->open();
 
     return isInitial_;
 }
 
-ProjectorDlpc34xxDual::ProjectorDlpc34xxDual() : isInitial_(false) {
+ProjectorDlpc34xxDual::ProjectorDlpc34xxDual()
+    : isInitial_(false), patternEncoder_(DLPC34XX_INT_PAT_DMD_DLP4710),
+      flashProgrammer_(true),
+      patternLoader_(patternEncoder_, flashProgrammer_, nullptr,
+                     [this] { loadPatternOrderTableEntryFromFlash(); }),
+      transport_(std::make_shared<CypressTransport>()),
+      executor_(commandContext_) {
     cols_ = DLP4710_WIDTH;
     rows_ = DLP4710_HEIGHT;
+
+    // 擦除与烧录的间隙插入排队的步进等关键命令
+    flashProgrammer_.setIdleHook(
+        [this](const std::chrono::steady_clock::time_point until) {
+            executor_.runUrgentUntil(until);
+        });
 }
 
 bool ProjectorDlpc34xxDual::connect() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return connect(); });
+    }
+
     bool isInitSucess = initConnectionAndCommandLayer();
     if (!isInitSucess) {
         printf("init DLPC-USB connection error! \n");
         return false;
     }
 
-    if (!CYPRESS_I2C_RequestI2CBusAccess()) {
-        printf("Error request I2C bus access! \n");
-        return false;
-    }
+    // 桥接芯片未指定序列号时，连接后才能确定设备标识
+    updateFingerprintFile();
 
+    // 以标准速率读取的控制器ID为参照，尝试更高的I2C时钟
     DLPC34XX_DUAL_ControllerDeviceId_e DeviceId;
-    DLPC34XX_DUAL_ReadControllerDeviceId(&DeviceId);
+    if (DLPC34XX_DUAL_ReadControllerDeviceId(&DeviceId) == SUCCESS) {
+        transport_->negotiateClockFrequency(
+            [&] { return testI2CLink(DeviceId); });
+    }
+
+    // 链路检查需要实际读取控制器，之后再使用寄存器影子
+    registerShadow_.invalidate();
+    commandContext_.setShadow(&registerShadow_);
 
     DLPC34XX_DUAL_WriteInternalPatternControl(DLPC34XX_DUAL_PC_STOP, 0);
     DLPC34XX_DUAL_WriteTriggerOutConfiguration(
@@ -65,132 +106,174 @@ bool ProjectorDlpc34xxDual::connect() {
 }
 
 bool ProjectorDlpc34xxDual::disConnect() {
+    // 在执行线程外停止，后台检查线程可能正在等待执行线程
+    if (!executor_.isInTask()) {
+        healthMonitor_.stop();
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return disConnect(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
 
-    uint8_t numDevices;
-    CyGetListofDevices(&numDevices);
-    for (size_t i = 0; i < numDevices; ++i) {
-        CY_DEVICE_INFO deviceInfo;
-        CyGetDeviceInfo(i, &deviceInfo);
-        CY_HANDLE handle;
-        unsigned char sig[6];
-        if(deviceInfo.deviceType[i] == CY_DEVICE_TYPE::CY_TYPE_I2C && deviceInfo.deviceClass[i] == CY_CLASS_VENDOR) {
-            if (CY_SUCCESS == CyOpen(i, 0, &handle)) {
-                CyClose(handle);
-                break;
-            }
-        }
-    }
+    commandContext_.setShadow(nullptr);
+    registerShadow_.invalidate();
+    transport_->close();
+    isInitial_ = false;
 
     return true;
 }
 
 bool ProjectorDlpc34xxDual::isConnect() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return isConnect(); });
+    }
+
     if(!isInitial_) {
         return false;
     }
 
     DLPC34XX_DUAL_ShortStatus_s shortStatus;
-    DLPC34XX_DUAL_ReadShortStatus(&shortStatus);
-    return shortStatus.SystemError == DLPC34XX_DUAL_E_NO_ERROR;
+    if (DLPC34XX_DUAL_ReadShortStatus(&shortStatus) != SUCCESS ||
+        shortStatus.SystemError != DLPC34XX_DUAL_E_NO_ERROR) {
+        return false;
+    }
+
+    return true;
 }
 
+bool ProjectorDlpc34xxDual::isReady() {
+    if (!isInitial_) {
+        return false;
+    }
+
+    // 快速控制时由后台线程检查状态
+    if (healthMonitor_.isRunning()) {
+        return !healthMonitor_.isFaulted();
+    }
+
+    return isConnect();
+}
+
+bool ProjectorDlpc34xxDual::checkHealth(ProjectorFault &fault) {
+    // 不与控制命令争用链路，有命令在执行或排队时跳过本次检查
+    if (!executor_.isInTask()) {
+        return !executor_.isBusy() &&
+               executor_.execute(CommandPriority::Background,
+                                 [&] { return checkHealth(fault); });
+    }
+
+    if (!isInitial_) {
+        return false;
+    }
+
+    DLPC34XX_DUAL_ShortStatus_s shortStatus;
+    if (DLPC34XX_DUAL_ReadShortStatus(&shortStatus) != SUCCESS) {
+        fault.isLinkLost_ = true;
+        return true;
+    }
+
+    fault.isSystemError_ = shortStatus.SystemError != DLPC34XX_DUAL_E_NO_ERROR;
+    fault.isCommunicationError_ =
+        shortStatus.CommunicationError != DLPC34XX_DUAL_E_NO_ERROR;
+
+    DLPC34XX_DUAL_SystemStatus_s systemStatus;
+    if (DLPC34XX_DUAL_ReadSystemStatus(&systemStatus) != SUCCESS) {
+        fault.isLinkLost_ = true;
+        return true;
+    }
+
+    fault.isDmdError_ =
+        systemStatus.DmdDeviceError != DLPC34XX_DUAL_E_NO_ERROR ||
+        systemStatus.DmdInterfaceError != DLPC34XX_DUAL_E_NO_ERROR ||
+        systemStatus.DmdTrainingError != DLPC34XX_DUAL_E_NO_ERROR;
+    fault.isLedError_ = systemStatus.RedLedError != DLPC34XX_DUAL_E_NO_ERROR ||
+                        systemStatus.GreenLedError != DLPC34XX_DUAL_E_NO_ERROR ||
+                        systemStatus.BlueLedError != DLPC34XX_DUAL_E_NO_ERROR;
+    fault.isSequenceError_ =
+        systemStatus.SequenceAbortError != DLPC34XX_DUAL_E_NO_ERROR ||
+        systemStatus.SequenceError != DLPC34XX_DUAL_E_NO_ERROR;
+
+    return true;
+}
+
+bool ProjectorDlpc34xxDual::enableFastControl(
+    const std::chrono::milliseconds interval,
+    const ProjectorFaultCallback &onFault) {
+    if (!isConnect()) {
+        return false;
+    }
+
+    healthMonitor_.start(
+        interval, [&](ProjectorFault &fault) { return checkHealth(fault); },
+        onFault);
+
+    return true;
+}
+
+void ProjectorDlpc34xxDual::disableFastControl() { healthMonitor_.stop(); }
+
 bool ProjectorDlpc34xxDual::populatePatternTableData(
-    std::vector<PatternOrderSet> table) {
+    const std::vector<PatternProfileSet> &table) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Background,
+                                 [&] { return populatePatternTableData(table); });
+    }
+
     if (!isConnect()) {
         return false;
     }
 
-    numOfPatternSets_ = table.size();
-    numOfPatterns_ = 0;
-    for (size_t i = 0; i < table.size(); ++i) {
-        numOfPatterns_ += table[i].imgs_.size();
-    }
-
-    DLPC34XX_INT_PAT_PatternData_s *patterns =
-        new DLPC34XX_INT_PAT_PatternData_s[numOfPatterns_];
-    DLPC34XX_INT_PAT_PatternSet_s *patternSets =
-        new DLPC34XX_INT_PAT_PatternSet_s[numOfPatternSets_];
-    DLPC34XX_INT_PAT_PatternOrderTableEntry_s *patternOrderTableEntries =
-        new DLPC34XX_INT_PAT_PatternOrderTableEntry_s[numOfPatternSets_];
-
-    int indexOfPattern = 0;
-    for (size_t i = 0; i < table.size(); ++i) {
-        patternSets[i].BitDepth = table[i].isOneBit_ == true
-                                      ? DLPC34XX_INT_PAT_BITDEPTH_ONE
-                                      : DLPC34XX_INT_PAT_BITDEPTH_EIGHT;
-        patternSets[i].Direction = table[i].isVertical_ == true
-                                       ? DLPC34XX_INT_PAT_DIRECTION_VERTICAL
-                                       : DLPC34XX_INT_PAT_DIRECTION_HORIZONTAL;
-        patternSets[i].PatternArray = &patterns[indexOfPattern];
-        patternSets[i].PatternCount = table[i].imgs_.size();
-
-        for (size_t j = 0; j < table[i].imgs_.size(); ++j) {
-            patterns[indexOfPattern].PixelArrayCount =
-                table[i].patternArrayCounts_;
-
-            if(table[i].isOneBit_) {
-                table[i].imgs_[j] = table[i].imgs_[j] / 255;
-            }
-
-            table[i].imgs_[j] = table[i].isVertical_ ? table[i].imgs_[j] : table[i].imgs_[j].t();
-            patterns[indexOfPattern].PixelArray = table[i].imgs_[j].data;
-            ++indexOfPattern;
-        }
+    return patternLoader_.populate(table);
+}
 
-        patternOrderTableEntries[i].PatternSetIndex = i;
-        patternOrderTableEntries[i].NumDisplayPatterns =
-            patternSets[i].PatternCount;
-         patternOrderTableEntries[i].IlluminationSelect =
-            (table[i].illumination_ == Red ? DLPC34XX_INT_PAT_ILLUMINATION_RED
-             : table[i].illumination_ == Grren
-                 ? DLPC34XX_INT_PAT_ILLUMINATION_GREEN
-                 : table[i].illumination_ == Blue ? DLPC34XX_INT_PAT_ILLUMINATION_BLUE : DLPC34XX_INT_PAT_ILLUMINATION_RGB);
-        patternOrderTableEntries[i].InvertPatterns = false;
-        patternOrderTableEntries[i].IlluminationTimeInMicroseconds =
-            table[i].exposureTime_;
-        patternOrderTableEntries[i].PreIlluminationDarkTimeInMicroseconds =
-            table[i].preExposureTime_;
-        patternOrderTableEntries[i].PostIlluminationDarkTimeInMicroseconds =
-            table[i].postExposureTime_;
-    }
-
-    s_StartProgramming = true;
-    s_FlashProgramBufferPtr = 0;
-
-    DLPC34XX_DUAL_WriteFlashDataTypeSelect(
-        DLPC34XX_DUAL_FDTS_ENTIRE_SENS_PATTERN_DATA);
-    DLPC34XX_DUAL_WriteFlashErase();
-    DLPC34XX_DUAL_ShortStatus_s ShortStatus;
-    do {
-        DLPC34XX_DUAL_ReadShortStatus(&ShortStatus);
-    } while (ShortStatus.FlashEraseComplete == DLPC34XX_DUAL_FE_NOT_COMPLETE);
-
-    DLPC34XX_DUAL_WriteFlashDataLength(sizeof(s_FlashProgramBuffer));
-
-    DLPC34XX_INT_PAT_GeneratePatternDataBlock(
-        DLPC34XX_INT_PAT_DMD_DLP4710, numOfPatternSets_, patternSets,
-        numOfPatternSets_, patternOrderTableEntries,
-        bufferDualPatternDataAndProgramToFlash, false, false);
-    if (s_FlashProgramBufferPtr > 0) {
-        DLPC34XX_DUAL_WriteFlashDataLength(s_FlashProgramBufferPtr);
-
-        programDualFlashWithDataInBuffer(s_FlashProgramBufferPtr);
+bool ProjectorDlpc34xxDual::loadPatternBlockFile(const std::string &path) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Background,
+                                 [&] { return loadPatternBlockFile(path); });
     }
 
-    loadPatternOrderTableEntryFromFlash();
+    if (!isConnect()) {
+        return false;
+    }
+
+    return patternLoader_.loadFile(path);
+}
 
-    delete[] patternOrderTableEntries;
-    delete[] patternSets;
-    delete[] patterns;
+bool ProjectorDlpc34xxDual::populatePatternTableData(PatternSource &source) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Background,
+                                 [&] { return populatePatternTableData(source); });
+    }
 
-    return true;
+    if (!isConnect()) {
+        return false;
+    }
+
+    return patternLoader_.populate(source);
+}
+
+std::future<bool>
+ProjectorDlpc34xxDual::populatePatternTableDataAsync(PatternSource &source) {
+    return executor_.submit(CommandPriority::Background, [this, &source] {
+        return populatePatternTableData(source);
+    });
+}
+
+bool ProjectorDlpc34xxDual::planPatternTableData(
+    const std::vector<PatternProfileSet> &table, PatternTablePlan &plan) {
+    return patternLoader_.plan(table, plan);
 }
 
 bool ProjectorDlpc34xxDual::project(const bool isContinue) {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return project(isContinue); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -206,7 +289,12 @@ bool ProjectorDlpc34xxDual::project(const bool isContinue) {
 }
 
 bool ProjectorDlpc34xxDual::stop() {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return stop(); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -215,7 +303,12 @@ bool ProjectorDlpc34xxDual::stop() {
 }
 
 bool ProjectorDlpc34xxDual::pause() {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return pause(); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -224,7 +317,12 @@ bool ProjectorDlpc34xxDual::pause() {
 }
 
 bool ProjectorDlpc34xxDual::resume() {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return resume(); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -233,7 +331,12 @@ bool ProjectorDlpc34xxDual::resume() {
 }
 
 bool ProjectorDlpc34xxDual::step() {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Critical,
+                                 [&] { return step(); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -241,9 +344,29 @@ bool ProjectorDlpc34xxDual::step() {
                                                      0xff) == SUCCESS;
 }
 
+std::future<bool> ProjectorDlpc34xxDual::projectAsync(const bool isContinue) {
+    return executor_.submit(CommandPriority::Critical,
+                            [this, isContinue] { return project(isContinue); });
+}
+
+std::future<bool> ProjectorDlpc34xxDual::stopAsync() {
+    return executor_.submit(CommandPriority::Critical,
+                            [this] { return stop(); });
+}
+
+std::future<bool> ProjectorDlpc34xxDual::stepAsync() {
+    return executor_.submit(CommandPriority::Critical,
+                            [this] { return step(); });
+}
+
 bool ProjectorDlpc34xxDual::getLEDCurrent(OUT double &r, OUT double &g,
                                           OUT double &b) {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return getLEDCurrent(r, g, b); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -259,7 +382,12 @@ bool ProjectorDlpc34xxDual::getLEDCurrent(OUT double &r, OUT double &g,
 
 bool ProjectorDlpc34xxDual::setLEDCurrent(IN const double r, IN const double g,
                                           IN const double b) {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return setLEDCurrent(r, g, b); });
+    }
+
+    if (!isReady()) {
         return false;
     }
 
@@ -273,7 +401,12 @@ bool ProjectorDlpc34xxDual::setLEDCurrent(IN const double r, IN const double g,
 }
 
 int ProjectorDlpc34xxDual::getFlashImgsNum() {
-    if (!isConnect()) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return getFlashImgsNum(); });
+    }
+
+    if (!isReady()) {
         return -1;
     }
 
@@ -283,30 +416,73 @@ int ProjectorDlpc34xxDual::getFlashImgsNum() {
     return status.NumPatDisplayedFromPatSet;
 }
 
-ProjectorDlpc34xxDual::~ProjectorDlpc34xxDual() {
+bool ProjectorDlpc34xxDual::setPatternCacheDirectory(
+    const std::string &directory) {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal, [&] {
+            return setPatternCacheDirectory(directory);
+        });
+    }
+
+    if (directory.empty()) {
+        patternEncoder_.setCache(nullptr);
+        patternCacheDirectory_.clear();
+        updateFingerprintFile();
+        return true;
+    }
+
+    auto cache = std::make_shared<PatternBlockCache>(directory);
+    if (!cache->isValid()) {
+        return false;
+    }
+
+    patternEncoder_.setCache(cache);
+    patternCacheDirectory_ = directory;
+    updateFingerprintFile();
+
+    return true;
+}
+
+void ProjectorDlpc34xxDual::updateFingerprintFile() {
+    // 记录flash中数据块的指纹，重启后仍可跳过烧录；记录按设备标识区分，
+    // 共用缓存目录的投影仪互不影响，标识未知时只记录在内存中
+    flashProgrammer_.setFingerprintFile(FlashProgrammer::getFingerprintFilePath(
+        patternCacheDirectory_, "DLPC34xxDual", transport_->getIdentity()));
+}
+
+PatternCacheStats ProjectorDlpc34xxDual::getPatternCacheStats() {
+    if (!executor_.isInTask()) {
+        return executor_.execute(CommandPriority::Normal,
+                                 [&] { return getPatternCacheStats(); });
+    }
+
+    auto cache = patternEncoder_.getCache();
+
+    return cache ? cache->getStats() : PatternCacheStats();
+}
+
+FlashProgramStats ProjectorDlpc34xxDual::getFlashProgramStats() {
+    return flashProgrammer_.getStats();
+}
+
+ProjectorDlpc34xxDual::~ProjectorDlpc34xxDual() { healthMonitor_.stop(); }
 
+void ProjectorDlpc34xxDual::setTransport(
+    const std::shared_ptr<Transport> &transport) {
+    if (transport) {
+        transport_ = transport;
+    }
 }
 
 ProjectorInfo ProjectorDlpc34xxDual::getInfo() {
     ProjectorInfo projectorInfo;
     projectorInfo.dlpEvmType_ = "DLP4710";
-    projectorInfo.isFind_ = false;
+    projectorInfo.isFind_ = transport_->isPresent();
+    projectorInfo.i2cClockFrequency_ =
+        isInitial_ ? transport_->getClockFrequency() : 0;
     projectorInfo.width_ = cols_;
     projectorInfo.height_ = rows_;
 
-    uint8_t numDevices;
-    CyGetListofDevices(&numDevices);
-    for (size_t i = 0; i < numDevices; ++i) {
-        CY_DEVICE_INFO deviceInfo;
-        CyGetDeviceInfo(i, &deviceInfo);
-        CY_HANDLE handle;
-        unsigned char sig[6];
-        if(deviceInfo.deviceType[i] == CY_DEVICE_TYPE::CY_TYPE_I2C && deviceInfo.deviceClass[i] == CY_CLASS_VENDOR) {
-            projectorInfo.isFind_ = true;
-            break;
-        }
-    }
-
     return projectorInfo;
 }
 
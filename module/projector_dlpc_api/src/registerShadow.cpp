@@ -0,0 +1,175 @@
+#include "registerShadow.h"
+
+#include <cstring>
+
+namespace slmaster {
+namespace device {
+
+namespace {
+/** @brief 影子中的寄存器，单控制器与双控制器的操作码相同 */
+struct ShadowedRegister {
+    uint8_t writeOpcode_; //写命令操作码，读命令操作码为其+1
+    uint8_t keyMask_;     //第一个参数字节中作为索引的位，如触发输出的触发类型，0表示无索引
+    bool isReadable_;     //读命令应答与写命令参数格式相同，可由影子应答
+};
+
+const ShadowedRegister kShadowedRegisters[] = {
+    {0x05, 0x00, true},  // OperatingModeSelect
+    {0x10, 0x00, true},  // ImageCrop
+    {0x12, 0x00, true},  // DisplaySize
+    {0x2E, 0x00, true},  // InputImageSize
+    {0x50, 0x00, true},  // LedOutputControlMethod
+    {0x52, 0x00, true},  // RgbLedEnable
+    {0x5C, 0x00, true},  // RgbLedMaxCurrent
+    {0x90, 0x00, false}, // TriggerInConfiguration
+    {0x92, 0x01, false}, // TriggerOutConfiguration，位0为触发类型，位1、2为使能与反相
+    {0x94, 0x00, false}, // PatternReadyConfiguration
+};
+
+//RgbLedCurrent(0x54)不在影子中：自动LED控制方式下控制器会自行调整电流
+//只读且不变的寄存器：ControllerDeviceId
+constexpr uint8_t kReadOnlyOpcodes[] = {0xD4};
+
+const ShadowedRegister *findRegister(const uint8_t writeOpcode) {
+    for (const auto &reg : kShadowedRegisters) {
+        if (reg.writeOpcode_ == writeOpcode) {
+            return &reg;
+        }
+    }
+
+    return nullptr;
+}
+} // namespace
+
+RegisterShadow::RegisterShadow()
+    : numOfSkippedWrites_(0), numOfCachedReads_(0) {}
+
+void RegisterShadow::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    values_.clear();
+}
+
+bool RegisterShadow::findWriteKey(const uint8_t *pData, const uint16_t length,
+                                  uint16_t &key) const {
+    const ShadowedRegister *reg = length > 0 ? findRegister(pData[0]) : nullptr;
+    if (!reg || (reg->keyMask_ != 0 && length < 2)) {
+        return false;
+    }
+
+    key = (uint16_t)(reg->writeOpcode_ << 8) |
+          (reg->keyMask_ != 0 ? pData[1] & reg->keyMask_ : 0);
+
+    return true;
+}
+
+bool RegisterShadow::findReadKey(const uint8_t *pData, const uint16_t length,
+                                 uint16_t &key) const {
+    // 带参数的读命令（如按触发类型读取）不由影子应答
+    if (length != 1) {
+        return false;
+    }
+
+    for (const auto opcode : kReadOnlyOpcodes) {
+        if (opcode == pData[0]) {
+            key = (uint16_t)(opcode << 8);
+            return true;
+        }
+    }
+
+    const ShadowedRegister *reg = findRegister((uint8_t)(pData[0] - 1));
+    if (!reg || !reg->isReadable_ || reg->keyMask_ != 0) {
+        return false;
+    }
+
+    key = (uint16_t)(reg->writeOpcode_ << 8);
+
+    return true;
+}
+
+bool RegisterShadow::isRedundantWrite(const uint8_t *pData,
+                                      const uint16_t length) {
+    uint16_t key;
+    if (!findWriteKey(pData, length, key)) {
+        return false;
+    }
+
+    // 值为全部参数，含索引字节中的其余位
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = values_.find(key);
+    const uint16_t valueLength = length - 1;
+    if (iter == values_.end() || iter->second.size() != valueLength ||
+        memcmp(iter->second.data(), pData + 1, valueLength) != 0) {
+        return false;
+    }
+
+    ++numOfSkippedWrites_;
+
+    return true;
+}
+
+void RegisterShadow::onWrite(const uint8_t *pData, const uint16_t length,
+                             const bool isSucess) {
+    if (!isSucess) {
+        invalidate();
+        return;
+    }
+
+    uint16_t key;
+    if (!findWriteKey(pData, length, key)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    values_[key].assign(pData + 1, pData + length);
+}
+
+bool RegisterShadow::read(const uint8_t *pWriteData,
+                          const uint16_t writeLength, uint8_t *pReadData,
+                          const uint16_t readLength) {
+    uint16_t key;
+    if (!findReadKey(pWriteData, writeLength, key)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = values_.find(key);
+    if (iter == values_.end() || iter->second.size() != readLength) {
+        return false;
+    }
+
+    memcpy(pReadData, iter->second.data(), readLength);
+    ++numOfCachedReads_;
+
+    return true;
+}
+
+void RegisterShadow::onRead(const uint8_t *pWriteData,
+                            const uint16_t writeLength,
+                            const uint8_t *pReadData,
+                            const uint16_t readLength, const bool isSucess) {
+    if (!isSucess) {
+        invalidate();
+        return;
+    }
+
+    uint16_t key;
+    if (!findReadKey(pWriteData, writeLength, key)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    values_[key].assign(pReadData, pReadData + readLength);
+}
+
+uint64_t RegisterShadow::getNumOfSkippedWrites() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numOfSkippedWrites_;
+}
+
+uint64_t RegisterShadow::getNumOfCachedReads() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numOfCachedReads_;
+}
+
+} // namespace device
+} // namespace slmaster
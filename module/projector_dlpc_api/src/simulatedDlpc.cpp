@@ -0,0 +1,433 @@
+#include "simulatedDlpc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace slmaster {
+namespace device {
+
+namespace {
+//命令操作码，单控制器与双控制器相同
+constexpr uint8_t kOpcodeRgbLedMaxCurrent = 0x5C;
+constexpr uint8_t kOpcodePatternOrderTableEntry = 0x98;
+constexpr uint8_t kOpcodeInternalPatternControl = 0x9E;
+constexpr uint8_t kOpcodeInternalPatternStatus = 0x9F;
+constexpr uint8_t kOpcodeShortStatus = 0xD0;
+constexpr uint8_t kOpcodeControllerDeviceId = 0xD4;
+constexpr uint8_t kOpcodeFlashDataLength = 0xDF;
+constexpr uint8_t kOpcodeFlashErase = 0xE0;
+constexpr uint8_t kOpcodeWriteFlashStart = 0xE1;
+constexpr uint8_t kOpcodeWriteFlashContinue = 0xE2;
+constexpr uint8_t kOpcodeReadFlashStart = 0xE3;
+constexpr uint8_t kOpcodeReadFlashContinue = 0xE4;
+
+//图案顺序表写控制：从flash重载
+constexpr uint8_t kWriteControlReloadFromFlash = 0x2;
+
+//内部图案控制命令
+constexpr uint8_t kPatternControlStart = 0x0;
+constexpr uint8_t kPatternControlStop = 0x1;
+constexpr uint8_t kPatternControlStep = 0x3;
+constexpr uint8_t kPatternControlReset = 0x5;
+
+//擦除命令的签名
+constexpr uint8_t kEraseSignature[4] = {0xAA, 0xBB, 0xCC, 0xDD};
+
+//"PATN"数据块中的偏移，见dlpc347x_internal_patterns.c
+constexpr uint32_t kBlockHeaderSize = 20;
+constexpr uint32_t kOrderTableEntrySize = 24;
+constexpr uint32_t kPatternSetHeaderSize = 8;
+
+//默认LED最大电流
+constexpr uint16_t kDefaultMaxCurrent = 1000;
+
+uint32_t readUint32(const std::vector<uint8_t> &data, const uint32_t offset) {
+    return (uint32_t)data[offset] | ((uint32_t)data[offset + 1] << 8) |
+           ((uint32_t)data[offset + 2] << 16) |
+           ((uint32_t)data[offset + 3] << 24);
+}
+} // namespace
+
+SimulatedDlpcTransport::SimulatedDlpcTransport(
+    const SimulatedDlpcTiming &timing, const uint32_t flashSize,
+    const uint8_t deviceId)
+    : timing_(timing), deviceId_(deviceId), isOpen_(false),
+      flash_(flashSize, 0xFF), flashAddress_(0), flashDataLength_(0),
+      maxFlashWriteLength_(0), numOfFlashWriteNaks_(0), isFlashError_(false), isSystemError_(false),
+      isRunning_(false),
+      orderIndex_(0), numOfDisplayed_(0), numOfErases_(0),
+      numOfTransactions_(0), numOfBytes_(0), linkSeconds_(0) {
+    registers_[kOpcodeRgbLedMaxCurrent] = {
+        kDefaultMaxCurrent & 0xFF, kDefaultMaxCurrent >> 8,
+        kDefaultMaxCurrent & 0xFF, kDefaultMaxCurrent >> 8,
+        kDefaultMaxCurrent & 0xFF, kDefaultMaxCurrent >> 8};
+}
+
+bool SimulatedDlpcTransport::open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isOpen_ = true;
+    return true;
+}
+
+void SimulatedDlpcTransport::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isOpen_ = false;
+}
+
+bool SimulatedDlpcTransport::write(uint16_t length, const uint8_t *pData) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!isOpen_ || length == 0) {
+        return false;
+    }
+
+    occupyLink(length, 1, 1);
+
+    return executeWrite(pData, length);
+}
+
+bool SimulatedDlpcTransport::writeRead(uint16_t writeLength,
+                                       const uint8_t *pWriteData,
+                                       uint16_t readLength,
+                                       uint8_t *pReadData) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!isOpen_ || writeLength == 0) {
+        return false;
+    }
+
+    occupyLink(writeLength + readLength, 2, timing_.callsPerRead_);
+
+    return executeRead(pWriteData, writeLength, pReadData, readLength);
+}
+
+uint32_t SimulatedDlpcTransport::negotiateClockFrequency(
+    const std::function<bool()> &linkTest) {
+    return linkTest() ? timing_.clockFrequency_ : 0;
+}
+
+void SimulatedDlpcTransport::setMaxFlashWriteLength(const uint16_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxFlashWriteLength_ = length;
+}
+
+void SimulatedDlpcTransport::setFlashWriteNaks(const uint32_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    numOfFlashWriteNaks_ = count;
+}
+
+std::vector<uint8_t> SimulatedDlpcTransport::getFlash() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flash_;
+}
+
+void SimulatedDlpcTransport::setFlashByte(const uint32_t offset,
+                                          const uint8_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (offset < flash_.size()) {
+        flash_[offset] = value;
+    }
+}
+
+bool SimulatedDlpcTransport::isPatternRunning() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isRunning_;
+}
+
+void SimulatedDlpcTransport::setSystemError(const bool isError) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isSystemError_ = isError;
+}
+
+uint64_t SimulatedDlpcTransport::getNumOfErases() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numOfErases_;
+}
+
+uint64_t SimulatedDlpcTransport::getNumOfTransactions() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numOfTransactions_;
+}
+
+uint64_t SimulatedDlpcTransport::getNumOfBytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numOfBytes_;
+}
+
+double SimulatedDlpcTransport::getLinkSeconds() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return linkSeconds_;
+}
+
+void SimulatedDlpcTransport::occupyLink(const uint32_t numOfBytes,
+                                        const uint32_t numOfMessages,
+                                        const uint32_t numOfCalls) {
+    ++numOfTransactions_;
+    numOfBytes_ += numOfBytes;
+
+    double seconds = timing_.transactionSeconds_ * numOfCalls;
+    if (timing_.clockFrequency_ > 0) {
+        seconds += 9.0 * (numOfBytes + numOfMessages) / timing_.clockFrequency_;
+    }
+
+    if (seconds <= 0) {
+        return;
+    }
+
+    linkSeconds_ += seconds;
+
+    // 按链路空闲时刻累加，单次休眠的误差不会累积
+    const auto now = std::chrono::steady_clock::now();
+    linkFreeTime_ =
+        std::max(linkFreeTime_, now) +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(seconds));
+    std::this_thread::sleep_until(linkFreeTime_);
+}
+
+bool SimulatedDlpcTransport::executeWrite(const uint8_t *pData,
+                                          const uint16_t length) {
+    const uint8_t opcode = pData[0];
+    const uint8_t *pParam = pData + 1;
+    const uint16_t paramLength = length - 1;
+
+    switch (opcode) {
+    case kOpcodeFlashDataLength: {
+        if (paramLength < 2) {
+            return false;
+        }
+
+        flashDataLength_ = (uint16_t)(pParam[0] | (pParam[1] << 8));
+        return true;
+    }
+    case kOpcodeFlashErase: {
+        if (paramLength < 4 ||
+            memcmp(pParam, kEraseSignature, sizeof(kEraseSignature)) != 0) {
+            return false;
+        }
+
+        std::fill(flash_.begin(), flash_.end(), 0xFF);
+        isFlashError_ = false;
+        ++numOfErases_;
+        eraseDoneTime_ =
+            std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(timing_.eraseSeconds_));
+        return true;
+    }
+    case kOpcodeWriteFlashStart:
+    case kOpcodeWriteFlashContinue: {
+        if (numOfFlashWriteNaks_ > 0) {
+            --numOfFlashWriteNaks_;
+            return false;
+        }
+
+        if (opcode == kOpcodeWriteFlashStart) {
+            flashAddress_ = 0;
+        }
+
+        if (!programFlash(pParam, paramLength)) {
+            isFlashError_ = true;
+            return false;
+        }
+
+        return true;
+    }
+    case kOpcodePatternOrderTableEntry: {
+        if (paramLength > 0 && pParam[0] == kWriteControlReloadFromFlash) {
+            reloadOrderTable();
+        }
+
+        return true;
+    }
+    case kOpcodeInternalPatternControl: {
+        if (paramLength < 1) {
+            return false;
+        }
+
+        controlPattern(pParam[0]);
+        return true;
+    }
+    default:
+        registers_[opcode].assign(pParam, pParam + paramLength);
+        return true;
+    }
+}
+
+bool SimulatedDlpcTransport::executeRead(const uint8_t *pData,
+                                         const uint16_t length,
+                                         uint8_t *pReadData,
+                                         const uint16_t readLength) {
+    const uint8_t opcode = pData[0];
+    memset(pReadData, 0, readLength);
+
+    switch (opcode) {
+    case kOpcodeShortStatus: {
+        if (readLength < 1) {
+            return false;
+        }
+
+        // bit0系统已初始化，bit3系统错误，bit4为1表示擦除未完成，bit5 flash错误
+        pReadData[0] = 0x01;
+        if (isSystemError_) {
+            pReadData[0] |= 0x01 << 3;
+        }
+        if (!isEraseComplete()) {
+            pReadData[0] |= 0x01 << 4;
+        }
+        if (isFlashError_) {
+            pReadData[0] |= 0x01 << 5;
+        }
+        return true;
+    }
+    case kOpcodeControllerDeviceId: {
+        if (readLength < 1) {
+            return false;
+        }
+
+        pReadData[0] = deviceId_;
+        return true;
+    }
+    case kOpcodeInternalPatternStatus: {
+        if (readLength < 7) {
+            return false;
+        }
+
+        const size_t numOfEntries = orderTable_.size();
+        pReadData[0] = numOfEntries > 0 ? 0x1 : 0x0;
+        pReadData[1] = (uint8_t)numOfEntries;
+        if (numOfEntries > 0) {
+            const OrderEntry &current = orderTable_[orderIndex_];
+            pReadData[2] = (uint8_t)orderIndex_;
+            pReadData[3] = current.patternSetIndex_;
+            pReadData[4] = current.patternSetIndex_ < patternSetSizes_.size()
+                               ? patternSetSizes_[current.patternSetIndex_]
+                               : 0;
+            pReadData[5] = numOfDisplayed_;
+            pReadData[6] =
+                orderTable_[(orderIndex_ + 1) % numOfEntries].patternSetIndex_;
+        }
+        return true;
+    }
+    case kOpcodeReadFlashStart:
+    case kOpcodeReadFlashContinue: {
+        if (opcode == kOpcodeReadFlashStart) {
+            flashAddress_ = 0;
+        }
+
+        if (readLength != flashDataLength_ ||
+            flashAddress_ + readLength > flash_.size()) {
+            return false;
+        }
+
+        memcpy(pReadData, flash_.data() + flashAddress_, readLength);
+        flashAddress_ += readLength;
+        return true;
+    }
+    default: {
+        // 读命令的操作码为对应写命令的操作码+1
+        auto iter = registers_.find((uint8_t)(opcode - 1));
+        if (iter != registers_.end()) {
+            memcpy(pReadData, iter->second.data(),
+                   std::min<size_t>(readLength, iter->second.size()));
+        }
+        return true;
+    }
+    }
+}
+
+bool SimulatedDlpcTransport::programFlash(const uint8_t *pData,
+                                          const uint16_t length) {
+    if (!isEraseComplete() || length != flashDataLength_ ||
+        (maxFlashWriteLength_ > 0 && length > maxFlashWriteLength_) ||
+        flashAddress_ + length > flash_.size()) {
+        return false;
+    }
+
+    // NOR flash只能把位从1写为0，未擦除时写入的数据会损坏
+    uint8_t *pFlash = flash_.data() + flashAddress_;
+    for (uint16_t i = 0; i < length; ++i) {
+        pFlash[i] &= pData[i];
+    }
+    flashAddress_ += length;
+
+    return true;
+}
+
+void SimulatedDlpcTransport::reloadOrderTable() {
+    orderTable_.clear();
+    patternSetSizes_.clear();
+    isRunning_ = false;
+    orderIndex_ = 0;
+    numOfDisplayed_ = 0;
+
+    if (flash_.size() < kBlockHeaderSize ||
+        memcmp(flash_.data(), "PATN", 4) != 0) {
+        return;
+    }
+
+    const uint32_t setsStart = readUint32(flash_, 4);
+    const uint32_t orderTableStart = readUint32(flash_, 12);
+    if (orderTableStart + 4 > flash_.size() || setsStart + 4 > flash_.size()) {
+        return;
+    }
+
+    const uint32_t numOfEntries = readUint32(flash_, orderTableStart);
+    if (orderTableStart + 4 + (uint64_t)numOfEntries * kOrderTableEntrySize >
+        flash_.size()) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < numOfEntries; ++i) {
+        const uint32_t offset = orderTableStart + 4 + i * kOrderTableEntrySize;
+        orderTable_.push_back({flash_[offset], flash_[offset + 1]});
+    }
+
+    // 集合起始地址数组之后是各集合的头部，第一个字节为图案数量
+    const uint32_t numOfSets = readUint32(flash_, setsStart);
+    if (setsStart + 4 + (uint64_t)numOfSets * 4 > flash_.size()) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < numOfSets; ++i) {
+        const uint32_t setStart = readUint32(flash_, setsStart + 4 + i * 4);
+        patternSetSizes_.push_back(
+            (uint64_t)setStart + kPatternSetHeaderSize <= flash_.size()
+                ? flash_[setStart]
+                : 0);
+    }
+}
+
+void SimulatedDlpcTransport::controlPattern(const uint8_t control) {
+    switch (control) {
+    case kPatternControlStart:
+        isRunning_ = !orderTable_.empty();
+        orderIndex_ = 0;
+        numOfDisplayed_ = 0;
+        break;
+    case kPatternControlStop:
+    case kPatternControlReset:
+        isRunning_ = false;
+        orderIndex_ = 0;
+        numOfDisplayed_ = 0;
+        break;
+    case kPatternControlStep:
+        if (!orderTable_.empty()) {
+            if (++numOfDisplayed_ >=
+                orderTable_[orderIndex_].numDisplayPatterns_) {
+                orderIndex_ = (orderIndex_ + 1) % orderTable_.size();
+                numOfDisplayed_ = 0;
+            }
+        }
+        break;
+    default:
+        // 暂停与恢复不改变图案位置
+        break;
+    }
+}
+
+bool SimulatedDlpcTransport::isEraseComplete() const {
+    return std::chrono::steady_clock::now() >= eraseDoneTime_;
+}
+
+} // namespace device
+} // namespace slmaster
@@ -0,0 +1,99 @@
+#include "threadPool.h"
+
+namespace slmaster {
+namespace device {
+
+ThreadPool::ThreadPool(const size_t numOfThreads)
+    : task_(nullptr), count_(0), next_(0), numOfBusy_(0), generation_(0),
+      isExit_(false) {
+    size_t numOfWorkers = numOfThreads;
+    if (numOfWorkers == 0) {
+        const size_t hardwareThreads = std::thread::hardware_concurrency();
+        numOfWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    threads_.reserve(numOfWorkers);
+    for (size_t i = 0; i < numOfWorkers; ++i) {
+        threads_.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isExit_ = true;
+    }
+    wakeUp_.notify_all();
+
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(const size_t count, const Task &task) {
+    if (count == 0) {
+        return;
+    }
+
+    const size_t callerWorker = threads_.size();
+
+    if (threads_.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i, callerWorker);
+        }
+
+        return;
+    }
+
+    std::lock_guard<std::mutex> parallelForLock(parallelForMutex_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        numOfBusy_ = threads_.size();
+        ++generation_;
+    }
+    wakeUp_.notify_all();
+
+    work(callerWorker);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return numOfBusy_ == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::run(const size_t worker) {
+    uint64_t generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeUp_.wait(lock,
+                         [&] { return isExit_ || generation_ != generation; });
+            if (isExit_) {
+                return;
+            }
+
+            generation = generation_;
+        }
+
+        work(worker);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--numOfBusy_ == 0) {
+            done_.notify_all();
+        }
+    }
+}
+
+void ThreadPool::work(const size_t worker) {
+    size_t index;
+    while ((index = next_.fetch_add(1)) < count_) {
+        (*task_)(index, worker);
+    }
+}
+
+} // namespace device
+} // namespace slmaster
@@ -0,0 +1,373 @@
+#include "transport.h"
+
+#include "dlpc_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef PROJECTOR_WITH_CYUSBSERIAL
+#include "CyUSBSerial.h"
+#include "cypress_i2c.h"
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace slmaster {
+namespace device {
+
+namespace {
+uint64_t getElapsedMicroseconds(
+    const std::chrono::steady_clock::time_point &start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+uint32_t writeCommand(uint16_t writeDataLength, uint8_t *writeData,
+                      DLPC_COMMON_CommandProtocolData_s *protocolData) {
+    auto context = static_cast<CommandContext *>(DLPC_COMMON_GetUserData());
+    Transport *transport = context ? context->getTransport() : nullptr;
+    RegisterShadow *shadow = context ? context->getShadow() : nullptr;
+
+    // 与影子相同的配置不再发送
+    if (shadow && shadow->isRedundantWrite(writeData, writeDataLength)) {
+        return SUCCESS;
+    }
+
+    // 关闭统计时不读取时钟
+    CommandStats *stats = context ? &context->getStats() : nullptr;
+    const bool isRecording = stats && stats->isEnabled();
+    const auto start = isRecording ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point();
+
+    const bool isSucess =
+        transport && transport->write(writeDataLength, writeData);
+
+    if (isRecording) {
+        stats->record(writeData[0], writeDataLength, 0,
+                      getElapsedMicroseconds(start), isSucess);
+    }
+
+    if (shadow) {
+        shadow->onWrite(writeData, writeDataLength, isSucess);
+    }
+
+    if (!isSucess) {
+        printf("Write I2C Error, opcode 0x%02X!!! \n", writeData[0]);
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+uint32_t readCommand(uint16_t writeDataLength, uint8_t *writeData,
+                     uint16_t readDataLength, uint8_t *readData,
+                     DLPC_COMMON_CommandProtocolData_s *protocolData) {
+    auto context = static_cast<CommandContext *>(DLPC_COMMON_GetUserData());
+    Transport *transport = context ? context->getTransport() : nullptr;
+    RegisterShadow *shadow = context ? context->getShadow() : nullptr;
+
+    if (shadow &&
+        shadow->read(writeData, writeDataLength, readData, readDataLength)) {
+        return SUCCESS;
+    }
+
+    CommandStats *stats = context ? &context->getStats() : nullptr;
+    const bool isRecording = stats && stats->isEnabled();
+    const auto start = isRecording ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point();
+
+    const bool isSucess =
+        transport && transport->writeRead(writeDataLength, writeData,
+                                          readDataLength, readData);
+
+    if (isRecording) {
+        stats->record(writeData[0], writeDataLength, readDataLength,
+                      getElapsedMicroseconds(start), isSucess);
+    }
+
+    if (shadow) {
+        shadow->onRead(writeData, writeDataLength, readData, readDataLength,
+                       isSucess);
+    }
+
+    if (!isSucess) {
+        printf("Read I2C Error, opcode 0x%02X!!! \n", writeData[0]);
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+#ifdef PROJECTOR_WITH_CYUSBSERIAL
+bool runLinkTest(void *userData) {
+    return (*static_cast<const std::function<bool()> *>(userData))();
+}
+#endif
+} // namespace
+
+CommandContext::CommandContext() : transport_(nullptr), shadow_(nullptr) {
+    DLPC_COMMON_InitContext(&context_, nullptr, 0, nullptr, 0, writeCommand,
+                            readCommand, this);
+}
+
+void CommandContext::init(Transport *transport, uint8_t *pWriteBuffer,
+                          uint16_t writeBufferSize, uint8_t *pReadBuffer,
+                          uint16_t readBufferSize) {
+    transport_ = transport;
+    shadow_ = nullptr;
+
+    DLPC_COMMON_InitContext(&context_, pWriteBuffer, writeBufferSize,
+                            pReadBuffer, readBufferSize, writeCommand,
+                            readCommand, this);
+}
+
+CommandContextScope::CommandContextScope(CommandContext &context)
+    : previous_(DLPC_COMMON_SelectContext(context.get())) {}
+
+CommandContextScope::CommandContextScope(DLPC_COMMON_Context_s *context)
+    : previous_(DLPC_COMMON_SelectContext(context)) {}
+
+CommandContextScope::~CommandContextScope() {
+    DLPC_COMMON_SelectContext(previous_);
+}
+
+CypressTransport::CypressTransport(const std::string &serialNumber,
+                                   const int bridgeIndex)
+    : serialNumber_(serialNumber), bridgeIndex_(bridgeIndex),
+      device_(nullptr) {}
+
+#ifdef PROJECTOR_WITH_CYUSBSERIAL
+CypressTransport::~CypressTransport() {
+    CYPRESS_I2C_DestroyDevice(device_);
+}
+
+bool CypressTransport::isPresent() {
+    return CYPRESS_I2C_IsPresent(serialNumber_.c_str(), bridgeIndex_);
+}
+
+bool CypressTransport::open() {
+    if (!device_) {
+        device_ = CYPRESS_I2C_CreateDevice();
+    }
+
+    if (!device_ ||
+        !CYPRESS_I2C_ConnectToCyI2C(device_, serialNumber_.c_str(),
+                                    bridgeIndex_)) {
+        return false;
+    }
+
+    if (!CYPRESS_I2C_RequestI2CBusAccess(device_)) {
+        printf("Error request I2C bus access! \n");
+        return false;
+    }
+
+    return true;
+}
+
+void CypressTransport::close() {
+    if (device_) {
+        CYPRESS_I2C_RelinquishI2CBusAccess(device_);
+    }
+}
+
+bool CypressTransport::write(uint16_t length, const uint8_t *pData) {
+    return device_ &&
+           CYPRESS_I2C_WriteI2C(device_, length, const_cast<uint8_t *>(pData));
+}
+
+bool CypressTransport::writeRead(uint16_t writeLength,
+                                 const uint8_t *pWriteData,
+                                 uint16_t readLength, uint8_t *pReadData) {
+    // 以重复起始条件衔接写与读；桥接芯片仍需写与读各一次USB往返
+    return device_ && CYPRESS_I2C_WriteReadI2C(
+                          device_, writeLength,
+                          const_cast<uint8_t *>(pWriteData), readLength,
+                          pReadData);
+}
+
+uint32_t
+CypressTransport::negotiateClockFrequency(const std::function<bool()> &linkTest) {
+    return device_ ? CYPRESS_I2C_NegotiateClockFrequency(
+                         device_, runLinkTest,
+                         const_cast<std::function<bool()> *>(&linkTest))
+                   : 0;
+}
+
+uint32_t CypressTransport::getClockFrequency() {
+    return device_ ? CYPRESS_I2C_GetClockFrequency(device_) : 0;
+}
+#else
+CypressTransport::~CypressTransport() {}
+
+bool CypressTransport::isPresent() { return false; }
+
+bool CypressTransport::open() {
+    printf("Built without cyusbserial! \n");
+    return false;
+}
+
+void CypressTransport::close() {}
+
+bool CypressTransport::write(uint16_t length, const uint8_t *pData) {
+    return false;
+}
+
+bool CypressTransport::writeRead(uint16_t writeLength,
+                                 const uint8_t *pWriteData,
+                                 uint16_t readLength, uint8_t *pReadData) {
+    return false;
+}
+
+uint32_t
+CypressTransport::negotiateClockFrequency(const std::function<bool()> &linkTest) {
+    return 0;
+}
+
+uint32_t CypressTransport::getClockFrequency() { return 0; }
+#endif
+
+std::string CypressTransport::getIdentity() {
+#ifdef PROJECTOR_WITH_CYUSBSERIAL
+    // 按索引或未指定选择时，连接后才能确定是哪一个桥接芯片
+    const char *serialNumber =
+        device_ ? CYPRESS_I2C_GetSerialNumber(device_) : "";
+    if (serialNumber[0] != '\0') {
+        return serialNumber;
+    }
+#endif
+
+    if (!serialNumber_.empty()) {
+        return serialNumber_;
+    }
+
+    return bridgeIndex_ >= 0 ? "bridge" + std::to_string(bridgeIndex_) : "";
+}
+
+LinuxI2cTransport::LinuxI2cTransport(const std::string &devicePath,
+                                     const uint16_t address)
+    : devicePath_(devicePath), address_(address), fd_(-1) {}
+
+LinuxI2cTransport::~LinuxI2cTransport() { close(); }
+
+std::string LinuxI2cTransport::getIdentity() {
+    char address[8];
+    snprintf(address, sizeof(address), "0x%02X", address_);
+
+    return devicePath_ + "@" + address;
+}
+
+#ifdef __linux__
+bool LinuxI2cTransport::isPresent() {
+    return ::access(devicePath_.c_str(), R_OK | W_OK) == 0;
+}
+
+bool LinuxI2cTransport::open() {
+    close();
+
+    fd_ = ::open(devicePath_.c_str(), O_RDWR);
+    if (fd_ < 0) {
+        printf("Open %s Error!!! \n", devicePath_.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void LinuxI2cTransport::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool LinuxI2cTransport::write(uint16_t length, const uint8_t *pData) {
+    i2c_msg message = {address_, 0, length, const_cast<uint8_t *>(pData)};
+    i2c_rdwr_ioctl_data transfer = {&message, 1};
+
+    return fd_ >= 0 && ::ioctl(fd_, I2C_RDWR, &transfer) >= 0;
+}
+
+bool LinuxI2cTransport::writeRead(uint16_t writeLength,
+                                  const uint8_t *pWriteData,
+                                  uint16_t readLength, uint8_t *pReadData) {
+    // 写入与读取之间为重复起始条件，一次系统调用完成
+    i2c_msg messages[2] = {
+        {address_, 0, writeLength, const_cast<uint8_t *>(pWriteData)},
+        {address_, I2C_M_RD, readLength, pReadData}};
+    i2c_rdwr_ioctl_data transfer = {messages, 2};
+
+    return fd_ >= 0 && ::ioctl(fd_, I2C_RDWR, &transfer) >= 0;
+}
+#else
+bool LinuxI2cTransport::isPresent() { return false; }
+
+bool LinuxI2cTransport::open() { return false; }
+
+void LinuxI2cTransport::close() {}
+
+bool LinuxI2cTransport::write(uint16_t length, const uint8_t *pData) {
+    return false;
+}
+
+bool LinuxI2cTransport::writeRead(uint16_t writeLength,
+                                  const uint8_t *pWriteData,
+                                  uint16_t readLength, uint8_t *pReadData) {
+    return false;
+}
+#endif
+
+LoopbackTransport::LoopbackTransport()
+    : numOfWrites_(0), numOfReads_(0), isOpen_(false) {}
+
+bool LoopbackTransport::open() {
+    isOpen_ = true;
+    return true;
+}
+
+void LoopbackTransport::close() { isOpen_ = false; }
+
+bool LoopbackTransport::write(uint16_t length, const uint8_t *pData) {
+    if (!isOpen_) {
+        return false;
+    }
+
+    lastWrite_.assign(pData, pData + length);
+    ++numOfWrites_;
+
+    return responder_ ? responder_(pData, length, nullptr, 0) : true;
+}
+
+bool LoopbackTransport::writeRead(uint16_t writeLength,
+                                  const uint8_t *pWriteData,
+                                  uint16_t readLength, uint8_t *pReadData) {
+    if (!isOpen_) {
+        return false;
+    }
+
+    lastWrite_.assign(pWriteData, pWriteData + writeLength);
+    ++numOfWrites_;
+    ++numOfReads_;
+
+    if (responder_) {
+        return responder_(pWriteData, writeLength, pReadData, readLength);
+    }
+
+    const uint16_t count =
+        (uint16_t)std::min<size_t>(readLength, lastWrite_.size());
+    memcpy(pReadData, lastWrite_.data(), count);
+    memset(pReadData + count, 0, readLength - count);
+
+    return true;
+}
+
+} // namespace device
+} // namespace slmaster